@@ -6,37 +6,303 @@
 
  */
 
+#include <errno.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
 
-#include <libircclient.h>
-#include <libirc_rfcnumeric.h>
 #include <utils/gp_vec.h>
 #include <utils/gp_vec_str.h>
 #include <widgets/gp_widgets.h>
 
 #include "gpirc_conf.h"
+#include "gpirc_isupport.h"
+#include "gpirc_nicks.h"
+#include "gpirc_msgs.h"
+#include "gpirc_log.h"
+#include "gpirc_hist.h"
+#include "gpirc_search.h"
+#include "gpirc_net.h"
+#include "gpirc_capture.h"
+#include "gpirc_proto.h"
+#include "gpirc_stats.h"
+#include "gpirc_match.h"
+#include "gpirc_fmt.h"
+#include "gpirc_time.h"
 
-static irc_session_t *irc_session;
 static gp_widget *status_log;
 static gp_widget *channel_tabs;
 static gp_widget *topic;
+static gp_widget *status_bar;
+static gp_widget *cmdline_tbox;
+/* Search results tab, NULL if not open */
+static gp_widget *search_log;
 
-static gp_htable *channels_map;
+/*
+ * Socket receive to log append latency measurement, enabled by /latency.
+ *
+ * The receive timestamp is taken by the network thread when the IRC socket
+ * becomes readable and all log appends done while processing events parsed
+ * from that data are accounted against it.
+ */
+static struct latency {
+	int enabled;
+	uint64_t min_ns;
+	uint64_t max_ns;
+	uint64_t sum_ns;
+	uint64_t samples;
+} latency;
+
+static void latency_sample(void)
+{
+	uint64_t diff, recv_ns = gpirc_net_recv_ns();
+
+	if (!latency.enabled || !recv_ns)
+		return;
+
+	diff = gpirc_monotonic_ns() - recv_ns;
+
+	if (!latency.samples || diff < latency.min_ns)
+		latency.min_ns = diff;
+
+	if (diff > latency.max_ns)
+		latency.max_ns = diff;
+
+	latency.sum_ns += diff;
+	latency.samples++;
+}
+
+/* Time from start to the main loop */
+static uint64_t start_ns;
+static uint64_t startup_ns;
+
+static size_t rss_kb(void)
+{
+	unsigned long size, resident = 0;
+	FILE *f = fopen("/proc/self/statm", "r");
+
+	if (!f)
+		return 0;
+
+	if (fscanf(f, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+
+	fclose(f);
+
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/* Lines kept by the log widget */
+#define CHAN_LOG_LINES 1000
+/* Message store limits */
+#define CHAN_MSGS_MAX 2048
+#define CHAN_MSGS_BUF_MAX (256 * 1024)
 
 struct channel {
+	struct network *net;
 	gp_widget *channel_log;
 	char *name;
+	/* Channel key, NULL if none */
+	char *key;
 	char *topic;
-	//FIXME Hash table? Trie?
-	char **nicks;
+	struct gpirc_nicks nicks;
+	/* Set while a NAMES reply is being received */
+	int names_pending;
+	/* Member count before the NAMES reply */
+	size_t names_cnt;
+	/* Set while rejoining after a reconnect */
+	int rejoin;
+	/* Time of the last message before the rejoin, see chan_history_fetch() */
+	time_t history_after;
+
+	struct gpirc_msgs msgs;
+	/* On disk log, NULL if logging is disabled */
+	struct gpirc_log *log;
+	/* Id of the first message that was not rendered into the log yet */
+	uint64_t rendered;
+	/* History tab, NULL if not open */
+	struct hist_view *hist;
+	/* Search index source id */
+	int search_src;
+
+	/* Messages received while the tab was not active */
+	unsigned int unread;
+	/* Set if any of the unread messages is a highlight */
+	int highlight;
+	/* Messages stored in the minute rate_min and in the minute before */
+	uint32_t rate_min;
+	uint32_t rate_cur;
+	uint32_t rate_prev;
+	struct channel *act_next;
+
+	/* Pending netsplit and netjoin output */
+	unsigned int split_quits;
+	unsigned int split_joins;
+	char *split_quit_nicks;
+	char *split_join_nicks;
+	struct channel *split_next;
+	int split_pending;
+};
+
+struct netsplit {
+	/* Channels with pending output */
+	struct channel *chans;
+	char servers[256];
+	/* Number of open IRCv3 netsplit/netjoin batches */
+	int batches;
+	int timer_running;
+	int expire_running;
+	/* Users lost in the split, we hold a reference */
+	struct gpirc_user **users;
+	gp_timer flush_timer;
+	gp_timer expire_timer;
+};
+
+struct autojoin {
+	gp_timer timer;
+	int running;
+	/* Set once the first lines were sent */
+	int started;
+	/* Channels to join, copied when the autojoin starts */
+	struct gpirc_chan *chans;
+	/* Index of the next channel to join */
+	size_t next;
+	unsigned int lines;
+};
+
+struct reconnect {
+	gp_timer timer;
+	int running;
+	/* Failed attempts in a row */
+	unsigned int attempts;
+	/* Registration time, zero when not registered */
+	uint64_t connected_ns;
+};
+
+struct lag {
+	gp_timer timer;
+	int running;
+	/* Time the PING we wait for was queued, zero if none */
+	uint64_t ping_ns;
+	/* Last and smoothed round trip, zero until measured */
+	uint64_t cur_ns;
+	uint64_t avg_ns;
+	struct gpirc_stats_hist hist;
+};
+
+/* IRCv3 capabilities we ask for, see cap_names */
+enum cap {
+	CAP_AWAY_NOTIFY,
+	CAP_BATCH,
+	CAP_CHATHISTORY,
+	CAP_ECHO_MESSAGE,
+	CAP_MULTI_PREFIX,
+	CAP_SERVER_TIME,
+	CAP_CNT,
+};
+
+struct caps {
+	/* Bitmask of enabled enum cap */
+	uint32_t enabled;
+	/* Offered by the server while the CAP LS reply is being received */
+	uint32_t offered;
 };
 
+#define CAP_ENABLED(net, cap) ((net)->caps.enabled & (1u<<(cap)))
+
+enum batch_type {
+	BATCH_OTHER,
+	BATCH_NETSPLIT,
+	BATCH_NETJOIN,
+	BATCH_CHATHISTORY,
+};
+
+#define BATCHES_MAX 8
+
+/*
+ * An open IRCv3 batch, messages refer to it by the reference in the batch tag.
+ */
+struct batch {
+	char ref[32];
+	enum batch_type type;
+	/* Batch target, the channel for chathistory */
+	char target[64];
+	/* Messages stored from a chathistory batch */
+	unsigned int msgs;
+};
+
+/*
+ * An IRC network, each has its own session, channel namespace and users.
+ */
+struct network {
+	struct gpirc_conf conf;
+	struct gpirc_net_sess *session;
+	gp_htable *channels_map;
+	struct gpirc_users users;
+	struct netsplit netsplit;
+	struct gpirc_isupport isupport;
+	struct autojoin autojoin;
+	struct reconnect reconnect;
+	struct lag lag;
+	/* Compiled highlight and ignore rules, see rules_compile() */
+	struct gpirc_match highlight;
+	struct gpirc_match ignore;
+	struct caps caps;
+	struct batch batches[BATCHES_MAX];
+	unsigned int batches_cnt;
+};
+
+static struct network **networks;
+
+/* Network the status log commands apply to */
+static struct network *cur_net;
+
+static const char *net_name(struct network *net)
+{
+	if (net->conf.name)
+		return net->conf.name;
+
+	return net->conf.server ? net->conf.server : "(none)";
+}
+
 static void status_log_append(const char *msg)
 {
 	gp_widget_log_append(status_log, msg);
 }
 
-static void status_log_appends(const char *msgs[], unsigned int cnt)
+static void status_log_printf(const char *fmt, ...)
+{
+	char buf[1024];
+	va_list args;
+
+	va_start(args, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+
+	gp_widget_log_append(status_log, buf);
+}
+
+/*
+ * Network messages in the status log are prefixed with the network name once
+ * there is more than one.
+ */
+static void net_log_printf(struct network *net, const char *fmt, ...)
+{
+	char buf[1024];
+	va_list args;
+	int len = 0;
+
+	if (gp_vec_len(networks) > 1)
+		len = snprintf(buf, sizeof(buf), "[%s] ", net_name(net));
+
+	va_start(args, fmt);
+	vsnprintf(buf + len, sizeof(buf) - len, fmt, args);
+	va_end(args);
+
+	gp_widget_log_append(status_log, buf);
+}
+
+static void net_log_appends(struct network *net, const char *msgs[], unsigned int cnt)
 {
 	char *msg = gp_vec_str_new();
 	unsigned int i;
@@ -50,36 +316,72 @@ static void status_log_appends(const char *msgs[], unsigned int cnt)
 		GP_VEC_STR_APPEND(msg, msgs[i]);
 	}
 
-	status_log_append(msg);
+	net_log_printf(net, "%s", msg);
 
 	gp_vec_free(msg);
 }
 
-static void status_log_printf(const char *fmt, ...)
+/*
+ * Channel shown in each tab, NULL for the status log, history and search
+ * tabs.
+ *
+ * Channel tabs start without a widget, the log widget is created when the
+ * tab is shown for the first time. Until then the channel has only the
+ * message store, which does not allocate anything before the first message,
+ * the unread counter and the topic.
+ */
+static struct channel **tab_chans;
+
+/* Number of channel log widgets created */
+static unsigned int chan_widgets;
+
+static int tabs_append(const char *label, gp_widget *child, struct channel *chan)
 {
-	char buf[1024];
-	va_list args;
+	struct channel **tmp = gp_vec_expand(tab_chans, 1);
 
-	va_start(args, fmt);
-	vsnprintf(buf, sizeof(buf), fmt, args);
-	va_end(args);
+	if (!tmp)
+		return 1;
 
-	gp_widget_log_append(status_log, buf);
+	tab_chans = tmp;
+	tab_chans[gp_vec_len(tab_chans) - 1] = chan;
+
+	gp_widget_tabs_tab_append(channel_tabs, label, child);
+
+	return 0;
 }
 
-static int channels_init(void)
+static void channels_activated(void);
+
+static void tabs_del(int tab)
 {
-	channels_map = gp_htable_new(0, 0);
+	if (tab < 0)
+		return;
 
-	return !channels_map;
+	tab_chans = gp_vec_del(tab_chans, tab, 1);
+	gp_widget_tabs_tab_del(channel_tabs, tab);
+
+	/* A different tab may have become active */
+	channels_activated();
 }
 
-static void channels_add(const char *chan_name)
+static int tab_by_chan(struct channel *chan)
+{
+	size_t i;
+
+	for (i = 0; i < gp_vec_len(tab_chans); i++) {
+		if (tab_chans[i] == chan)
+			return i;
+	}
+
+	return -1;
+}
+
+static void channels_add(struct network *net, const char *chan_name, const char *key)
 {
-	gp_widget *channel_log;
 	struct channel *channel;
+	char label[256];
 
-	channel = malloc(sizeof(struct channel));
+	channel = calloc(1, sizeof(struct channel));
 	if (!channel)
 		goto err0;
 
@@ -87,27 +389,31 @@ static void channels_add(const char *chan_name)
 	if (!channel->name)
 		goto err1;
 
-	channel->nicks = gp_vec_new(0, sizeof(char **));
-	if (!channel->nicks)
-		goto err2;
+	if (key) {
+		channel->key = strdup(key);
+		if (!channel->key)
+			goto err2;
+	}
 
-	channel_log = gp_widget_log_new(GP_TATTR_MONO, 80, 25, 1000);
-	if (!channel_log)
-		goto err3;
+	if (gp_vec_len(networks) > 1)
+		snprintf(label, sizeof(label), "%s/%s", net_name(net), chan_name);
+	else
+		snprintf(label, sizeof(label), "%s", chan_name);
 
-	channel->topic = NULL;
+	if (tabs_append(label, NULL, channel))
+		goto err2;
 
+	gpirc_nicks_init(&channel->nicks, &net->users, channel);
+	gpirc_msgs_init(&channel->msgs, CHAN_MSGS_MAX, CHAN_MSGS_BUF_MAX);
 
-	channel->channel_log = channel_log;
-	channel_log->priv = channel;
-	gp_htable_put(channels_map, channel, channel->name);
-	channel_log->align = GP_FILL;
-	gp_widget_tabs_tab_append(channel_tabs, chan_name, channel_log);
+	channel->net = net;
+	channel->log = gpirc_log_open(net_name(net), chan_name);
+	channel->search_src = gpirc_search_src(net_name(net), chan_name);
+	gp_htable_put(net->channels_map, channel, channel->name);
 
 	return;
-err3:
-	gp_vec_free(channel->nicks);
 err2:
+	free(channel->key);
 	free(channel->name);
 err1:
 	free(channel);
@@ -115,573 +421,3478 @@ err0:
 	gp_widget_log_append(status_log, "Allocation failure");
 }
 
-static void channels_rem(gp_widget *channel_log)
+/*
+ * Creates the log widget once the channel tab is shown.
+ */
+static int channel_show(struct channel *channel, unsigned int tab)
+{
+	gp_widget *channel_log;
+
+	if (channel->channel_log)
+		return 0;
+
+	channel_log = gp_widget_log_new(GP_TATTR_MONO, 80, 25, CHAN_LOG_LINES);
+	if (!channel_log) {
+		status_log_append("Allocation failure");
+		return 1;
+	}
+
+	channel_log->priv = channel;
+	channel_log->align = GP_FILL;
+	channel->channel_log = channel_log;
+	chan_widgets++;
+
+	gp_widget_tabs_put(channel_tabs, tab, channel_log);
+
+	return 0;
+}
+
+static void split_chan_rem(struct channel *chan);
+static void act_chan_rem(struct channel *chan);
+static void frame_schedule(void);
+static void hist_close(struct hist_view *view);
+
+static void channels_rem(struct channel *channel)
+{
+	if (channel->hist)
+		hist_close(channel->hist);
+
+	gpirc_net_send(channel->net->session, "PART %s", channel->name);
+
+	gp_htable_rem(channel->net->channels_map, channel->name);
+
+	if (channel->channel_log)
+		chan_widgets--;
+
+	tabs_del(tab_by_chan(channel));
+
+	split_chan_rem(channel);
+	act_chan_rem(channel);
+	frame_schedule();
+
+	gpirc_log_close(channel->log);
+	gpirc_nicks_free(&channel->nicks);
+	gpirc_msgs_free(&channel->msgs);
+	free(channel->topic);
+	free(channel->key);
+	free(channel->name);
+	free(channel);
+}
+
+static struct channel *chan_by_name(struct network *net, const char *chan_name)
+{
+	struct channel *channel = gp_htable_get(net->channels_map, chan_name);
+
+	if (!channel)
+		net_log_printf(net, "Channel '%s' does not exist!", chan_name);
+
+	return channel;
+}
+
+static gp_widget *channels_active(void);
+static struct channel *channels_active_chan(void);
+
+/*
+ * Formats a message into a buffer that is reused between calls.
+ */
+static const char *render_msg(struct channel *chan, struct gpirc_msg *msg)
+{
+	static char *buf;
+	static size_t buf_size;
+	const char *body = gpirc_msg_body(&chan->msgs, msg);
+	const char *sender = msg->sender ? msg->sender->str : NULL;
+	int len;
+
+	len = gpirc_msg_fmt(buf, buf_size, msg->type, sender, body, chan->name);
+	if (len < 0)
+		return "";
+
+	if ((size_t)len < buf_size)
+		return buf;
+
+	char *tmp = realloc(buf, len + 1);
+
+	if (!tmp)
+		return buf ? buf : "";
+
+	buf = tmp;
+	buf_size = len + 1;
+
+	gpirc_msg_fmt(buf, buf_size, msg->type, sender, body, chan->name);
+
+	return buf;
+}
+
+static void chan_render(struct channel *chan, struct gpirc_msg *msg)
+{
+	const char *line;
+
+	if (msg->type == GPIRC_MSG_INFO)
+		line = gpirc_msg_body(&chan->msgs, msg);
+	else
+		line = render_msg(chan, msg);
+
+	gp_widget_log_append(chan->channel_log, line);
+}
+
+/*
+ * Renders messages that were stored since the last call, at most the number
+ * of lines the log widget can hold.
+ */
+static void chan_render_pending(struct channel *chan)
+{
+	uint64_t id = chan->rendered;
+
+	if (!chan->channel_log)
+		return;
+
+	if (chan->msgs.tail - id > CHAN_LOG_LINES)
+		id = chan->msgs.tail - CHAN_LOG_LINES;
+
+	if (id < chan->msgs.head)
+		id = chan->msgs.head;
+
+	for (; id < chan->msgs.tail; id++)
+		chan_render(chan, gpirc_msgs_get(&chan->msgs, id));
+
+	chan->rendered = chan->msgs.tail;
+}
+
+/*
+ * Channels with unread messages, shown in the status bar.
+ */
+static struct channel *act_chans;
+static int act_changed;
+
+static struct redraw_stats {
+	uint64_t msgs;
+	uint64_t redraws;
+	uint64_t ignored;
+	uint64_t highlights;
+	/* Time spent rendering pending messages in ns */
+	struct gpirc_stats_hist render;
+} redraw_stats;
+
+/*
+ * Appends the current and the smoothed server lag, while a PING waits for a
+ * reply longer than the last lag the time waited so far is shown instead.
+ */
+static void status_bar_lag(char **str)
+{
+	uint64_t now = gpirc_monotonic_ns();
+	size_t i;
+	int first = 1;
+
+	for (i = 0; i < gp_vec_len(networks); i++) {
+		struct lag *lag = &networks[i]->lag;
+		uint64_t cur = lag->cur_ns;
+		char buf[128];
+
+		if (!lag->running || !lag->avg_ns)
+			continue;
+
+		if (lag->ping_ns && now - lag->ping_ns > cur)
+			cur = now - lag->ping_ns;
+
+		if (first && **str)
+			GP_VEC_STR_APPEND(*str, " ");
+
+		if (gp_vec_len(networks) > 1) {
+			snprintf(buf, sizeof(buf), "%s%s %.2fs(%.2fs)", first ? "[Lag: " : " ",
+			         net_name(networks[i]), cur / 1e9, lag->avg_ns / 1e9);
+		} else {
+			snprintf(buf, sizeof(buf), "[Lag: %.2fs(%.2fs)",
+			         cur / 1e9, lag->avg_ns / 1e9);
+		}
+
+		GP_VEC_STR_APPEND(*str, buf);
+		first = 0;
+	}
+
+	if (!first)
+		GP_VEC_STR_APPEND(*str, "]");
+}
+
+/*
+ * Appends send queues that are not empty, returns non-zero if there are any.
+ */
+static int status_bar_sendq(char **str)
+{
+	size_t i;
+	int ret = 0;
+
+	for (i = 0; i < gp_vec_len(networks); i++) {
+		struct gpirc_net_sendq sendq;
+		char buf[128];
+
+		gpirc_net_sendq(networks[i]->session, &sendq);
+
+		if (!sendq.queued)
+			continue;
+
+		if (!ret && **str)
+			GP_VEC_STR_APPEND(*str, " ");
+
+		snprintf(buf, sizeof(buf), "%s%s(%u%s)", ret ? " " : "[Sendq: ",
+		         net_name(networks[i]), sendq.queued, sendq.throttled ? " throttled" : "");
+		GP_VEC_STR_APPEND(*str, buf);
+		ret = 1;
+	}
+
+	if (ret)
+		GP_VEC_STR_APPEND(*str, "]");
+
+	return ret;
+}
+
+static int status_bar_update(void)
+{
+	struct channel *chan;
+	int sendq;
+
+	if (!status_bar)
+		return 0;
+
+	char *str = gp_vec_str_new();
+
+	if (!str)
+		return 0;
+
+	for (chan = act_chans; chan; chan = chan->act_next) {
+		char buf[64];
+
+		snprintf(buf, sizeof(buf), "%s%s(%u%s)", str[0] ? " " : "[Act: ",
+		         chan->name, chan->unread, chan->highlight ? "!" : "");
+		GP_VEC_STR_APPEND(str, buf);
+	}
+
+	if (str[0])
+		GP_VEC_STR_APPEND(str, "]");
+
+	status_bar_lag(&str);
+	sendq = status_bar_sendq(&str);
+
+	gp_widget_label_set(status_bar, str);
+
+	gp_vec_free(str);
+
+	return sendq;
+}
+
+/*
+ * The send queues are drained by the network thread, the status bar is
+ * refreshed periodically while any of them is not empty.
+ */
+#define SENDQ_POLL_MS 250
+
+static int sendq_polling;
+
+static uint32_t sendq_poll(gp_timer *self)
+{
+	(void) self;
+
+	if (status_bar_update())
+		return SENDQ_POLL_MS;
+
+	sendq_polling = 0;
+
+	return GP_TIMER_STOP;
+}
+
+static gp_timer sendq_timer = {
+	.callback = sendq_poll,
+	.id = "Sendq poll",
+};
+
+/*
+ * Called after lines were queued.
+ */
+static void sendq_watch(void)
+{
+	if (sendq_polling)
+		return;
+
+	sendq_polling = 1;
+	sendq_timer.expires = 0;
+	gp_widgets_timer_ins(&sendq_timer);
+}
+
+static void act_chan_rem(struct channel *chan)
+{
+	struct channel **i;
+
+	if (!chan->unread)
+		return;
+
+	for (i = &act_chans; *i; i = &(*i)->act_next) {
+		if (*i == chan) {
+			*i = chan->act_next;
+			break;
+		}
+	}
+
+	chan->unread = 0;
+	chan->highlight = 0;
+	act_changed = 1;
+}
+
+static void act_chan_add(struct channel *chan)
+{
+	if (!chan->unread++) {
+		chan->act_next = act_chans;
+		act_chans = chan;
+	}
+
+	act_changed = 1;
+}
+
+/*
+ * Messages are rendered into the active tab and the status bar is updated at
+ * most once per frame, no matter how many messages arrived in between.
+ */
+#define FRAME_MS 16
+
+static int frame_pending;
+
+static uint32_t frame_flush(gp_timer *self)
+{
+	struct channel *chan = channels_active_chan();
+
+	(void) self;
+
+	frame_pending = 0;
+
+	if (chan && chan->rendered != chan->msgs.tail) {
+		uint64_t start = gpirc_monotonic_ns();
+
+		chan_render_pending(chan);
+		redraw_stats.redraws++;
+		gpirc_stats_hist_add(&redraw_stats.render, gpirc_monotonic_ns() - start);
+	}
+
+	if (act_changed) {
+		act_changed = 0;
+		status_bar_update();
+	}
+
+	return GP_TIMER_STOP;
+}
+
+static gp_timer frame_timer = {
+	.callback = frame_flush,
+	.id = "Frame flush",
+};
+
+static void frame_schedule(void)
+{
+	if (frame_pending)
+		return;
+
+	frame_pending = 1;
+	frame_timer.expires = FRAME_MS;
+	gp_widgets_timer_ins(&frame_timer);
+}
+
+static void chan_rate_add(struct channel *chan, time_t time)
+{
+	uint32_t min = time / 60;
+
+	if (min != chan->rate_min) {
+		chan->rate_prev = min == chan->rate_min + 1 ? chan->rate_cur : 0;
+		chan->rate_cur = 0;
+		chan->rate_min = min;
+	}
+
+	chan->rate_cur++;
+}
+
+/*
+ * Messages per minute over the last minute, the previous minute count is
+ * weighted by how much of it is still in the window.
+ */
+static double chan_rate(struct channel *chan, time_t now)
+{
+	uint32_t min = now / 60;
+	double prev = 1 - (now % 60) / 60.0;
+
+	if (min == chan->rate_min)
+		return chan->rate_cur + chan->rate_prev * prev;
+
+	if (min == chan->rate_min + 1)
+		return chan->rate_cur * prev;
+
+	return 0;
+}
+
+/*
+ * Hidden channels only store the message and bump the unread counter, the
+ * text is rendered once the tab is activated.
+ */
+static void chan_msg_stored(struct channel *chan, struct gpirc_msg *msg)
+{
+	const char *sender = msg->sender ? msg->sender->str : NULL;
+	const char *body = gpirc_msg_body(&chan->msgs, msg);
+
+	gpirc_log_write(chan->log, msg->time, msg->type, sender, body, msg->len);
+	gpirc_search_add(chan->search_src, msg->time, msg->type, sender, body, chan->name);
+
+	latency_sample();
+
+	redraw_stats.msgs++;
+	chan_rate_add(chan, msg->time);
+
+	if (channels_active_chan() != chan)
+		act_chan_add(chan);
+
+	frame_schedule();
+}
+
+/* The message being dispatched, NULL outside of net_msg() */
+static const struct gpirc_proto_msg *cur_msg;
+
+/*
+ * Returns the IRCv3 server-time of the message being dispatched, the current
+ * time if there is none. History played back by the server is stamped with
+ * the time the messages were sent.
+ */
+static time_t msg_time(void)
+{
+	const struct gpirc_proto_msg *msg = cur_msg;
+	struct gpirc_proto_str val;
+	time_t ret;
+
+	if (msg && !gpirc_proto_tag_get(msg, "time", &val) &&
+	    !gpirc_proto_tag_time(&val, &ret))
+		return ret;
+
+	return time(NULL);
+}
+
+/*
+ * Stores a message with the mIRC formatting codes stripped. The log widget
+ * renders plain text lines only, so the style is not kept.
+ */
+static struct gpirc_msg *chan_msg_add(struct channel *chan, enum gpirc_msg_type type,
+                                      const char *sender, const char *body)
+{
+	size_t len = strlen(body), spans_cnt;
+	struct gpirc_msg *msg;
+	char buf[512], *text = buf;
+
+	if (gpirc_fmt_plain(body, len))
+		return gpirc_msgs_add(&chan->msgs, type, msg_time(), sender, body, len);
+
+	if (len > sizeof(buf)) {
+		text = malloc(len);
+		if (!text)
+			return NULL;
+	}
+
+	len = gpirc_fmt_parse(body, len, text, NULL, &spans_cnt);
+
+	msg = gpirc_msgs_add(&chan->msgs, type, msg_time(), sender, text, len);
+
+	if (text != buf)
+		free(text);
+
+	return msg;
+}
+
+static void chan_msg(struct network *net, const char *chan_name,
+                     enum gpirc_msg_type type, const char *sender,
+                     const char *body)
+{
+	struct channel *chan = chan_by_name(net, chan_name);
+
+	if (!chan)
+		return;
+
+	struct gpirc_msg *msg;
+
+	msg = chan_msg_add(chan, type, sender, body);
+	if (!msg) {
+		status_log_append("Allocation failure");
+		return;
+	}
+
+	if (type == GPIRC_MSG_PRIVMSG && sender) {
+		struct gpirc_member *member = gpirc_nicks_get(&chan->nicks, sender);
+
+		if (member)
+			gpirc_nicks_spoke(&chan->nicks, member);
+	}
+
+	chan_msg_stored(chan, msg);
+}
+
+/*
+ * The log widget has no colors, a highlight in a channel that is not active
+ * marks the channel in the status bar and is copied into the status log.
+ */
+static void chan_highlight(struct network *net, const char *chan_name,
+                           const char *nick, const char *text)
+{
+	struct channel *chan = gp_htable_get(net->channels_map, chan_name);
+
+	if (!chan)
+		return;
+
+	redraw_stats.highlights++;
+
+	if (!chan->unread)
+		return;
+
+	if (!chan->highlight) {
+		chan->highlight = 1;
+		act_changed = 1;
+	}
+
+	net_log_printf(net, "-!- Highlight %s <%s> %s", chan->name, nick, text);
+}
+
+static void channels_printf(struct network *net, const char *chan_name,
+                            const char *fmt, ...)
+{
+	struct channel *chan = chan_by_name(net, chan_name);
+	struct gpirc_msg *msg;
+	va_list args;
+	int len;
+
+	if (!chan)
+		return;
+
+	va_start(args, fmt);
+	len = vsnprintf(NULL, 0, fmt, args);
+	va_end(args);
+
+	if (len < 0)
+		return;
+
+	msg = gpirc_msgs_add(&chan->msgs, GPIRC_MSG_INFO, msg_time(), NULL, NULL, len);
+	if (!msg) {
+		status_log_append("Allocation failure");
+		return;
+	}
+
+	va_start(args, fmt);
+	vsnprintf(gpirc_msg_body(&chan->msgs, msg), len + 1, fmt, args);
+	va_end(args);
+
+	chan_msg_stored(chan, msg);
+}
+
+static gp_widget *channels_active(void)
+{
+	return gp_widget_tabs_active_child_get(channel_tabs);
+}
+
+static int channels_is_status_log(gp_widget *self)
+{
+	return self == status_log;
+}
+
+/*
+ * Browsing channel logs stored on disk, one history tab per channel.
+ *
+ * The tab shows a page of lines at a time, rendered straight from the
+ * memory-mapped log, so going back by years costs the same as going back by
+ * a page.
+ */
+#define HIST_PAGE 100
+
+struct hist_view {
+	struct channel *chan;
+	gp_widget *log;
+	struct gpirc_hist hist;
+	/* First line on the page */
+	size_t top;
+	struct hist_view *next;
+};
+
+static struct hist_view *hist_views;
+
+static struct hist_view *hist_by_widget(gp_widget *self)
+{
+	struct hist_view *i;
+
+	for (i = hist_views; i; i = i->next) {
+		if (i->log == self)
+			return i;
+	}
+
+	return NULL;
+}
+
+/*
+ * Returns the channel shown in the active tab or NULL for the status log,
+ * history and search tabs.
+ */
+static struct channel *channels_active_chan(void)
+{
+	unsigned int tab = gp_widget_tabs_active_get(channel_tabs);
+
+	if (tab >= gp_vec_len(tab_chans))
+		return NULL;
+
+	return tab_chans[tab];
+}
+
+static void hist_show(struct hist_view *view, size_t top)
+{
+	size_t nr, lines = gpirc_hist_lines(&view->hist);
+	char buf[1024];
+
+	if (lines < HIST_PAGE)
+		top = 0;
+	else if (top > lines - HIST_PAGE)
+		top = lines - HIST_PAGE;
+
+	view->top = top;
+
+	gp_widget_log_flush(view->log);
+
+	for (nr = top; nr < lines && nr < top + HIST_PAGE; nr++) {
+		struct gpirc_hist_line line;
+
+		if (gpirc_hist_line(&view->hist, nr, &line)) {
+			gp_widget_log_append(view->log, "-!- Failed to read the log");
+			break;
+		}
+
+		if (line.day_first) {
+			time_t time = line.time;
+			struct tm tm;
+
+			localtime_r(&time, &tm);
+			strftime(buf, sizeof(buf), "-!- Day changed to %Y-%m-%d", &tm);
+			gp_widget_log_append(view->log, buf);
+		}
+
+		snprintf(buf, sizeof(buf), "%.*s", (int)line.len, line.str);
+		gp_widget_log_append(view->log, buf);
+	}
+
+	snprintf(buf, sizeof(buf), "-!- History lines %zu-%zu of %zu",
+	         lines ? top + 1 : 0, nr, lines);
+	gp_widget_log_append(view->log, buf);
+}
+
+static void hist_move(struct hist_view *view, int dir, size_t cnt)
+{
+	if (dir < 0) {
+		hist_show(view, view->top > cnt ? view->top - cnt : 0);
+		return;
+	}
+
+	/* Paging forward may reach lines logged after the tab was opened */
+	gpirc_hist_refresh(&view->hist);
+
+	if (cnt > gpirc_hist_lines(&view->hist))
+		cnt = gpirc_hist_lines(&view->hist);
+
+	hist_show(view, view->top + cnt);
+}
+
+static void hist_open(struct channel *chan)
+{
+	struct hist_view *view = chan->hist;
+	char label[256];
+	char *dir;
+
+	if (view) {
+		gpirc_hist_refresh(&view->hist);
+		goto show;
+	}
+
+	dir = gpirc_log_dir(net_name(chan->net), chan->name);
+	if (!dir) {
+		gp_widget_log_append(chan->channel_log, "-!- Disk logging is disabled");
+		return;
+	}
+
+	view = calloc(1, sizeof(*view));
+	if (!view)
+		goto err0;
+
+	if (gpirc_hist_open(&view->hist, dir))
+		goto err1;
+
+	view->log = gp_widget_log_new(GP_TATTR_MONO, 80, 25, HIST_PAGE + 2);
+	if (!view->log)
+		goto err2;
+
+	view->log->align = GP_FILL;
+	view->chan = chan;
+	view->next = hist_views;
+	hist_views = view;
+	chan->hist = view;
+
+	snprintf(label, sizeof(label), "%s history", chan->name);
+	if (tabs_append(label, view->log, NULL))
+		goto err3;
+
+	free(dir);
+show:
+	hist_show(view, SIZE_MAX);
+	gp_widget_tabs_active_set(channel_tabs,
+		gp_widget_tabs_tab_by_child(channel_tabs, view->log));
+	return;
+err3:
+	hist_views = view->next;
+	chan->hist = NULL;
+	gp_widget_free(view->log);
+err2:
+	gpirc_hist_close(&view->hist);
+err1:
+	free(view);
+err0:
+	free(dir);
+	gp_widget_log_append(chan->channel_log, "Allocation failure");
+}
+
+static void hist_close(struct hist_view *view)
+{
+	struct hist_view **i;
+
+	for (i = &hist_views; *i; i = &(*i)->next) {
+		if (*i == view) {
+			*i = view->next;
+			break;
+		}
+	}
+
+	view->chan->hist = NULL;
+	gpirc_hist_close(&view->hist);
+	tabs_del(gp_widget_tabs_tab_by_child(channel_tabs, view->log));
+	free(view);
+}
+
+static void channels_join(struct network *net, const char *name, const char *pass)
+{
+	net_log_printf(net, "Joining channel '%s'", name);
+
+	channels_add(net, name, pass);
+
+	if (pass)
+		gpirc_net_send(net->session, "JOIN %s %s", name, pass);
+	else
+		gpirc_net_send(net->session, "JOIN %s", name);
+}
+
+static void chan_add_nick(struct network *net, const char *chan_name,
+                          const char *nick, const char *mask)
+{
+	struct channel *chan = chan_by_name(net, chan_name);
+	struct gpirc_member *member;
+
+	if (!chan)
+		return;
+
+	member = gpirc_nicks_add(&chan->nicks, nick, strlen(nick));
+	if (!member) {
+		status_log_append("Allocation failure");
+		return;
+	}
+
+	gpirc_user_origin_set(member->user, mask);
+}
+
+/*
+ * NAMES replies are applied as a diff so that a rejoin does not rebuild the
+ * member list, members that were not listed are removed at the end.
+ */
+static void chan_names_start(struct channel *chan)
+{
+	if (chan->names_pending)
+		return;
+
+	chan->names_pending = 1;
+	chan->names_cnt = gpirc_nicks_cnt(&chan->nicks);
+	gpirc_nicks_mark(&chan->nicks);
+}
+
+static void chan_print_nicks(struct network *net, const char *chan_name);
+
+/* Messages asked for with CHATHISTORY after a rejoin */
+#define HISTORY_FETCH 100
+
+static time_t chan_last_msg_time(struct channel *chan)
+{
+	uint64_t id;
+
+	for (id = chan->msgs.tail; id-- > chan->msgs.head;) {
+		struct gpirc_msg *msg = gpirc_msgs_get(&chan->msgs, id);
+
+		if (msg->type == GPIRC_MSG_PRIVMSG)
+			return msg->time;
+	}
+
+	return 0;
+}
+
+/*
+ * Asks the server for the messages we missed while disconnected, these come
+ * back in a chathistory batch.
+ */
+static void chan_history_fetch(struct channel *chan)
+{
+	struct network *net = chan->net;
+	char stamp[32];
+	struct tm tm;
+	time_t last;
+
+	if (!CAP_ENABLED(net, CAP_CHATHISTORY))
+		return;
+
+	last = chan_last_msg_time(chan);
+	if (!last)
+		return;
+
+	chan->history_after = last;
+
+	gmtime_r(&last, &tm);
+	strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S.000Z", &tm);
+
+	gpirc_net_send_prio(net->session, GPIRC_NET_BULK, "CHATHISTORY LATEST %s timestamp=%s %u",
+	                    chan->name, stamp, HISTORY_FETCH);
+}
+
+/*
+ * The timestamp we ask for is rounded down to a second, so the history may
+ * start with messages we already have.
+ */
+static int chan_history_dup(struct channel *chan, time_t time,
+                            const char *sender, const char *body)
+{
+	uint64_t id;
+
+	if (time < chan->history_after)
+		return 1;
+
+	if (time > chan->history_after)
+		return 0;
+
+	for (id = chan->msgs.tail; id-- > chan->msgs.head;) {
+		struct gpirc_msg *msg = gpirc_msgs_get(&chan->msgs, id);
+
+		if (msg->type != GPIRC_MSG_PRIVMSG || msg->time > time)
+			continue;
+
+		if (msg->time < time)
+			break;
+
+		if (msg->sender && !strcmp(msg->sender->str, sender) &&
+		    !strcmp(gpirc_msg_body(&chan->msgs, msg), body))
+			return 1;
+	}
+
+	return 0;
+}
+
+static void chan_names_end(struct network *net, const char *chan_name)
+{
+	struct channel *chan = chan_by_name(net, chan_name);
+	size_t left, joined;
+
+	if (!chan)
+		return;
+
+	if (!chan->names_pending) {
+		chan_print_nicks(net, chan_name);
+		return;
+	}
+
+	chan->names_pending = 0;
+	left = gpirc_nicks_sweep(&chan->nicks);
+
+	if (!chan->rejoin) {
+		chan_print_nicks(net, chan_name);
+		return;
+	}
+
+	chan->rejoin = 0;
+	joined = gpirc_nicks_cnt(&chan->nicks) - (chan->names_cnt - left);
+
+	channels_printf(net, chan_name, "-!- Rejoined %s, %zu joined and %zu left meanwhile, total of %zu nicks",
+	                chan_name, joined, left, gpirc_nicks_cnt(&chan->nicks));
+
+	chan_history_fetch(chan);
+}
+
+static void chan_add_nicks(struct network *net, const char *chan_name, const char *nicks)
+{
+	struct channel *chan = chan_by_name(net, chan_name);
+
+	if (!chan)
+		return;
+
+	chan_names_start(chan);
+
+	/* Make room for the whole NAMES line upfront */
+	size_t i, cnt = 1;
+
+	for (i = 0; nicks[i]; i++)
+		cnt += nicks[i] == ' ';
+
+	if (gpirc_nicks_reserve(&chan->nicks, gpirc_nicks_cnt(&chan->nicks) + cnt)) {
+		status_log_append("Allocation failure");
+		return;
+	}
+
+	for (;;) {
+		size_t nick_len = 0;
+
+		while (nicks[nick_len] && nicks[nick_len] != ' ')
+			nick_len++;
+
+		if (!nick_len)
+			return;
+
+		if (!gpirc_nicks_add(&chan->nicks, nicks, nick_len)) {
+			status_log_append("Allocation failure");
+			return;
+		}
+
+		while (nicks[nick_len] && nicks[nick_len] == ' ')
+			nick_len++;
+
+		nicks += nick_len;
+	}
+}
+
+static void chan_rem_nick(struct network *net, const char *chan_name, const char *nick)
+{
+	struct channel *chan = chan_by_name(net, chan_name);
+
+	if (!chan)
+		return;
+
+	gpirc_nicks_rem(&chan->nicks, nick);
+}
+
+static void chan_print_nicks(struct network *net, const char *chan_name)
+{
+	struct channel *chan = chan_by_name(net, chan_name);
+	struct gpirc_member **sorted;
+	size_t i, away = 0;
+
+	if (!chan)
+		return;
+
+	channels_printf(net, chan_name, "-!- [Users %s]", chan_name);
+
+	sorted = gpirc_nicks_sorted(&chan->nicks);
+	if (!sorted)
+		return;
+
+	char *nicks = gp_vec_str_new();
+
+	if (!nicks)
+		return;
+
+	for (i = 0; i < gpirc_nicks_cnt(&chan->nicks); i++) {
+		char prefix[4] = {'[', gpirc_nick_prefix(sorted[i]->flags), 0};
+
+		if (i)
+			GP_VEC_STR_APPEND(nicks, " ");
+		GP_VEC_STR_APPEND(nicks, prefix);
+		GP_VEC_STR_APPEND(nicks, sorted[i]->user->nick);
+		GP_VEC_STR_APPEND(nicks, "]");
+
+		away += sorted[i]->user->away;
+	}
+
+	channels_printf(net, chan_name, "-!- %s", nicks);
+
+	gp_vec_free(nicks);
+
+	/* The away state is known only from the IRCv3 away-notify */
+	if (away) {
+		channels_printf(net, chan_name, "-!- %s: Total of %zu nicks, %zu away",
+		                chan_name, gpirc_nicks_cnt(&chan->nicks), away);
+		return;
+	}
+
+	channels_printf(net, chan_name, "-!- %s: Total of %zu nicks",
+	                chan_name, gpirc_nicks_cnt(&chan->nicks));
+}
+
+static void set_topic_label(const char *topic_str)
+{
+	if (!topic)
+		return;
+
+	if (topic_str)
+		gp_widget_label_set(topic, topic_str);
+	else
+		gp_widget_label_set(topic, "(none)");
+}
+
+static void channels_activated(void)
+{
+	struct channel *channel = channels_active_chan();
+	gp_widget *active_child = channels_active();
+
+	if (channels_is_status_log(active_child)) {
+		set_topic_label("gpirc 1.0");
+		return;
+	}
+
+	if (!channel && active_child == search_log) {
+		set_topic_label("Search results");
+		return;
+	}
+
+	struct hist_view *view = hist_by_widget(active_child);
+
+	if (!channel && view) {
+		char buf[256];
+
+		snprintf(buf, sizeof(buf), "History of %s", view->chan->name);
+		set_topic_label(buf);
+		return;
+	}
+
+	if (!channel)
+		return;
+
+	cur_net = channel->net;
+
+	if (channel_show(channel, gp_widget_tabs_active_get(channel_tabs)))
+		return;
+
+	chan_render_pending(channel);
+	set_topic_label(channel->topic);
+
+	act_chan_rem(channel);
+	frame_schedule();
+}
+
+static int channels_on_event(gp_widget_event *ev)
+{
+	if (ev->type != GP_WIDGET_EVENT_WIDGET)
+		return 0;
+
+	if (ev->sub_type != GP_WIDGET_TABS_ACTIVATED)
+		return 0;
+
+	channels_activated();
+
+	return 1;
+}
+
+/*
+ * Netsplit and netjoin aggregation.
+ *
+ * Users that quit with a netsplit reason are removed from the channels right
+ * away but the output is collected per channel and flushed once the split
+ * window expires, or when the server closes the IRCv3 netsplit batch. The
+ * user records are kept alive for a while so that the JOINs that follow once
+ * the servers are relinked can be collapsed as well.
+ */
+#define SPLIT_WINDOW_MS 1000
+#define SPLIT_EXPIRE_MS (10 * 60 * 1000)
+#define SPLIT_NICKS_MAX 15
+
+static int is_netsplit(const char *reason)
+{
+	const char *sp = strchr(reason, ' ');
+
+	if (!sp || sp == reason || strchr(sp + 1, ' '))
+		return 0;
+
+	return memchr(reason, '.', sp - reason) && strchr(sp + 1, '.');
+}
+
+static void split_nick_append(char **nicks, unsigned int cnt, const char *nick)
+{
+	if (!*nicks) {
+		*nicks = gp_vec_str_new();
+		if (!*nicks)
+			return;
+	}
+
+	if (cnt > SPLIT_NICKS_MAX)
+		return;
+
+	if (cnt > 1)
+		GP_VEC_STR_APPEND(*nicks, ", ");
+
+	GP_VEC_STR_APPEND(*nicks, cnt > SPLIT_NICKS_MAX - 1 ? "..." : nick);
+}
+
+static void split_chan_add(struct channel *chan, const char *nick, int join)
+{
+	struct netsplit *netsplit = &chan->net->netsplit;
+
+	if (join)
+		split_nick_append(&chan->split_join_nicks, ++chan->split_joins, nick);
+	else
+		split_nick_append(&chan->split_quit_nicks, ++chan->split_quits, nick);
+
+	if (chan->split_pending)
+		return;
+
+	chan->split_pending = 1;
+	chan->split_next = netsplit->chans;
+	netsplit->chans = chan;
+}
+
+static void split_chan_rem(struct channel *chan)
+{
+	struct channel **i;
+
+	if (!chan->split_pending)
+		return;
+
+	for (i = &chan->net->netsplit.chans; *i; i = &(*i)->split_next) {
+		if (*i == chan) {
+			*i = chan->split_next;
+			break;
+		}
+	}
+
+	gp_vec_free(chan->split_quit_nicks);
+	gp_vec_free(chan->split_join_nicks);
+}
+
+static void split_flush(struct network *net)
+{
+	struct netsplit *netsplit = &net->netsplit;
+	struct channel *chan, *next;
+
+	for (chan = netsplit->chans; chan; chan = next) {
+		next = chan->split_next;
+
+		if (chan->split_quits) {
+			channels_printf(net, chan->name, "-!- Netsplit: %u users [%s] quits: %s",
+			                chan->split_quits, netsplit->servers,
+			                chan->split_quit_nicks ? chan->split_quit_nicks : "");
+		}
+
+		if (chan->split_joins) {
+			channels_printf(net, chan->name, "-!- Netsplit over: %u users joins: %s",
+			                chan->split_joins,
+			                chan->split_join_nicks ? chan->split_join_nicks : "");
+		}
+
+		gp_vec_free(chan->split_quit_nicks);
+		gp_vec_free(chan->split_join_nicks);
+		chan->split_quit_nicks = NULL;
+		chan->split_join_nicks = NULL;
+		chan->split_quits = 0;
+		chan->split_joins = 0;
+		chan->split_pending = 0;
+	}
+
+	netsplit->chans = NULL;
+	netsplit->servers[0] = 0;
+}
+
+static uint32_t split_flush_timeout(gp_timer *self)
+{
+	struct network *net = self->priv;
+
+	/* The server told us that the batch is not finished yet */
+	if (net->netsplit.batches)
+		return self->period;
+
+	net->netsplit.timer_running = 0;
+	split_flush(net);
+
+	return GP_TIMER_STOP;
+}
+
+static uint32_t split_expire(gp_timer *self)
+{
+	struct network *net = self->priv;
+	struct netsplit *netsplit = &net->netsplit;
+
+	netsplit->expire_running = 0;
+
+	if (!netsplit->users)
+		return GP_TIMER_STOP;
+
+	GP_VEC_FOREACH(netsplit->users, struct gpirc_user *, user) {
+		(*user)->split = 0;
+		gpirc_users_unref(&net->users, *user);
+	}
+
+	gp_vec_free(netsplit->users);
+	netsplit->users = NULL;
+
+	return GP_TIMER_STOP;
+}
+
+static void split_init(struct network *net)
+{
+	net->netsplit.flush_timer = (gp_timer) {
+		.period = SPLIT_WINDOW_MS,
+		.callback = split_flush_timeout,
+		.id = "Netsplit flush",
+		.priv = net,
+	};
+
+	net->netsplit.expire_timer = (gp_timer) {
+		.callback = split_expire,
+		.id = "Netsplit expire",
+		.priv = net,
+	};
+}
+
+static void split_schedule(struct network *net)
+{
+	struct netsplit *netsplit = &net->netsplit;
+
+	if (netsplit->timer_running)
+		return;
+
+	netsplit->timer_running = 1;
+	netsplit->flush_timer.expires = SPLIT_WINDOW_MS;
+	gp_widgets_timer_ins(&netsplit->flush_timer);
+}
+
+static void split_user_hold(struct network *net, struct gpirc_user *user)
+{
+	struct netsplit *netsplit = &net->netsplit;
+
+	if (user->split)
+		return;
+
+	if (!netsplit->users) {
+		netsplit->users = gp_vec_new(0, sizeof(struct gpirc_user *));
+		if (!netsplit->users)
+			return;
+	}
+
+	gpirc_user_ref(user);
+	user->split = 1;
+	GP_VEC_APPEND(netsplit->users, user);
+
+	if (netsplit->expire_running)
+		gp_widgets_timer_rem(&netsplit->expire_timer);
+
+	netsplit->expire_running = 1;
+	netsplit->expire_timer.expires = SPLIT_EXPIRE_MS;
+	gp_widgets_timer_ins(&netsplit->expire_timer);
+}
+
+static void split_servers_set(struct network *net, const char *servers)
+{
+	struct netsplit *netsplit = &net->netsplit;
+	const char *sp = strchr(servers, ' ');
+
+	if (netsplit->servers[0] || !sp)
+		return;
+
+	snprintf(netsplit->servers, sizeof(netsplit->servers), "%.*s <-> %s",
+	         (int)(sp - servers), servers, sp + 1);
+}
+
+/*
+ * Returns non-zero if the join was collected into a netjoin summary.
+ */
+static int split_join(struct channel *chan, const char *nick)
+{
+	struct gpirc_user *user = gpirc_users_get(&chan->net->users, nick);
+
+	if (!user || !user->split)
+		return 0;
+
+	split_chan_add(chan, nick, 1);
+	split_schedule(chan->net);
+
+	return 1;
+}
+
+static enum batch_type batch_type(const char *type)
+{
+	if (!strcmp(type, "netsplit"))
+		return BATCH_NETSPLIT;
+
+	if (!strcmp(type, "netjoin"))
+		return BATCH_NETJOIN;
+
+	if (!strcmp(type, "chathistory"))
+		return BATCH_CHATHISTORY;
+
+	return BATCH_OTHER;
+}
+
+static struct batch *batch_by_ref(struct network *net, const char *ref)
+{
+	unsigned int i;
+
+	for (i = 0; i < net->batches_cnt; i++) {
+		if (!strcmp(net->batches[i].ref, ref))
+			return &net->batches[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Returns the open batch the message being dispatched belongs to, NULL if none.
+ */
+static struct batch *msg_batch(struct network *net)
+{
+	const struct gpirc_proto_msg *msg = cur_msg;
+	struct gpirc_proto_str val;
+	char ref[32];
+
+	if (!net->batches_cnt || !msg || gpirc_proto_tag_get(msg, "batch", &val))
+		return NULL;
+
+	gpirc_proto_tag_unescape(&val, ref, sizeof(ref));
+
+	return batch_by_ref(net, ref);
+}
+
+static void split_batch_end(struct network *net)
+{
+	struct netsplit *netsplit = &net->netsplit;
+
+	if (!netsplit->batches)
+		return;
+
+	if (--netsplit->batches)
+		return;
+
+	if (netsplit->timer_running)
+		gp_widgets_timer_rem(&netsplit->flush_timer);
+
+	netsplit->timer_running = 0;
+	split_flush(net);
+}
+
+/*
+ * IRCv3 BATCH start and end, the netsplit and netjoin batches hold off the
+ * flush until the server closes them and the chathistory batches carry the
+ * messages missed while disconnected.
+ */
+static void event_batch(void *priv, struct gpirc_proto_msg *msg)
+{
+	struct network *net = priv;
+	struct batch *batch;
+
+	if (msg->param_cnt < 1 || !msg->params[0].str[0])
+		return;
+
+	switch (msg->params[0].str[0]) {
+	case '+':
+		if (msg->param_cnt < 2 || net->batches_cnt >= BATCHES_MAX)
+			return;
+
+		batch = &net->batches[net->batches_cnt++];
+
+		snprintf(batch->ref, sizeof(batch->ref), "%s", msg->params[0].str + 1);
+		snprintf(batch->target, sizeof(batch->target), "%s",
+		         msg->param_cnt >= 3 ? msg->params[2].str : "");
+		batch->type = batch_type(msg->params[1].str);
+		batch->msgs = 0;
+
+		switch (batch->type) {
+		case BATCH_NETSPLIT:
+			if (msg->param_cnt >= 4) {
+				char servers[256];
+
+				snprintf(servers, sizeof(servers), "%s %s",
+				         msg->params[2].str, msg->params[3].str);
+				split_servers_set(net, servers);
+			}
+		/* fallthrough */
+		case BATCH_NETJOIN:
+			net->netsplit.batches++;
+			split_schedule(net);
+		break;
+		default:
+		break;
+		}
+	break;
+	case '-':
+		batch = batch_by_ref(net, msg->params[0].str + 1);
+		if (!batch)
+			return;
+
+		switch (batch->type) {
+		case BATCH_NETSPLIT:
+		case BATCH_NETJOIN:
+			split_batch_end(net);
+		break;
+		case BATCH_CHATHISTORY:
+			channels_printf(net, batch->target, "-!- Fetched %u messages of history",
+			                batch->msgs);
+		break;
+		default:
+		break;
+		}
+
+		*batch = net->batches[--net->batches_cnt];
+	break;
+	}
+}
+
+/*
+ * Autojoin.
+ *
+ * The channel tabs of the network, the configured channels and the channels
+ * that were open before a reconnect, are joined once the server has sent its
+ * limits in RPL_ISUPPORT, which is done by the end of MOTD. Channels are
+ * packed into as few multi-target JOIN lines as the limits allow and the
+ * lines are queued with the bulk priority, the send queue paces them.
+ */
+
+/* Wait for the end of MOTD at most this long */
+#define AUTOJOIN_WAIT_MS 5000
+/* Retry period when the send queue is full */
+#define AUTOJOIN_RETRY_MS 100
+
+static void autojoin_free(struct autojoin *autojoin)
+{
+	if (!autojoin->chans)
+		return;
+
+	GP_VEC_FOREACH(autojoin->chans, struct gpirc_chan, chan) {
+		free(chan->chan);
+		free(chan->pass);
+	}
+
+	gp_vec_free(autojoin->chans);
+	autojoin->chans = NULL;
+}
+
+static int autojoin_add(struct autojoin *autojoin, struct channel *chan)
+{
+	struct gpirc_chan *chans, *last;
+
+	chans = gp_vec_expand(autojoin->chans, 1);
+	if (!chans)
+		return 1;
+
+	autojoin->chans = chans;
+	last = &chans[gp_vec_len(chans) - 1];
+
+	last->chan = strdup(chan->name);
+	last->pass = chan->key ? strdup(chan->key) : NULL;
+
+	if (!last->chan || (chan->key && !last->pass)) {
+		free(last->chan);
+		free(last->pass);
+		autojoin->chans = gp_vec_del(autojoin->chans, gp_vec_len(chans) - 1, 1);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Builds a JOIN line for channels starting at *next. Keys are matched to the
+ * channels by position so channels with a key go first.
+ */
+static char *autojoin_line(struct network *net, size_t *next)
+{
+	struct gpirc_chan *chans = net->autojoin.chans;
+	size_t i, end, cnt = gp_vec_len(chans);
+	size_t max_len = net->isupport.line_len - 2;
+	unsigned int max_targets = net->isupport.join_targets;
+	size_t len = 4, keys_len = 0;
+	int keyed;
+
+	for (end = *next; end < cnt; end++) {
+		size_t chan_len = 1 + strlen(chans[end].chan);
+		size_t key_len = chans[end].pass ? 1 + strlen(chans[end].pass) : 0;
+
+		if (max_targets && end - *next >= max_targets)
+			break;
+
+		if (len + chan_len + keys_len + key_len > max_len)
+			break;
+
+		len += chan_len;
+		keys_len += key_len;
+	}
+
+	/* Does not fit on its own, let the server complain */
+	if (end == *next)
+		end++;
+
+	char *line = gp_vec_str_new();
+	const char *sep = " ";
+
+	if (!line)
+		return NULL;
+
+	GP_VEC_STR_APPEND(line, "JOIN");
+
+	for (keyed = 1; keyed >= 0; keyed--) {
+		for (i = *next; i < end; i++) {
+			if (!chans[i].pass != !keyed)
+				continue;
+
+			GP_VEC_STR_APPEND(line, sep);
+			GP_VEC_STR_APPEND(line, chans[i].chan);
+			sep = ",";
+		}
+	}
+
+	sep = " ";
+
+	for (i = *next; i < end; i++) {
+		if (!chans[i].pass)
+			continue;
+
+		GP_VEC_STR_APPEND(line, sep);
+		GP_VEC_STR_APPEND(line, chans[i].pass);
+		sep = ",";
+	}
+
+	*next = end;
+
+	return line;
+}
+
+static uint32_t autojoin_timeout(gp_timer *self)
+{
+	struct network *net = self->priv;
+	struct autojoin *autojoin = &net->autojoin;
+	size_t cnt = gp_vec_len(autojoin->chans);
+
+	autojoin->started = 1;
+
+	while (autojoin->next < cnt) {
+		size_t next = autojoin->next;
+		char *line = autojoin_line(net, &next);
+
+		if (!line)
+			break;
+
+		/* Send queue full, retry later */
+		if (gpirc_net_send_prio(net->session, GPIRC_NET_BULK, "%s", line)) {
+			gp_vec_free(line);
+			break;
+		}
+
+		gp_vec_free(line);
+		autojoin->next = next;
+		autojoin->lines++;
+	}
+
+	sendq_watch();
+
+	if (autojoin->next < cnt)
+		return AUTOJOIN_RETRY_MS;
+
+	autojoin->running = 0;
+
+	net_log_printf(net, "Sent JOIN for %zu channels in %u lines", cnt, autojoin->lines);
+
+	autojoin_free(autojoin);
+
+	return GP_TIMER_STOP;
+}
+
+static void autojoin_schedule(struct network *net, uint32_t expires)
+{
+	struct autojoin *autojoin = &net->autojoin;
+
+	if (autojoin->running)
+		gp_widgets_timer_rem(&autojoin->timer);
+
+	autojoin->running = 1;
+	autojoin->timer.expires = expires;
+	gp_widgets_timer_ins(&autojoin->timer);
+}
+
+static void autojoin_stop(struct network *net)
+{
+	autojoin_free(&net->autojoin);
+
+	if (!net->autojoin.running)
+		return;
+
+	gp_widgets_timer_rem(&net->autojoin.timer);
+	net->autojoin.running = 0;
+}
+
+static void autojoin_start(struct network *net)
+{
+	struct autojoin *autojoin = &net->autojoin;
+	size_t i;
+
+	autojoin_stop(net);
+
+	autojoin->chans = gp_vec_new(0, sizeof(struct gpirc_chan));
+	if (!autojoin->chans)
+		goto err;
+
+	for (i = 0; i < gp_vec_len(tab_chans); i++) {
+		struct channel *chan = tab_chans[i];
+
+		if (!chan || chan->net != net)
+			continue;
+
+		if (autojoin_add(autojoin, chan))
+			goto err;
+	}
+
+	if (!gp_vec_len(autojoin->chans)) {
+		autojoin_free(autojoin);
+		return;
+	}
+
+	autojoin->next = 0;
+	autojoin->lines = 0;
+	autojoin->started = 0;
+
+	autojoin_schedule(net, AUTOJOIN_WAIT_MS);
+	return;
+err:
+	autojoin_free(autojoin);
+	net_log_printf(net, "Autojoin: Allocation failure");
+}
+
+/*
+ * End of MOTD, the server limits are known now.
+ */
+static void autojoin_motd_end(struct network *net)
+{
+	if (net->autojoin.running && !net->autojoin.started)
+		autojoin_schedule(net, 0);
+}
+
+/*
+ * Reconnect.
+ *
+ * Lost connections are retried with an exponential backoff with jitter so
+ * that clients dropped by a server restart do not come back all at once. The
+ * backoff is reset once a connection stays up long enough. Channel tabs are
+ * kept and rejoined by the autojoin, see chan_names_end() for the member
+ * lists.
+ */
+#define RECONNECT_MIN_MS 1000
+#define RECONNECT_MAX_MS (5 * 60 * 1000)
+#define RECONNECT_STABLE_MS (60 * 1000)
+
+static void do_connect(struct network *net);
+
+static uint32_t reconnect_timeout(gp_timer *self)
+{
+	struct network *net = self->priv;
+
+	net->reconnect.running = 0;
+
+	/* Connected manually in the meantime */
+	if (!gpirc_net_connected(net->session))
+		do_connect(net);
+
+	return GP_TIMER_STOP;
+}
+
+static void reconnect_stop(struct network *net)
+{
+	if (!net->reconnect.running)
+		return;
+
+	gp_widgets_timer_rem(&net->reconnect.timer);
+	net->reconnect.running = 0;
+}
+
+static void reconnect_schedule(struct network *net)
+{
+	struct reconnect *reconnect = &net->reconnect;
+	uint64_t now = gpirc_monotonic_ns();
+	uint32_t delay = RECONNECT_MAX_MS;
+	unsigned int shift;
+
+	if (!net->conf.server || reconnect->running)
+		return;
+
+	if (reconnect->connected_ns &&
+	    now - reconnect->connected_ns >= RECONNECT_STABLE_MS * 1000000ull)
+		reconnect->attempts = 0;
+
+	reconnect->connected_ns = 0;
+
+	shift = reconnect->attempts;
+
+	if (shift < 16 && ((uint32_t)RECONNECT_MIN_MS << shift) < delay)
+		delay = (uint32_t)RECONNECT_MIN_MS << shift;
+
+	/* Equal jitter, at least half of the delay */
+	delay = delay / 2 + random() % (delay / 2 + 1);
+
+	reconnect->attempts++;
+	reconnect->running = 1;
+	reconnect->timer.expires = delay;
+	gp_widgets_timer_ins(&reconnect->timer);
+
+	net_log_printf(net, "Reconnecting in %.1fs (attempt %u)",
+	               delay / 1000.0, reconnect->attempts);
+}
+
+/*
+ * Server lag.
+ *
+ * A PING is sent periodically and the lag is the time until the PONG socket
+ * read. The reconnect is started once a reply takes too long, servers close
+ * the connection after a few minutes without a reply and we would notice only
+ * then.
+ */
+#define LAG_PING_MS (15 * 1000)
+#define LAG_MAX_MS (60 * 1000)
+
+static uint32_t lag_timeout(gp_timer *self)
+{
+	struct network *net = self->priv;
+	struct lag *lag = &net->lag;
+	uint64_t now = gpirc_monotonic_ns();
+
+	if (!lag->ping_ns) {
+		if (!gpirc_net_ping(net->session))
+			lag->ping_ns = now;
+
+		return LAG_PING_MS;
+	}
+
+	status_bar_update();
+
+	if (now - lag->ping_ns < LAG_MAX_MS * 1000000ull)
+		return LAG_PING_MS;
+
+	net_log_printf(net, "No PONG for %.0fs, reconnecting", (now - lag->ping_ns) / 1e9);
+
+	lag->running = 0;
+	gpirc_net_disconnect(net->session, "Lag timeout");
+
+	return GP_TIMER_STOP;
+}
+
+static void lag_start(struct network *net)
+{
+	struct lag *lag = &net->lag;
+
+	if (lag->running)
+		gp_widgets_timer_rem(&lag->timer);
+
+	lag->running = 1;
+	lag->ping_ns = 0;
+	lag->cur_ns = 0;
+	lag->avg_ns = 0;
+	lag->timer.expires = 0;
+	gp_widgets_timer_ins(&lag->timer);
+}
+
+static void lag_stop(struct network *net)
+{
+	struct lag *lag = &net->lag;
+
+	if (lag->running)
+		gp_widgets_timer_rem(&lag->timer);
+
+	lag->running = 0;
+	lag->ping_ns = 0;
+
+	status_bar_update();
+}
+
+static void event_pong(void *priv, struct gpirc_proto_msg *msg)
+{
+	struct network *net = priv;
+	struct lag *lag = &net->lag;
+	uint64_t sent_ns, recv_ns, ns;
+
+	if (!msg->param_cnt || !lag->running)
+		return;
+
+	sent_ns = gpirc_net_pong_ns(msg->params[msg->param_cnt - 1].str);
+	recv_ns = gpirc_net_recv_ns();
+
+	if (!sent_ns || recv_ns < sent_ns)
+		return;
+
+	ns = recv_ns - sent_ns;
+
+	lag->ping_ns = 0;
+	lag->cur_ns = ns;
+	lag->avg_ns = lag->avg_ns ? (7 * lag->avg_ns + ns) / 8 : ns;
+	gpirc_stats_hist_add(&lag->hist, ns);
+
+	status_bar_update();
+}
+
+/*
+ * A nick rule is turned into "\x01nick!" and matched against "\x01" + origin
+ * so that it matches the whole nick only, a rule with '!' or '@' is matched
+ * anywhere in the nick!user@host origin.
+ */
+static int rules_add(struct gpirc_match *match, char **rules, int nicks)
+{
+	char buf[256];
+	size_t i;
+
+	if (!rules)
+		return 0;
+
+	for (i = 0; i < gp_vec_len(rules); i++) {
+		const char *rule = rules[i];
+		size_t len = strlen(rule);
+
+		if (nicks && !strpbrk(rule, "!@")) {
+			len = snprintf(buf, sizeof(buf), "\x01%s!", rule);
+			if (len >= sizeof(buf))
+				continue;
+			rule = buf;
+		}
+
+		if (gpirc_match_add(match, rule, len))
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Compiles the global and the network highlight and ignore rules, our own
+ * nick is always highlighted. Has to be called when the nick changes.
+ */
+static void rules_compile(struct network *net)
+{
+	const char *nick = net->conf.nick ? net->conf.nick : "";
+
+	if (rules_add(&net->highlight, gpirc_conf_highlight, 0) ||
+	    rules_add(&net->highlight, net->conf.highlight, 0) ||
+	    gpirc_match_add(&net->highlight, nick, strlen(nick)) ||
+	    gpirc_match_compile(&net->highlight))
+		net_log_printf(net, "Failed to compile highlight rules");
+
+	if (rules_add(&net->ignore, gpirc_conf_ignore, 1) ||
+	    rules_add(&net->ignore, net->conf.ignore, 1) ||
+	    gpirc_match_compile(&net->ignore))
+		net_log_printf(net, "Failed to compile ignore rules");
+}
+
+static int rules_ignored(struct network *net, const struct gpirc_proto_msg *msg)
+{
+	const char *mask = msg->mask.str;
+	char buf[512];
+
+	if (!net->ignore.delta || !msg->nick.len)
+		return 0;
+
+	snprintf(buf, sizeof(buf), "\x01%s%s%s", msg->nick.str, mask, strchr(mask, '!') ? "" : "!");
+
+	return gpirc_match_any(&net->ignore, buf);
+}
+
+/*
+ * Letters, digits and the specials that may appear in a nick.
+ */
+static int nick_char(char c)
+{
+	if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+		return 1;
+
+	return c && strchr("[]\\`_^{|}-", c);
+}
+
+/*
+ * Matches the highlight rules against the message text with the formatting
+ * stripped. Only whole words count, i.e. a match must not be adjacent to a
+ * nick character, otherwise "bob" would highlight on "bobby" or "kebob".
+ */
+static int rules_highlighted(struct network *net, const char *body)
+{
+	struct gpirc_match_pos pos = {};
+	size_t len = strlen(body), spans_cnt;
+	char buf[512], *text = buf;
+	int ret = 0;
+
+	if (!net->highlight.delta)
+		return 0;
+
+	if (gpirc_fmt_plain(body, len)) {
+		text = (char *)body;
+	} else {
+		if (len > sizeof(buf)) {
+			text = malloc(len);
+			if (!text)
+				return 0;
+		}
+
+		len = gpirc_fmt_parse(body, len, text, NULL, &spans_cnt);
+	}
+
+	while (gpirc_match_next(&net->highlight, text, len, &pos)) {
+		size_t start = pos.end - pos.len;
+
+		if (start && nick_char(text[start - 1]))
+			continue;
+
+		if (pos.end < len && nick_char(text[pos.end]))
+			continue;
+
+		ret = 1;
+		break;
+	}
+
+	if (text != buf && text != body)
+		free(text);
+
+	return ret;
+}
+
+static int is_chan_name(const char *name)
+{
+	return name[0] && strchr("#&+!", name[0]);
+}
+
+/*
+ * Returns user@host of the message sender, empty for servers.
+ */
+static const char *msg_userhost(const struct gpirc_proto_msg *msg)
+{
+	const char *mask = msg->mask.str;
+
+	return mask[0] == '!' ? mask + 1 : mask;
+}
+
+static struct network *net_new(const struct gpirc_conf *conf)
+{
+	struct network *net = calloc(1, sizeof(struct network));
+
+	if (!net)
+		return NULL;
+
+	net->channels_map = gp_htable_new(0, 0);
+	if (!net->channels_map)
+		goto err0;
+
+	net->session = gpirc_net_session_new(net);
+	if (!net->session)
+		goto err1;
+
+	net->conf = *conf;
+	gpirc_users_init(&net->users);
+	gpirc_isupport_init(&net->isupport);
+	split_init(net);
+
+	net->autojoin.timer = (gp_timer) {
+		.callback = autojoin_timeout,
+		.id = "Autojoin",
+		.priv = net,
+	};
+
+	net->reconnect.timer = (gp_timer) {
+		.callback = reconnect_timeout,
+		.id = "Reconnect",
+		.priv = net,
+	};
+
+	net->lag.timer = (gp_timer) {
+		.callback = lag_timeout,
+		.id = "Lag",
+		.priv = net,
+	};
+
+	GP_VEC_APPEND(networks, net);
+
+	rules_compile(net);
+
+	return net;
+err1:
+	gp_htable_free(net->channels_map);
+err0:
+	free(net);
+	return NULL;
+}
+
+static void event_quit(void *priv, struct gpirc_proto_msg *msg)
+{
+	struct network *net = priv;
+	const char *nick = msg->nick.str;
+	const char *reason = msg->param_cnt ? msg->params[0].str : "";
+	struct gpirc_member *member;
+	struct gpirc_user *user;
+	int split;
+
+	user = gpirc_users_get(&net->users, nick);
+	if (!user)
+		return;
+
+	split = is_netsplit(reason);
+	if (split) {
+		split_servers_set(net, reason);
+		split_user_hold(net, user);
+		split_schedule(net);
+	}
+
+	/* Keep the user alive while we walk its memberships */
+	gpirc_user_ref(user);
+
+	while ((member = user->members)) {
+		struct channel *chan = member->nicks->priv;
+
+		if (split)
+			split_chan_add(chan, nick, 0);
+		else
+			channels_printf(net, chan->name, "-!- %s [%s] has quit [%s]",
+			                nick, msg_userhost(msg), reason);
+
+		gpirc_nicks_del(member->nicks, member);
+	}
+
+	gpirc_users_unref(&net->users, user);
+}
+
+/*
+ * IRCv3 capability negotiation.
+ *
+ * The network thread sends CAP LS before NICK and USER and the server holds
+ * the registration, and with it the MOTD that starts the autojoin, until CAP
+ * END. We ask for the capabilities we know and the server offers and end the
+ * negotiation once it ACKs or NAKs them.
+ */
+static const char *const cap_names[CAP_CNT] = {
+	[CAP_AWAY_NOTIFY] = "away-notify",
+	[CAP_BATCH] = "batch",
+	[CAP_CHATHISTORY] = "draft/chathistory",
+	[CAP_ECHO_MESSAGE] = "echo-message",
+	[CAP_MULTI_PREFIX] = "multi-prefix",
+	[CAP_SERVER_TIME] = "server-time",
+};
+
+/*
+ * Parses a space separated capability list, values after '=' are ignored.
+ *
+ * @add Set to the known capabilities in the list.
+ * @del Set to the known capabilities prefixed with '-'.
+ */
+static void caps_parse(const char *list, uint32_t *add, uint32_t *del)
+{
+	*add = 0;
+	*del = 0;
+
+	while (*list) {
+		size_t len = strcspn(list, " ");
+		size_t name_len = strcspn(list, " =");
+		const char *name = list;
+		uint32_t *mask = add;
+		unsigned int i;
+
+		if (*name == '-') {
+			mask = del;
+			name++;
+			name_len--;
+		}
+
+		for (i = 0; i < CAP_CNT; i++) {
+			if (strlen(cap_names[i]) == name_len &&
+			    !memcmp(cap_names[i], name, name_len))
+				*mask |= 1u<<i;
+		}
+
+		list += len;
+		while (*list == ' ')
+			list++;
+	}
+}
+
+static void caps_req(struct network *net, uint32_t caps)
+{
+	char buf[256];
+	size_t off = 0;
+	unsigned int i;
+
+	for (i = 0; i < CAP_CNT; i++) {
+		if (caps & (1u<<i))
+			off += snprintf(buf + off, sizeof(buf) - off, "%s%s", off ? " " : "", cap_names[i]);
+	}
+
+	gpirc_net_send_prio(net->session, GPIRC_NET_URGENT, "CAP REQ :%s", buf);
+}
+
+static void caps_print(struct network *net)
+{
+	char buf[256];
+	size_t off = 0;
+	unsigned int i;
+
+	for (i = 0; i < CAP_CNT; i++) {
+		if (CAP_ENABLED(net, i))
+			off += snprintf(buf + off, sizeof(buf) - off, " %s", cap_names[i]);
+	}
+
+	net_log_printf(net, "-!- Capabilities:%s", off ? buf : " none");
+}
+
+/*
+ * CAP END is ignored once registered, i.e. after a CAP NEW.
+ */
+static void caps_end(struct network *net)
+{
+	gpirc_net_send_prio(net->session, GPIRC_NET_URGENT, "CAP END");
+}
+
+static void event_cap(void *priv, struct gpirc_proto_msg *msg)
+{
+	struct network *net = priv;
+	const char *sub;
+	uint32_t add, del;
+	int more;
+
+	if (msg->param_cnt < 3)
+		return;
+
+	sub = msg->params[1].str;
+	/* Multiline replies have a '*' before the list on all but the last line */
+	more = msg->param_cnt >= 4 && !strcmp(msg->params[2].str, "*");
+
+	caps_parse(msg->params[msg->param_cnt - 1].str, &add, &del);
+
+	if (!strcmp(sub, "LS")) {
+		net->caps.offered |= add;
+
+		if (more)
+			return;
+
+		if (net->caps.offered)
+			caps_req(net, net->caps.offered);
+		else
+			caps_end(net);
+
+		net->caps.offered = 0;
+		return;
+	}
+
+	if (!strcmp(sub, "ACK")) {
+		net->caps.enabled = (net->caps.enabled | add) & ~del;
+
+		if (more)
+			return;
+
+		caps_print(net);
+		caps_end(net);
+		return;
+	}
+
+	if (!strcmp(sub, "NAK")) {
+		net_log_printf(net, "-!- Capabilities refused: %s", msg->params[msg->param_cnt - 1].str);
+		caps_end(net);
+		return;
+	}
+
+	if (!strcmp(sub, "NEW")) {
+		add &= ~net->caps.enabled;
+
+		if (add)
+			caps_req(net, add);
+		return;
+	}
+
+	if (!strcmp(sub, "DEL")) {
+		net->caps.enabled &= ~add;
+		caps_print(net);
+	}
+}
+
+/*
+ * IRCv3 away-notify, AWAY with a message marks the user as away, AWAY without
+ * one as back.
+ */
+static void event_away(void *priv, struct gpirc_proto_msg *msg)
+{
+	struct network *net = priv;
+	struct gpirc_user *user;
+
+	user = gpirc_users_get(&net->users, msg->nick.str);
+	if (user)
+		user->away = msg->param_cnt && msg->params[0].str[0];
+}
+
+/*
+ * Called on RPL_WELCOME, i.e. once the registration is done.
+ */
+static void net_connected(struct network *net)
+{
+	gpirc_isupport_init(&net->isupport);
+
+	net->reconnect.connected_ns = gpirc_monotonic_ns();
+	lag_start(net);
+
+	if (net->conf.chans && gp_vec_len(net->conf.chans)) {
+		uint64_t start = gpirc_monotonic_ns();
+		size_t added = 0;
+
+		GP_VEC_FOREACH(net->conf.chans, struct gpirc_chan, chan) {
+			if (gp_htable_get(net->channels_map, chan->chan))
+				continue;
+
+			channels_add(net, chan->chan, chan->pass);
+			added++;
+		}
+
+		if (added) {
+			net_log_printf(net, "Added %zu channels in %.2fms, RSS %zuKB, joining after MOTD",
+			               added, (gpirc_monotonic_ns() - start) / 1000000.0, rss_kb());
+		}
+	}
+
+	autojoin_start(net);
+}
+
+static void event_join(void *priv, struct gpirc_proto_msg *msg)
+{
+	struct network *net = priv;
+	const char *nick = msg->nick.str;
+
+	if (msg->param_cnt < 1)
+		return;
+
+	struct channel *chan = gp_htable_get(net->channels_map, msg->params[0].str);
+
+	if (strcmp(nick, net->conf.nick))
+		chan_add_nick(net, msg->params[0].str, nick, msg->mask.str);
+	else if (chan)
+		chan_names_start(chan);
+
+	if (chan && split_join(chan, nick))
+		return;
+
+	chan_msg(net, msg->params[0].str, GPIRC_MSG_JOIN, nick, msg_userhost(msg));
+}
+
+static void event_part(void *priv, struct gpirc_proto_msg *msg)
+{
+	struct network *net = priv;
+	const char *nick = msg->nick.str;
+
+	if (msg->param_cnt < 1)
+		return;
+
+	chan_msg(net, msg->params[0].str, GPIRC_MSG_PART, nick, msg_userhost(msg));
+
+	chan_rem_nick(net, msg->params[0].str, nick);
+}
+
+static void event_nick(void *priv, struct gpirc_proto_msg *msg)
+{
+	struct network *net = priv;
+	const char *nick = msg->nick.str;
+
+	if (msg->param_cnt < 1)
+		return;
+
+	struct gpirc_user *user = gpirc_users_get(&net->users, nick);
+	struct gpirc_member *member;
+
+	if (!user)
+		return;
+
+	if (gpirc_nicks_rename(&net->users, user, msg->params[0].str)) {
+		status_log_append("Allocation failure");
+		return;
+	}
+
+	for (member = user->members; member; member = member->user_next) {
+		struct channel *chan = member->nicks->priv;
+
+		channels_printf(net, chan->name, "-!- %s is now known as %s", nick, msg->params[0].str);
+	}
+}
+
+static void chan_mode_nick(struct network *net, const char *chan_name,
+                           const char *nick, char mode, int set)
+{
+	struct channel *chan = gp_htable_get(net->channels_map, chan_name);
+	uint8_t flag;
+
+	if (!chan)
+		return;
+
+	switch (mode) {
+	case 'q':
+		flag = GPIRC_NICK_OWNER;
+	break;
+	case 'a':
+		flag = GPIRC_NICK_ADMIN;
+	break;
+	case 'o':
+		flag = GPIRC_NICK_OP;
+	break;
+	case 'h':
+		flag = GPIRC_NICK_HALFOP;
+	break;
+	case 'v':
+		flag = GPIRC_NICK_VOICE;
+	break;
+	default:
+		return;
+	}
+
+	gpirc_nicks_mode(&chan->nicks, nick, flag, set);
+}
+
+static void event_mode(void *priv, struct gpirc_proto_msg *msg)
+{
+	struct network *net = priv;
+	const char *nick = msg->nick.str;
+	const char *chan_name, *modes;
+	unsigned int arg = 2;
+	int set = 1;
+
+	if (msg->param_cnt < 2)
+		return;
+
+	chan_name = msg->params[0].str;
+
+	/* User modes are not shown */
+	if (!is_chan_name(chan_name))
+		return;
+
+	for (modes = msg->params[1].str; *modes; modes++) {
+		switch (*modes) {
+		case '+':
+			set = 1;
+		break;
+		case '-':
+			set = 0;
+		break;
+		case 'q':
+		case 'a':
+		case 'o':
+		case 'h':
+		case 'v':
+			if (arg < msg->param_cnt)
+				chan_mode_nick(net, chan_name, msg->params[arg++].str, *modes, set);
+		break;
+		case 'b':
+		case 'e':
+		case 'I':
+		case 'k':
+			arg++;
+		break;
+		case 'l':
+			if (set)
+				arg++;
+		break;
+		}
+	}
+
+	if (msg->param_cnt == 2) {
+		channels_printf(net, chan_name, "-!- mode/%s [%s] by %s",
+		                chan_name, msg->params[1].str, nick);
+	} else {
+		channels_printf(net, chan_name, "-!- mode/%s [%s %s] by %s",
+		                chan_name, msg->params[1].str, msg->params[2].str, nick);
+	}
+}
+
+/*
+ * PRIVMSG, only channel messages are shown, CTCP requests including ACTION
+ * are dropped.
+ */
+static void event_privmsg(void *priv, struct gpirc_proto_msg *msg)
+{
+	struct network *net = priv;
+	const char *nick = msg->nick.str;
+	const char *chan_name, *text;
+	struct batch *batch;
+
+	if (msg->param_cnt != 2)
+		return;
+
+	chan_name = msg->params[0].str;
+	text = msg->params[1].str;
+
+	if (!is_chan_name(chan_name) || text[0] == '\001')
+		return;
+
+	if (rules_ignored(net, msg)) {
+		redraw_stats.ignored++;
+		return;
+	}
+
+	batch = msg_batch(net);
+	if (batch && batch->type == BATCH_CHATHISTORY) {
+		struct channel *chan = chan_by_name(net, chan_name);
+
+		if (!chan || chan_history_dup(chan, msg_time(), nick, text))
+			return;
+
+		batch->msgs++;
+	}
+
+	chan_msg(net, chan_name, GPIRC_MSG_PRIVMSG, nick, text);
+
+	/* Our own messages come back with echo-message */
+	if (!gpirc_nick_cmp(nick, net->conf.nick))
+		return;
+
+	if (rules_highlighted(net, text))
+		chan_highlight(net, chan_name, nick, text);
+}
+
+static void chan_set_topic(struct network *net, const char *chan_name, const char *topic)
+{
+	struct channel *channel = gp_htable_get(net->channels_map, chan_name);
+	if (!channel)
+		return;
+
+	free(channel->topic);
+	channel->topic = strdup(topic);
+
+	if (channels_active_chan() == channel)
+		set_topic_label(channel->topic);
+}
+
+static void event_topic(void *priv, struct gpirc_proto_msg *msg)
+{
+	struct network *net = priv;
+	const char *chan_name, *topic;
+
+	if (msg->param_cnt != 2)
+		return;
+
+	chan_name = msg->params[0].str;
+	topic = msg->params[1].str;
+
+	chan_set_topic(net, chan_name, topic);
+
+	channels_printf(net, chan_name, "-!- %s changed topic to '%s'", msg->nick.str, topic);
+}
+
+static enum gp_poll_event_ret net_fd_event(gp_fd *self)
+{
+	(void) self;
+
+	gpirc_net_process();
+
+	return GP_POLL_RET_OK;
+}
+
+static gp_fd net_fd = {
+	.event = net_fd_event,
+	.events = GP_POLLIN,
+};
+
+static void net_disconnected(void *priv, const char *reason)
+{
+	struct network *net = priv;
+	size_t i;
+
+	autojoin_stop(net);
+	lag_stop(net);
+	net_log_printf(net, "Connection failed: %s", reason);
+
+	/* Negotiated again on the next connection */
+	net->caps = (struct caps) {};
+	net->batches_cnt = 0;
+	net->netsplit.batches = 0;
+
+	/* The member lists are diffed against NAMES once rejoined */
+	for (i = 0; i < gp_vec_len(tab_chans); i++) {
+		struct channel *chan = tab_chans[i];
+
+		if (!chan || chan->net != net)
+			continue;
+
+		chan->rejoin = 1;
+		chan->names_pending = 0;
+	}
+
+	reconnect_schedule(net);
+}
+
+static void do_connect(struct network *net)
+{
+	struct gpirc_conf *conf = &net->conf;
+
+	if (!conf->server)
+		return;
+
+	reconnect_stop(net);
+	lag_stop(net);
+
+	net_log_printf(net, "Connecting as %s to %s port %i",
+	               conf->nick, conf->server, conf->port);
+
+	gpirc_net_flood_set(net->session, conf->flood_burst, conf->flood_interval_ms);
+
+	if (gpirc_net_connect(net->session, conf->server, conf->port, conf->nick))
+		net_log_printf(net, "Connection failed: Send queue full");
+}
+
+static int str_append(char **str, const char *suf)
+{
+	size_t str_len = strlen(*str);
+	size_t suf_len = strlen(suf);
+	char *ret = malloc(str_len + suf_len + 1);
+
+	if (!ret)
+		return 1;
+
+	strcpy(ret, *str);
+	strcpy(ret + str_len, suf);
+	ret[str_len + suf_len] = 0;
+
+	free(*str);
+	*str = ret;
+
+	return 0;
+}
+
+static void retry_with_new_nick(struct network *net)
+{
+	if (str_append(&net->conf.nick, "_"))
+		return;
+
+	rules_compile(net);
+
+	gpirc_net_send_prio(net->session, GPIRC_NET_URGENT, "NICK %s", net->conf.nick);
+}
+
+static void print_topic_who_time(struct network *net, const char *chan,
+                                 const char *who, const char *time)
+{
+	time_t timestamp = atoi(time);
+	struct tm *tm_time = localtime(&timestamp);
+	int nick_len = strcspn(who, "!");
+	char str_time[80];
+
+	if (!strftime(str_time, sizeof(str_time), "%a %b %d %H:%M:%S %Y", tm_time))
+		str_time[0] = 0;
+
+	channels_printf(net, chan, "-!- Topic set by %.*s [%s] [%s]", nick_len, who, who, str_time);
+}
+
+/*
+ * The ISUPPORT parser and the status log take the parameters as an array of
+ * strings, the spans are null terminated so the array just points into the
+ * line.
+ */
+static void event_numeric(void *priv, struct gpirc_proto_msg *msg)
+{
+	struct network *net = priv;
+	const char *params[GPIRC_PROTO_PARAMS];
+	unsigned int i, count = msg->param_cnt;
+	unsigned int numeric = msg->numeric;
+
+	for (i = 0; i < count; i++)
+		params[i] = msg->params[i].str;
+
+	if (numeric == GPIRC_PROTO_RPL_WELCOME)
+		net_connected(net);
+
+	if (numeric == GPIRC_PROTO_RPL_ENDOFMOTD || numeric == GPIRC_PROTO_ERR_NOMOTD)
+		autojoin_motd_end(net);
+
+	switch (numeric) {
+	case GPIRC_PROTO_ERR_NOMOTD:
+	case GPIRC_PROTO_RPL_MOTD:
+	case GPIRC_PROTO_RPL_WELCOME:
+	case GPIRC_PROTO_RPL_YOURHOST:
+	case GPIRC_PROTO_RPL_CREATED:
+	case GPIRC_PROTO_RPL_ENDOFMOTD:
+	case GPIRC_PROTO_RPL_MOTDSTART:
+	case GPIRC_PROTO_RPL_LUSERCLIENT:
+	case GPIRC_PROTO_RPL_LUSERME:
+	case GPIRC_PROTO_RPL_LUSEROP:
+	case GPIRC_PROTO_RPL_LUSERUNKNOWN:
+	case GPIRC_PROTO_RPL_LUSERCHANNELS:
+	/* Highest connection count */
+	case 250:
+	/* Current local users */
+	case 265:
+	/* Current global users */
+	case 266:
+	/* Displayed host */
+	case 396:
+		if (count == 2)
+			net_log_printf(net, "%s", params[1]);
+
+		if (count >= 3)
+			net_log_printf(net, "%s %s", params[1], params[2]);
+
+	break;
+	/* RPL_ISUPPORT */
+	case GPIRC_PROTO_RPL_BOUNCE:
+		gpirc_isupport_parse(&net->isupport, params, count);
+		net_log_appends(net, params + 1, count - 1);
+	break;
+	case GPIRC_PROTO_RPL_MYINFO:
+		net_log_appends(net, params + 1, count - 1);
+	break;
+	case GPIRC_PROTO_RPL_ENDOFNAMES:
+		chan_names_end(net, params[1]);
+	break;
+	case GPIRC_PROTO_RPL_NAMREPLY:
+		chan_add_nicks(net, params[2], params[3]);
+	break;
+	case GPIRC_PROTO_RPL_NOTOPIC:
+		printf("NOTOPIC %s", params[0]);
+	break;
+	case GPIRC_PROTO_RPL_TOPIC:
+		if (count < 3)
+			return;
+		chan_set_topic(net, params[1], params[2]);
+		channels_printf(net, params[1], "-!- Topic for %s: %s", params[1], params[2]);
+	break;
+	/* RPL_TOPICWHOTIME */
+	case 333:
+		if (count < 4)
+			return;
+		print_topic_who_time(net, params[1], params[2], params[3]);
+	break;
+	case GPIRC_PROTO_ERR_CHANOPRIVSNEEDED:
+		channels_printf(net, params[1], "%s %s", params[1], params[2]);
+	break;
+	case GPIRC_PROTO_ERR_NICKNAMEINUSE:
+		if (count >= 2)
+			net_log_printf(net, "Your nick %s is already in use", params[1]);
+		retry_with_new_nick(net);
+	break;
+	default:
+		net_log_printf(net, "Unhandled event %u\n", numeric);
+		printf("Unhandled event %u\n", numeric);
+		gpirc_stats_unhandled(numeric);
+	break;
+	}
+}
+
+/*
+ * Channel commands apply to the channel network, status log commands to the
+ * network of the last active channel.
+ */
+static struct network *widget_net(gp_widget *self)
+{
+	struct channel *channel = self->priv;
+
+	if (channels_is_status_log(self))
+		return cur_net;
+
+	return channel->net;
+}
+
+static struct network *net_by_server(const char *server)
+{
+	GP_VEC_FOREACH(networks, struct network *, net) {
+		if ((*net)->conf.server && !strcmp((*net)->conf.server, server))
+			return *net;
+	}
+
+	return NULL;
+}
+
+/*
+ * Reconnects a known server, otherwise reuses the current network unless it's
+ * connected and adds a new one.
+ */
+static void cmd_connect(gp_widget *self, const char *pars)
+{
+	struct network *net;
+
+	if (!pars[0]) {
+		gp_widget_log_append(self, "/connect requires parameter(s)");
+		return;
+	}
+
+	net = net_by_server(pars);
+	if (net)
+		goto connect;
+
+	net = widget_net(self);
+
+	if (net->conf.server && gpirc_net_connected(net->session)) {
+		struct gpirc_conf conf;
+
+		if (gpirc_conf_init(&conf, net->conf.nick)) {
+			gp_widget_log_append(self, "Allocation failure");
+			return;
+		}
+
+		net = net_new(&conf);
+		if (!net) {
+			gp_widget_log_append(self, "/connect failed to add network");
+			return;
+		}
+	}
+
+	if (gpirc_conf_conn_set(&net->conf, pars, 0))
+		gp_widget_log_append(self, "/connect failed to set serever");
+connect:
+	cur_net = net;
+	net->reconnect.attempts = 0;
+	do_connect(net);
+}
+
+static void cmd_quit(gp_widget *self, const char *pars)
+{
+	if (pars[0]) {
+		gp_widget_log_append(self, "/quit command invalid parameters");
+		return;
+	}
+
+	gp_widgets_exit(0);
+}
+
+static void cmd_wc(gp_widget *self, const char *pars)
+{
+	if (pars[0]) {
+		gp_widget_log_append(self, "/wc command invalid parameters");
+		return;
+	}
+
+	if (channels_is_status_log(self)) {
+		gp_widget_log_append(self, "/wc cannot close the status log");
+		return;
+	}
+
+	channels_rem(self->priv);
+}
+
+static void cmd_join(gp_widget *self, const char *pars)
+{
+	const char *pass, *chan = pars;
+	char tmp[128];
+
+	if (!pars[0]) {
+		gp_widget_log_append(self, "/join requires parameter");
+		return;
+	}
+
+	struct network *net = widget_net(self);
+
+	pass = strchr(pars, ' ');
+	if (pass) {
+		size_t len = pass - pars;
+
+		if (len > sizeof(tmp) - 1) {
+			gp_widget_log_append(self, "/join channel name too long");
+			return;
+		}
+
+		strncpy(tmp, pars, len);
+		tmp[len] = 0;
+		chan = tmp;
+	}
+
+	channels_join(net, chan, pass);
+}
+
+static void cmd_nick(gp_widget *self, const char *pars)
+{
+	if (!pars[0]) {
+		gp_widget_log_append(self, "/nick requires a parameter");
+		return;
+	}
+
+	struct network *net = widget_net(self);
+
+	if (gpirc_conf_nick_set(&net->conf, pars))
+		gp_widget_log_append(self, "/nick failed to set nick");
+	else
+		rules_compile(net);
+
+	if (gpirc_net_connected(net->session) &&
+	    gpirc_net_send(net->session, "NICK %s", net->conf.nick))
+		gp_widget_log_append(self, "/nick send queue full");
+}
+
+static void cmd_topic(gp_widget *self, const char *pars)
+{
+	struct channel *channel = self->priv;
+
+	if (!pars[0]) {
+		gp_widget_log_append(self, "/topic requires parameter");
+		return;
+	}
+
+	if (gpirc_net_send(channel->net->session, "TOPIC %s :%s", channel->name, pars))
+		gp_widget_log_append(self, "/topic send queue full");
+}
+
+static void cmd_history(gp_widget *self, const char *pars)
+{
+	if (pars[0]) {
+		gp_widget_log_append(self, "/history command invalid parameters");
+		return;
+	}
+
+	if (channels_is_status_log(self)) {
+		gp_widget_log_append(self, "/history works only in a channel");
+		return;
+	}
+
+	hist_open(self->priv);
+}
+
+static void search_open(void)
+{
+	if (!search_log) {
+		search_log = gp_widget_log_new(GP_TATTR_MONO, 80, 25, GPIRC_SEARCH_HITS + 2);
+		if (!search_log) {
+			status_log_append("Allocation failure");
+			return;
+		}
+
+		search_log->align = GP_FILL;
+
+		if (tabs_append("search", search_log, NULL)) {
+			gp_widget_free(search_log);
+			search_log = NULL;
+			status_log_append("Allocation failure");
+			return;
+		}
+	}
+
+	gp_widget_tabs_active_set(channel_tabs,
+		gp_widget_tabs_tab_by_child(channel_tabs, search_log));
+}
+
+static void cmd_search(gp_widget *self, const char *pars)
 {
-	struct channel *channel = channel_log->priv;
+	struct gpirc_search_res *res;
+	uint64_t start, end;
+	char buf[1024];
+	size_t i;
 
-	irc_cmd_part(irc_session, channel->name);
+	res = malloc(sizeof(*res));
+	if (!res) {
+		gp_widget_log_append(self, "Allocation failure");
+		return;
+	}
 
-	gp_widget_tabs_tab_del_by_child(channel_tabs, channel_log);
+	start = gpirc_monotonic_ns();
 
-	gp_htable_rem(channels_map, channel->name);
+	if (gpirc_search(pars, res)) {
+		gp_widget_log_append(self, "/search requires words to search for");
+		goto exit;
+	}
 
-	free(channel->name);
-	free(channel);
-}
+	end = gpirc_monotonic_ns();
 
-static struct channel *chan_by_name(const char *chan_name)
-{
-	struct channel *channel = gp_htable_get(channels_map, chan_name);
+	search_open();
+	if (!search_log)
+		goto exit;
 
-	if (!channel)
-		status_log_printf("Channel '%s' does not exist!", chan_name);
+	gp_widget_log_flush(search_log);
 
-	return channel;
-}
+	/* Newest first in the list, appended oldest first so it ends at the bottom */
+	for (i = res->cnt; i > 0; i--) {
+		gpirc_search_hit_fmt(&res->hits[i - 1], buf, sizeof(buf));
+		gp_widget_log_append(search_log, buf);
+	}
 
-static void channels_append(const char *chan_name, const char *msg)
-{
-	struct channel *chan = chan_by_name(chan_name);
+	snprintf(buf, sizeof(buf), "-!- '%s': %zu matches in %.2fms, showing %zu newest%s",
+	         pars, res->matches, (end - start) / 1000000.0, res->cnt,
+	         res->partial ? ", history is still being indexed" : "");
 
-	if (chan)
-		gp_widget_log_append(chan->channel_log, msg);
+	gp_widget_log_append(search_log, buf);
+exit:
+	free(res);
 }
 
-static void channels_printf(const char *chan_name, const char *fmt, ...)
+static void cmd_search_wc(gp_widget *self, const char *pars)
 {
-	char buf[1024];
-	va_list args;
+	if (pars[0]) {
+		gp_widget_log_append(self, "/wc command invalid parameters");
+		return;
+	}
 
-	va_start(args, fmt);
-	vsnprintf(buf, sizeof(buf), fmt, args);
-	va_end(args);
+	int tab = gp_widget_tabs_tab_by_child(channel_tabs, search_log);
 
-	channels_append(chan_name, buf);
+	search_log = NULL;
+	tabs_del(tab);
 }
 
-static gp_widget *channels_active(void)
+static void latency_print(gp_widget *self)
 {
-	return gp_widget_tabs_active_child_get(channel_tabs);
-}
+	if (!latency.samples) {
+		gp_widget_log_append(self, "-!- Latency: no samples");
+		return;
+	}
 
-static int channels_is_active(gp_widget *self)
-{
-	return channels_active() == self;
-}
+	char buf[256];
 
-static int channels_is_status_log(gp_widget *self)
-{
-	return self == status_log;
+	snprintf(buf, sizeof(buf),
+	         "-!- Latency socket to log: %llu samples min %lluus avg %lluus max %lluus",
+	         (unsigned long long)latency.samples,
+	         (unsigned long long)latency.min_ns / 1000,
+	         (unsigned long long)(latency.sum_ns / latency.samples) / 1000,
+	         (unsigned long long)latency.max_ns / 1000);
+
+	gp_widget_log_append(self, buf);
 }
 
-static void channels_join(const char *name, const char *pass)
+static void cmd_latency(gp_widget *self, const char *pars)
 {
-	status_log_printf("Joining channel '%s'", name);
+	if (!pars[0]) {
+		latency_print(self);
+		return;
+	}
+
+	if (!strcmp(pars, "on")) {
+		memset(&latency, 0, sizeof(latency));
+		latency.enabled = 1;
+		gp_widget_log_append(self, "-!- Latency measurement enabled");
+		return;
+	}
 
-	channels_add(name);
+	if (!strcmp(pars, "off")) {
+		latency.enabled = 0;
+		latency_print(self);
+		return;
+	}
 
-	irc_cmd_join(irc_session, name, pass);
+	gp_widget_log_append(self, "/latency invalid parameters");
 }
 
-static void chan_add_nick(const char *chan_name, const char *nick)
+static void cmd_record(gp_widget *self, const char *pars)
 {
-	struct channel *chan = chan_by_name(chan_name);
+	struct network *net = widget_net(self);
+	char buf[256];
 
-	if (!chan)
+	if (!pars[0]) {
+		gpirc_net_record(NULL, NULL, NULL);
+		gp_widget_log_append(self, "-!- Recording stopped");
 		return;
+	}
+
+	if (gpirc_net_record(net->session, pars, net->conf.nick)) {
+		snprintf(buf, sizeof(buf), "-!- Failed to open '%s': %s", pars, strerror(errno));
+		gp_widget_log_append(self, buf);
+		return;
+	}
 
-	GP_VEC_APPEND(chan->nicks, strdup(nick));
+	snprintf(buf, sizeof(buf), "-!- Recording %s into '%s'", net_name(net), pars);
+	gp_widget_log_append(self, buf);
 }
 
-static void chan_add_nicks(const char *chan_name, const char *nicks)
+struct mem_stats {
+	size_t chans;
+	size_t msgs;
+	size_t nicks;
+	size_t users;
+	size_t rules;
+};
+
+static void mem_stats(struct mem_stats *mem)
 {
-	struct channel *chan = chan_by_name(chan_name);
+	size_t i;
 
-	if (!chan)
-		return;
+	memset(mem, 0, sizeof(*mem));
 
-	for (;;) {
-		size_t nick_len = 0;
+	for (i = 0; i < gp_vec_len(tab_chans); i++) {
+		struct channel *chan = tab_chans[i];
 
-		while (nicks[nick_len] && nicks[nick_len] != ' ')
-			nick_len++;
+		if (!chan)
+			continue;
 
-		if (!nick_len)
-			return;
+		mem->chans += sizeof(*chan) + strlen(chan->name) + 1;
+		if (chan->topic)
+			mem->chans += strlen(chan->topic) + 1;
 
-		GP_VEC_APPEND(chan->nicks, strndup(nicks, nick_len));
+		mem->msgs += chan->msgs.recs_size * sizeof(struct gpirc_msg) +
+		             chan->msgs.buf_size;
 
-		while (nicks[nick_len] && nicks[nick_len] == ' ')
-			nick_len++;
+		mem->nicks += (chan->nicks.size + chan->nicks.by_nick_size) *
+		              sizeof(*chan->nicks.slots) + gpirc_slab_size(&chan->nicks.slab);
+	}
 
-		nicks += nick_len;
+	for (i = 0; i < gp_vec_len(networks); i++) {
+		struct gpirc_users *users = &networks[i]->users;
+
+		mem->users += users->size * sizeof(*users->slots) +
+		              gpirc_slab_size(&users->slab);
+
+		mem->rules += gpirc_match_size(&networks[i]->highlight) +
+		              gpirc_match_size(&networks[i]->ignore);
 	}
 }
 
-static void chan_rem_nick(const char *chan_name, const char *nick)
+struct chan_rate {
+	struct channel *chan;
+	double rate;
+};
+
+static int chan_rate_cmp(const void *a, const void *b)
 {
-	struct channel *chan = chan_by_name(chan_name);
+	const struct chan_rate *ra = a, *rb = b;
 
-	if (!chan)
-		return;
+	if (ra->rate != rb->rate)
+		return ra->rate < rb->rate ? 1 : -1;
 
-	//TODO
+	/* More messages stored first */
+	return (ra->chan->msgs.tail < rb->chan->msgs.tail) -
+	       (ra->chan->msgs.tail > rb->chan->msgs.tail);
 }
 
-static void chan_print_nicks(const char *chan_name)
+/*
+ * Returns channels sorted by message rate, the array has to be freed.
+ */
+static struct chan_rate *chans_by_rate(size_t *cnt)
 {
-	struct channel *chan = chan_by_name(chan_name);
-
-	if (!chan)
-		return;
-
-	channels_printf(chan_name, "-!- [Users %s]", chan_name);
+	struct chan_rate *rates;
+	time_t now = time(NULL);
+	size_t i;
 
-	char *nicks = gp_vec_str_new();
+	*cnt = 0;
 
-	if (!nicks)
-		return;
+	rates = malloc(sizeof(*rates) * (gp_vec_len(tab_chans) + 1));
+	if (!rates)
+		return NULL;
 
-	int first = 1;
+	for (i = 0; i < gp_vec_len(tab_chans); i++) {
+		if (!tab_chans[i])
+			continue;
 
-	GP_VEC_FOREACH(chan->nicks, char *, nick) {
-		char *append = "[ ";
-		if (!first)
-			GP_VEC_STR_APPEND(nicks, " ");
-		first = 0;
-		if (*nick[0] == '@')
-			append = "[";
-		GP_VEC_STR_APPEND(nicks, append);
-		GP_VEC_STR_APPEND(nicks, *nick);
-		GP_VEC_STR_APPEND(nicks, "]");
+		rates[*cnt].chan = tab_chans[i];
+		rates[*cnt].rate = chan_rate(tab_chans[i], now);
+		(*cnt)++;
 	}
 
-	channels_printf(chan_name, "-!- %s", nicks);
+	qsort(rates, *cnt, sizeof(*rates), chan_rate_cmp);
 
-	gp_vec_free(nicks);
+	return rates;
 }
 
-static void set_topic_label(const char *topic_str)
-{
-	if (!topic)
-		return;
-
-	if (topic_str)
-		gp_widget_label_set(topic, topic_str);
-	else
-		gp_widget_label_set(topic, "(none)");
-}
+/* Number of events and channels printed by /stats */
+#define STATS_TOP 10
 
-static int channels_on_event(gp_widget_event *ev)
+static void stats_summary(gp_widget *self)
 {
-	if (ev->type != GP_WIDGET_EVENT_WIDGET)
-		return 0;
+	struct gpirc_search_stats search_stats;
+	struct gpirc_log_stats log_stats;
+	struct gpirc_net_stats net_stats;
+	struct mem_stats mem;
+	char buf[256];
+	size_t i;
 
-	if (ev->sub_type != GP_WIDGET_TABS_ACTIVATED)
-		return 0;
+	snprintf(buf, sizeof(buf),
+	         "-!- Messages received %llu, log redraws %llu p50 %.1fus p99 %.1fus max %.1fus",
+	         (unsigned long long)redraw_stats.msgs,
+	         (unsigned long long)redraw_stats.redraws,
+	         gpirc_stats_hist_pct(&redraw_stats.render, 50) / 1000.0,
+	         gpirc_stats_hist_pct(&redraw_stats.render, 99) / 1000.0,
+	         redraw_stats.render.max / 1000.0);
 
-	gp_widget *active_child = channels_active();
+	gp_widget_log_append(self, buf);
 
-	if (channels_is_status_log(active_child)) {
-		set_topic_label("gpirc 1.0");
-		return 1;
-	}
+	snprintf(buf, sizeof(buf), "-!- Highlights %llu, ignored messages %llu",
+	         (unsigned long long)redraw_stats.highlights,
+	         (unsigned long long)redraw_stats.ignored);
 
-	struct channel *channel = active_child->priv;
+	gp_widget_log_append(self, buf);
 
-	set_topic_label(channel->topic);
+	snprintf(buf, sizeof(buf),
+	         "-!- Startup %.2fms, RSS %zuKB, %zu tabs, %u channel log widgets",
+	         startup_ns / 1000000.0, rss_kb(), gp_vec_len(tab_chans), chan_widgets);
 
-	return 1;
-}
+	gp_widget_log_append(self, buf);
 
-static void event_connect(irc_session_t *session, const char *event,
-                          const char *origin, const char **params,
-                          unsigned int count)
-{
-	struct gpirc_conf *conf = irc_get_ctx(session);
+	gpirc_net_stats(&net_stats);
 
-	(void) event;
-	(void) origin;
-	(void) params;
-	(void) count;
+	snprintf(buf, sizeof(buf),
+	         "-!- Received %llu lines ~%lluKB, sent %llu lines %lluKB",
+	         (unsigned long long)net_stats.lines_in,
+	         (unsigned long long)net_stats.bytes_in / 1024,
+	         (unsigned long long)net_stats.lines_out,
+	         (unsigned long long)net_stats.bytes_out / 1024);
 
-	if (!conf->chans)
-		return;
+	gp_widget_log_append(self, buf);
 
-	GP_VEC_FOREACH(gpirc_conf.chans, struct gpirc_chan, chan)
-		channels_join(chan->chan, chan->pass);
-}
+	for (i = 0; i < gp_vec_len(networks); i++) {
+		struct lag *lag = &networks[i]->lag;
 
-static void event_join(irc_session_t *session, const char *event,
-                       const char *origin, const char **params,
-                       unsigned int count)
-{
-	char nick[128];
+		if (!lag->hist.cnt)
+			continue;
 
-	(void) session;
-	(void) event;
+		snprintf(buf, sizeof(buf),
+		         "-!- Lag %s %.1fms avg %.1fms, p50 %.1fms p99 %.1fms max %.1fms, %llu samples",
+		         net_name(networks[i]), lag->cur_ns / 1e6, lag->avg_ns / 1e6,
+		         gpirc_stats_hist_pct(&lag->hist, 50) / 1e6,
+		         gpirc_stats_hist_pct(&lag->hist, 99) / 1e6,
+		         lag->hist.max / 1e6, (unsigned long long)lag->hist.cnt);
 
-	if (count < 1)
-		return;
+		gp_widget_log_append(self, buf);
+	}
 
-	irc_target_get_nick(origin, nick, sizeof(nick));
+	gpirc_logs_stats(&log_stats);
 
-	channels_printf(params[0], "-!- %s [%s] has joined %s", nick, origin, params[0]);
+	snprintf(buf, sizeof(buf),
+	         "-!- Disk log %llu bytes in %llu writes, %llu dropped, %llu errors",
+	         (unsigned long long)log_stats.bytes,
+	         (unsigned long long)log_stats.writes,
+	         (unsigned long long)log_stats.dropped,
+	         (unsigned long long)log_stats.errors);
 
-	if (strcmp(nick, gpirc_conf.nick))
-		chan_add_nick(params[0], nick);
-}
+	gp_widget_log_append(self, buf);
 
-static void event_part(irc_session_t *session, const char *event,
-                       const char *origin, const char **params,
-                       unsigned int count)
-{
-	char nick[128];
+	gpirc_search_stats(&search_stats);
 
-	(void) session;
-	(void) event;
+	snprintf(buf, sizeof(buf),
+	         "-!- Search index %zu messages, %zu words, %zu postings, %zuKB%s",
+	         search_stats.docs, search_stats.tokens, search_stats.postings,
+	         search_stats.bytes / 1024,
+	         search_stats.hist_ready ? "" : ", indexing history");
 
-	if (count < 1)
-		return;
+	gp_widget_log_append(self, buf);
 
-	irc_target_get_nick(origin, nick, sizeof(nick));
+	mem_stats(&mem);
 
-	channels_printf(params[0], "%s [%s] has quit [Connection closed]", nick, origin);
+	snprintf(buf, sizeof(buf),
+	         "-!- Memory channels %zuKB, messages %zuKB, nicks %zuKB, users %zuKB, logs %zuKB, rules %zuKB",
+	         mem.chans / 1024, mem.msgs / 1024, mem.nicks / 1024,
+	         mem.users / 1024, log_stats.mem / 1024, mem.rules / 1024);
 
-	chan_rem_nick(params[0], nick);
+	gp_widget_log_append(self, buf);
 }
 
-static void event_nick(irc_session_t *session, const char *event,
-                       const char *origin, const char **params,
-                       unsigned int count)
+static void stats_events(gp_widget *self)
 {
-	char nick[128];
-
-	(void) session;
-	(void) event;
+	const struct gpirc_stats_ev *evs[STATS_TOP];
+	size_t i, cnt = gpirc_stats_evs(evs, STATS_TOP);
+	char buf[256];
 
-	if (count < 1)
+	if (!cnt) {
+		gp_widget_log_append(self, "-!- No events handled yet");
 		return;
+	}
+
+	gp_widget_log_append(self, "-!- Event           Count      Total    p50us    p99us    maxus");
 
-	irc_target_get_nick(origin, nick, sizeof(nick));
+	for (i = 0; i < cnt; i++) {
+		const struct gpirc_stats_hist *hist = &evs[i]->hist;
+		int len;
+
+		len = snprintf(buf, sizeof(buf), "-!- %-14s %7llu %8.2fms %8.1f %8.1f %8.1f",
+		               evs[i]->name, (unsigned long long)hist->cnt,
+		               hist->sum / 1000000.0,
+		               gpirc_stats_hist_pct(hist, 50) / 1000.0,
+		               gpirc_stats_hist_pct(hist, 99) / 1000.0,
+		               hist->max / 1000.0);
+
+		if (evs[i]->unhandled && len > 0 && (size_t)len < sizeof(buf)) {
+			snprintf(buf + len, sizeof(buf) - len, " (%llu unhandled)",
+			         (unsigned long long)evs[i]->unhandled);
+		}
 
-	//TODO: go over channels and rename nick
-	printf("User %s changed nick to %s\n", nick, params[0]);
+		gp_widget_log_append(self, buf);
+	}
 }
 
-static void event_channel(irc_session_t *session, const char *event,
-                          const char *origin, const char **params,
-                          unsigned int count)
+static void stats_chans(gp_widget *self)
 {
-	char nick[128];
-
-	(void) session;
-	(void) event;
+	struct chan_rate *rates;
+	size_t i, cnt;
+	char buf[256];
 
-	if (count != 2)
+	rates = chans_by_rate(&cnt);
+	if (!rates) {
+		gp_widget_log_append(self, "-!- Allocation failure");
 		return;
+	}
 
-	irc_target_get_nick(origin, nick, sizeof(nick));
+	if (!cnt)
+		gp_widget_log_append(self, "-!- No channels");
 
-	channels_printf(params[0], "<%s> %s", nick, params[1]);
-}
+	for (i = 0; i < cnt && i < STATS_TOP; i++) {
+		struct channel *chan = rates[i].chan;
 
-static void chan_set_topic(const char *chan_name, const char *topic)
-{
-	struct channel *channel = gp_htable_get(channels_map, chan_name);
-	if (!channel)
-		return;
+		snprintf(buf, sizeof(buf), "-!- %s/%s %.1f msgs/min, %llu msgs, %zu nicks",
+		         net_name(chan->net), chan->name, rates[i].rate,
+		         (unsigned long long)chan->msgs.tail, chan->nicks.cnt);
 
-	free(channel->topic);
-	channel->topic = strdup(topic);
+		gp_widget_log_append(self, buf);
+	}
 
-	if (channels_is_active(channel->channel_log))
-		set_topic_label(channel->topic);
+	free(rates);
 }
 
-static void event_topic(irc_session_t *session, const char *event,
-                        const char *origin, const char **params,
-			unsigned int count)
+static void json_str(FILE *f, const char *str)
 {
-	(void) origin;
-	(void) session;
-	(void) event;
-	char nick[128];
-
-	if (count != 2)
-		return;
+	fputc('"', f);
 
-	chan_set_topic(params[0], params[1]);
+	for (; *str; str++) {
+		unsigned char c = *str;
 
-	irc_target_get_nick(origin, nick, sizeof(nick));
+		if (c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(f, "\\u%04x", c);
+		else
+			fputc(c, f);
+	}
 
-	channels_printf(params[0], "-!- %s changed topic to '%s'", nick, params[1]);
+	fputc('"', f);
 }
 
-static uint32_t poll_irc(gp_timer *self)
+static void json_hist(FILE *f, const struct gpirc_stats_hist *hist)
 {
-	fd_set in_set;
-	fd_set out_set;
-	int maxfd, err;
-	struct timeval t = {};
-
-	(void) self;
+	fprintf(f, "\"cnt\": %llu, \"sum_ns\": %llu, \"p50_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu",
+	        (unsigned long long)hist->cnt,
+	        (unsigned long long)hist->sum,
+	        (unsigned long long)gpirc_stats_hist_pct(hist, 50),
+	        (unsigned long long)gpirc_stats_hist_pct(hist, 99),
+	        (unsigned long long)hist->max);
+}
 
-	if (!irc_is_connected(irc_session)) {
-		status_log_printf("Connection failed: %s", irc_strerror(irc_errno(irc_session)));
-		irc_disconnect(irc_session);
-		return GP_TIMER_STOP;
+static void stats_json(FILE *f)
+{
+	const struct gpirc_stats_ev *evs[128];
+	struct gpirc_search_stats search_stats;
+	struct gpirc_log_stats log_stats;
+	struct gpirc_net_stats net_stats;
+	struct mem_stats mem;
+	struct chan_rate *rates;
+	size_t i, cnt;
+
+	gpirc_net_stats(&net_stats);
+	gpirc_logs_stats(&log_stats);
+	gpirc_search_stats(&search_stats);
+	mem_stats(&mem);
+
+	fprintf(f, "{\n\t\"time\": %lld,\n", (long long)time(NULL));
+	fprintf(f, "\t\"uptime_ms\": %llu,\n",
+	        (unsigned long long)(gpirc_monotonic_ns() - start_ns) / 1000000);
+	fprintf(f, "\t\"msgs\": %llu,\n", (unsigned long long)redraw_stats.msgs);
+	fprintf(f, "\t\"highlights\": %llu,\n", (unsigned long long)redraw_stats.highlights);
+	fprintf(f, "\t\"ignored\": %llu,\n", (unsigned long long)redraw_stats.ignored);
+
+	fprintf(f, "\t\"redraws\": {");
+	json_hist(f, &redraw_stats.render);
+	fprintf(f, "},\n");
+
+	fprintf(f, "\t\"traffic\": {\"lines_in\": %llu, \"bytes_in\": %llu, "
+	           "\"lines_out\": %llu, \"bytes_out\": %llu},\n",
+	        (unsigned long long)net_stats.lines_in,
+	        (unsigned long long)net_stats.bytes_in,
+	        (unsigned long long)net_stats.lines_out,
+	        (unsigned long long)net_stats.bytes_out);
+
+	fprintf(f, "\t\"lag\": [");
+
+	for (i = 0; i < gp_vec_len(networks); i++) {
+		struct lag *lag = &networks[i]->lag;
+
+		fprintf(f, "%s\n\t\t{\"net\": ", i ? "," : "");
+		json_str(f, net_name(networks[i]));
+		fprintf(f, ", \"cur_ns\": %llu, \"avg_ns\": %llu, ",
+		        (unsigned long long)lag->cur_ns, (unsigned long long)lag->avg_ns);
+		json_hist(f, &lag->hist);
+		fprintf(f, "}");
 	}
 
-	FD_ZERO(&in_set);
-	FD_ZERO(&out_set);
+	fprintf(f, "\n\t],\n");
 
-	err = irc_add_select_descriptors(irc_session, &in_set, &out_set, &maxfd);
-	if (err)
-		return self->period;
+	fprintf(f, "\t\"log\": {\"bytes\": %llu, \"writes\": %llu, \"dropped\": %llu, \"errors\": %llu},\n",
+	        (unsigned long long)log_stats.bytes,
+	        (unsigned long long)log_stats.writes,
+	        (unsigned long long)log_stats.dropped,
+	        (unsigned long long)log_stats.errors);
 
-	if (select(maxfd+1, &in_set, &out_set, NULL, &t) <= 0)
-		return self->period;
+	fprintf(f, "\t\"memory\": {\"rss\": %zu, \"channels\": %zu, \"msgs\": %zu, "
+	           "\"nicks\": %zu, \"users\": %zu, \"logs\": %zu, \"search\": %zu, \"stats\": %zu, "
+	           "\"rules\": %zu},\n",
+	        rss_kb() * 1024, mem.chans, mem.msgs, mem.nicks, mem.users,
+	        log_stats.mem, search_stats.bytes, gpirc_stats_mem(), mem.rules);
 
-	irc_process_select_descriptors(irc_session, &in_set, &out_set);
+	fprintf(f, "\t\"events\": [");
 
-	return self->period;
-}
+	cnt = gpirc_stats_evs(evs, GP_ARRAY_SIZE(evs));
 
-static gp_timer poll_timer = {
-	.period = 100,
-	.callback = poll_irc,
-	.id = "Poll IRC",
-};
+	for (i = 0; i < cnt; i++) {
+		fprintf(f, "%s\n\t\t{\"name\": ", i ? "," : "");
+		json_str(f, evs[i]->name);
+		fprintf(f, ", \"unhandled\": %llu, ", (unsigned long long)evs[i]->unhandled);
+		json_hist(f, &evs[i]->hist);
+		fprintf(f, "}");
+	}
 
-static void do_connect(void)
-{
-	int err;
+	fprintf(f, "\n\t],\n\t\"channels\": [");
 
-	if (!gpirc_conf.server)
-		return;
+	rates = chans_by_rate(&cnt);
 
-	status_log_printf("Connecting as %s to %s port %i",
-	                  gpirc_conf.nick, gpirc_conf.server, gpirc_conf.port);
+	for (i = 0; rates && i < cnt; i++) {
+		struct channel *chan = rates[i].chan;
 
-	err = irc_connect(irc_session, gpirc_conf.server, gpirc_conf.port, 0, gpirc_conf.nick, 0, 0);
-	if (!err) {
-		gp_widgets_timer_ins(&poll_timer);
-		return;
+		fprintf(f, "%s\n\t\t{\"net\": ", i ? "," : "");
+		json_str(f, net_name(chan->net));
+		fprintf(f, ", \"name\": ");
+		json_str(f, chan->name);
+		fprintf(f, ", \"rate\": %.2f, \"msgs\": %llu, \"nicks\": %zu}",
+		        rates[i].rate, (unsigned long long)chan->msgs.tail, chan->nicks.cnt);
 	}
 
-	status_log_printf("Connection failed: %s", irc_strerror(irc_errno(irc_session)));
+	free(rates);
+
+	fprintf(f, "\n\t]\n}\n");
 }
 
-static int str_append(char **str, const char *suf)
+/*
+ * The file is replaced atomically so that it can be polled by other tools.
+ */
+static int stats_dump(const char *path)
 {
-	size_t str_len = strlen(*str);
-	size_t suf_len = strlen(suf);
-	char *ret = malloc(str_len + suf_len + 1);
+	char tmp[1024];
+	FILE *f;
+	int err;
 
-	if (!ret)
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+		errno = ENAMETOOLONG;
 		return 1;
+	}
 
-	strcpy(ret, *str);
-	strcpy(ret + str_len, suf);
-	ret[str_len + suf_len] = 0;
+	f = fopen(tmp, "w");
+	if (!f)
+		return 1;
 
-	free(*str);
-	*str = ret;
+	stats_json(f);
 
-	return 0;
-}
+	err = ferror(f);
+	if (fclose(f) || err)
+		goto err;
 
-static void retry_with_new_nick(void)
-{
-	if (str_append(&gpirc_conf.nick, "_"))
-		return;
+	if (rename(tmp, path))
+		goto err;
 
-	irc_cmd_nick(irc_session, gpirc_conf.nick);
+	return 0;
+err:
+	unlink(tmp);
+	return 1;
 }
 
-static void print_topic_who_time(const char *chan,
-                                 const char *who, const char *time)
+static struct stats_dump {
+	char *path;
+	uint32_t period_ms;
+	int running;
+} stats_dumper;
+
+static uint32_t stats_dump_timeout(gp_timer *self)
 {
-	time_t timestamp = atoi(time);
-	struct tm *tm_time = localtime(&timestamp);
-	char str_time[80];
-	char nick[128];
+	(void) self;
 
-	if (!strftime(str_time, sizeof(str_time), "%a %b %d %H:%M:%S %Y", tm_time))
-		str_time[0] = 0;
+	if (!stats_dump(stats_dumper.path))
+		return stats_dumper.period_ms;
 
-	irc_target_get_nick(who, nick, sizeof(nick));
+	status_log_printf("-!- Stats dump to '%s' failed: %s, stopping",
+	                  stats_dumper.path, strerror(errno));
 
-	channels_printf(chan, "-!- Topic set by %s [%s] [%s]", nick, who, str_time);
-}
+	stats_dumper.running = 0;
 
-static void event_numeric(irc_session_t *session, unsigned int event,
-                          const char *origin, const char **params,
-                          unsigned int count)
-{
-	(void)origin;
-	(void)session;
+	return GP_TIMER_STOP;
+}
 
-	switch (event) {
-	case LIBIRC_RFC_RPL_MOTD:
-	case LIBIRC_RFC_RPL_WELCOME:
-	case LIBIRC_RFC_RPL_YOURHOST:
-	case LIBIRC_RFC_RPL_CREATED:
-	case LIBIRC_RFC_RPL_ENDOFMOTD:
-	case LIBIRC_RFC_RPL_MOTDSTART:
-	case LIBIRC_RFC_RPL_LUSERCLIENT:
-	case LIBIRC_RFC_RPL_LUSERME:
-	case LIBIRC_RFC_RPL_LUSEROP:
-	case LIBIRC_RFC_RPL_LUSERUNKNOWN:
-	case LIBIRC_RFC_RPL_LUSERCHANNELS:
-	/* Highest connection count */
-	case 250:
-	/* Current local users */
-	case 265:
-	/* Current global users */
-	case 266:
-	/* Displayed host */
-	case 396:
-		if (count == 2)
-			status_log_append(params[1]);
+static gp_timer stats_dump_timer = {
+	.callback = stats_dump_timeout,
+	.id = "Stats dump",
+};
 
-		if (count >= 3)
-			status_log_printf("%s %s", params[1], params[2]);
+static void stats_dump_stop(void)
+{
+	if (stats_dumper.running)
+		gp_widgets_timer_rem(&stats_dump_timer);
 
-	break;
-	case LIBIRC_RFC_RPL_BOUNCE:
-	case LIBIRC_RFC_RPL_MYINFO:
-		status_log_appends(params + 1, count - 1);
-	break;
-	case LIBIRC_RFC_RPL_ENDOFNAMES:
-		chan_print_nicks(params[1]);
-	break;
-	case LIBIRC_RFC_RPL_NAMREPLY:
-		chan_add_nicks(params[2], params[3]);
-	break;
-	case LIBIRC_RFC_RPL_NOTOPIC:
-		printf("NOTOPIC %s", params[0]);
-	break;
-	case LIBIRC_RFC_RPL_TOPIC:
-		if (count < 3)
-			return;
-		chan_set_topic(params[1], params[2]);
-		channels_printf(params[1], "-!- Topic for %s: %s", params[1], params[2]);
-	break;
-	/* RPL_TOPICWHOTIME */
-	case 333:
-		if (count < 3)
-			return;
-		print_topic_who_time(params[1], params[2], params[3]);
-	break;
-	case LIBIRC_RFC_ERR_CHANOPRIVSNEEDED:
-		channels_printf(params[1], "%s %s", params[1], params[2]);
-	break;
-	case LIBIRC_RFC_ERR_NICKNAMEINUSE:
-		if (count >= 2)
-			status_log_printf("Your nick %s is already in use", params[1]);
-		retry_with_new_nick();
-	break;
-	default:
-		status_log_printf("Unhandled event %i\n", event);
-		printf("Unhandled event %i\n", event);
-	break;
-	}
+	stats_dumper.running = 0;
+	free(stats_dumper.path);
+	stats_dumper.path = NULL;
 }
 
-static void cmd_connect(gp_widget *self, const char *pars)
+static void cmd_stats_dump(gp_widget *self, const char *pars)
 {
-	if (!pars[0]) {
-		gp_widget_log_append(self, "/connect requires parameter(s)");
+	char path[1024], buf[1200];
+	unsigned int secs = 0;
+
+	if (!strcmp(pars, "off")) {
+		stats_dump_stop();
+		gp_widget_log_append(self, "-!- Stats dump stopped");
 		return;
 	}
 
-	if (gpirc_conf_conn_set(&gpirc_conf, pars, 0))
-		gp_widget_log_append(self, "/connect failed to set serever");
+	if (sscanf(pars, "%1023s %u", path, &secs) < 1) {
+		gp_widget_log_append(self, "/stats dump invalid parameters");
+		return;
+	}
 
-	do_connect();
-}
+	if (stats_dump(path)) {
+		snprintf(buf, sizeof(buf), "-!- Failed to write '%s': %s", path, strerror(errno));
+		gp_widget_log_append(self, buf);
+		return;
+	}
 
-static void cmd_quit(gp_widget *self, const char *pars)
-{
-	if (pars[0]) {
-		gp_widget_log_append(self, "/quit command invalid parameters");
+	if (!secs) {
+		snprintf(buf, sizeof(buf), "-!- Stats written to '%s'", path);
+		gp_widget_log_append(self, buf);
 		return;
 	}
 
-	gp_widgets_exit(0);
-}
+	stats_dump_stop();
 
-static void cmd_wc(gp_widget *self, const char *pars)
-{
-	if (pars[0]) {
-		gp_widget_log_append(self, "/wc command invalid parameters");
+	stats_dumper.path = strdup(path);
+	if (!stats_dumper.path) {
+		gp_widget_log_append(self, "-!- Allocation failure");
 		return;
 	}
 
-	channels_rem(self);
+	stats_dumper.period_ms = secs * 1000;
+	stats_dumper.running = 1;
+	stats_dump_timer.expires = stats_dumper.period_ms;
+	gp_widgets_timer_ins(&stats_dump_timer);
+
+	snprintf(buf, sizeof(buf), "-!- Writing stats to '%s' every %us", path, secs);
+	gp_widget_log_append(self, buf);
 }
 
-static void cmd_join(gp_widget *self, const char *pars)
+static void cmd_stats(gp_widget *self, const char *pars)
 {
-	const char *pass, *chan = pars;
-	char tmp[128];
-
 	if (!pars[0]) {
-		gp_widget_log_append(self, "/join requires parameter");
+		stats_summary(self);
 		return;
 	}
 
-	pass = strchr(pars, ' ');
-	if (pass) {
-		size_t len = pass - pars;
-
-		if (len > sizeof(tmp) - 1) {
-			gp_widget_log_append(self, "/join channel name too long");
-			return;
-		}
-
-		strncpy(tmp, pars, len);
-		tmp[len] = 0;
-		chan = tmp;
-	}
-
-	channels_join(chan, pass);
-}
+	if (!strcmp(pars, "events")) {
+		stats_events(self);
+		return;
+	}
 
-static void cmd_nick(gp_widget *self, const char *pars)
-{
-	if (!pars[0]) {
-		gp_widget_log_append(self, "/nick requires a parameter");
+	if (!strcmp(pars, "chans")) {
+		stats_chans(self);
 		return;
 	}
 
-	if (gpirc_conf_nick_set(&gpirc_conf, pars))
-		gp_widget_log_append(self, "/nick failed to set nick");
+	if (!strcmp(pars, "reset")) {
+		size_t i;
 
-	if (irc_is_connected(irc_session))
-		irc_cmd_nick(irc_session, gpirc_conf.nick);
-}
+		gpirc_stats_reset();
+		memset(&redraw_stats.render, 0, sizeof(redraw_stats.render));
 
-static void cmd_topic(gp_widget *self, const char *pars)
-{
-	struct channel *channel = self->priv;
+		for (i = 0; i < gp_vec_len(networks); i++)
+			memset(&networks[i]->lag.hist, 0, sizeof(networks[i]->lag.hist));
 
-	if (!pars[0]) {
-		gp_widget_log_append(self, "/topic requires parameter");
+		gp_widget_log_append(self, "-!- Event and lag statistics cleared");
+		return;
+	}
+
+	if (!strncmp(pars, "dump ", 5)) {
+		cmd_stats_dump(self, pars + 5);
 		return;
 	}
 
-	irc_cmd_topic(irc_session, channel->name, pars);
+	gp_widget_log_append(self, "/stats invalid parameters");
 }
 
 static const char *help[] = {
-	" /connect    - Connects to server",
+	" /connect    - Connects to server, adds a network if needed",
 	" /help       - Prints this help",
+	" /history    - Opens channel history",
 	" /join #chan - Joins channel #chan",
+	" /latency    - Socket to log latency [on|off]",
 	" /nick nick  - Sets nickname",
 	" /quit       - Quits",
+	" /record f   - Records received lines into file f, stops without f",
+	" /search txt - Searches all channels for messages with all the words",
+	" /stats      - Prints runtime statistics [events|chans|reset]",
+	" /stats dump - Writes JSON statistics, dump file [secs] or dump off",
 	" /topic      - Sets channel topic",
 	" /wc         - Closes this window"
 };
@@ -702,9 +3913,14 @@ static struct cmd {
 } cmds[] = {
 	{"connect", cmd_connect},
 	{"help", cmd_help},
+	{"history", cmd_history},
 	{"join", cmd_join},
+	{"latency", cmd_latency},
 	{"nick", cmd_nick},
 	{"quit", cmd_quit},
+	{"record", cmd_record},
+	{"search", cmd_search},
+	{"stats", cmd_stats},
 	{"topic", cmd_topic},
 	{"wc", cmd_wc},
 	{}
@@ -722,14 +3938,14 @@ static size_t prefix_len(const char *cmd)
 	return ret;
 }
 
-static struct cmd *cmd_lookup(const char *cmd, const char **pars)
+static struct cmd *cmd_lookup(struct cmd *table, const char *cmd, const char **pars)
 {
 	struct cmd *c;
 	size_t plen = prefix_len(cmd);
 
 	*pars = cmd + plen + (cmd[plen] ? 1 : 0);
 
-	for (c = cmds; c->cmd; c++) {
+	for (c = table; c->cmd; c++) {
 		if (!strncmp(c->cmd, cmd, plen))
 			return c;
 	}
@@ -737,42 +3953,283 @@ static struct cmd *cmd_lookup(const char *cmd, const char **pars)
 	return NULL;
 }
 
-static void cmd_run(gp_widget *self, const char *cmd)
+static void cmd_run(struct cmd *table, gp_widget *self, const char *cmd)
 {
 	const char *pars;
-	struct cmd *c = cmd_lookup(++cmd, &pars);
+	struct cmd *c = cmd_lookup(table, ++cmd, &pars);
 
-	if (!c)
+	if (!c) {
 		gp_widget_log_append(self, "Invalid command");
-	else
-		c->cmd_run(self, pars);
+		return;
+	}
 
-	return;
+	c->cmd_run(self, pars);
+
+	/* The command may have queued lines */
+	sendq_watch();
 }
 
 static void cmd_status_log(gp_widget *self, const char *cmd)
 {
 	if (cmd[0] == '/') {
-		cmd_run(self, cmd);
+		cmd_run(cmds, self, cmd);
 		return;
 	}
 
 	//???
 }
 
+/*
+ * Message bodies are split so that the line the server relays to others, with
+ * our nick!user@host prefix added, fits into the server line limit.
+ */
+#define MSG_MIN_LEN 64
+#define MSG_USER_LEN 10
+#define MSG_HOST_LEN 63
+
+static size_t msg_max_len(struct network *net, const char *target)
+{
+	size_t line_len = net->isupport.line_len;
+	size_t prefix = 1 + strlen(net->conf.nick) + 1 + MSG_USER_LEN + 1 + MSG_HOST_LEN + 1;
+	size_t used = prefix + strlen("PRIVMSG ") + strlen(target) + strlen(" :") + 2;
+
+	if (line_len > GPIRC_NET_CMD_MAX - 1)
+		line_len = GPIRC_NET_CMD_MAX - 1;
+
+	if (line_len < used + MSG_MIN_LEN)
+		return MSG_MIN_LEN;
+
+	return line_len - used;
+}
+
+/*
+ * Returns length of the first chunk of a message that fits into max bytes,
+ * the message is split at a space if possible and never inside of an UTF-8
+ * sequence.
+ */
+static size_t msg_chunk(const char *str, size_t len, size_t max)
+{
+	size_t i;
+
+	if (len <= max)
+		return len;
+
+	for (i = max; i > max / 2; i--) {
+		if (str[i] == ' ')
+			return i;
+	}
+
+	for (i = max; i > 0 && (str[i] & 0xc0) == 0x80; i--);
+
+	return i ? i : max;
+}
+
 static void cmd_channel(gp_widget *self, const char *cmd)
 {
 	if (cmd[0] == '/') {
-		cmd_run(self, cmd);
+		cmd_run(cmds, self, cmd);
 		return;
 	}
 
 	struct channel *channel = self->priv;
-	struct gpirc_conf *conf = irc_get_ctx(irc_session);
+	struct network *net = channel->net;
+	enum gpirc_net_prio prio = GPIRC_NET_INTERACTIVE;
+	size_t max = msg_max_len(net, channel->name);
+	unsigned int dropped = 0;
+	char buf[GPIRC_NET_CMD_MAX];
+	const char *end;
+
+	/* Pastes go after anything typed in the meantime */
+	if (strchr(cmd, '\n') || strlen(cmd) > max)
+		prio = GPIRC_NET_BULK;
+
+	for (; *cmd; cmd = *end ? end + 1 : end) {
+		const char *line = cmd;
+		size_t len, chunk;
+
+		end = strchr(cmd, '\n');
+		if (!end)
+			end = cmd + strlen(cmd);
+
+		len = end - line;
+		if (len && line[len - 1] == '\r')
+			len--;
+
+		while (len) {
+			chunk = msg_chunk(line, len, max);
+
+			memcpy(buf, line, chunk);
+			buf[chunk] = 0;
+
+			line += chunk;
+			len -= chunk;
+
+			if (len && *line == ' ') {
+				line++;
+				len--;
+			}
+
+			/* Keep the order, drop everything after the first failure */
+			if (dropped || gpirc_net_send_prio(net->session, prio, "PRIVMSG %s :%s",
+			                                   channel->name, buf)) {
+				dropped++;
+				continue;
+			}
+
+			/* Shown once the server echoes it back */
+			if (!CAP_ENABLED(net, CAP_ECHO_MESSAGE))
+				chan_msg(net, channel->name, GPIRC_MSG_PRIVMSG, net->conf.nick, buf);
+		}
+	}
+
+	sendq_watch();
+
+	if (dropped) {
+		snprintf(buf, sizeof(buf), "-!- Send queue full, %u lines dropped", dropped);
+		gp_widget_log_append(self, buf);
+	}
+}
+
+/*
+ * Commands in a history tab.
+ */
+static void hist_cmd_move(gp_widget *self, const char *pars, int dir)
+{
+	struct hist_view *view = hist_by_widget(self);
+	char *end;
+	unsigned long cnt = HIST_PAGE;
+
+	if (pars[0]) {
+		cnt = strtoul(pars, &end, 10);
+		if (*end) {
+			gp_widget_log_append(self, "-!- Expected number of lines");
+			return;
+		}
+	}
+
+	hist_move(view, dir, cnt);
+}
+
+static void cmd_hist_back(gp_widget *self, const char *pars)
+{
+	hist_cmd_move(self, pars, -1);
+}
+
+static void cmd_hist_fwd(gp_widget *self, const char *pars)
+{
+	hist_cmd_move(self, pars, 1);
+}
+
+/*
+ * Parses [today|yesterday|YYYY-MM-DD] HH:MM
+ */
+static int parse_when(const char *pars, time_t *when)
+{
+	time_t now = time(NULL);
+	struct tm tm;
+	int len = 0;
+
+	localtime_r(&now, &tm);
+
+	if (!strncmp(pars, "today ", 6)) {
+		pars += 6;
+	} else if (!strncmp(pars, "yesterday ", 10)) {
+		tm.tm_mday--;
+		pars += 10;
+	} else if (sscanf(pars, "%4d-%2d-%2d %n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &len) == 3 && len) {
+		tm.tm_year -= 1900;
+		tm.tm_mon--;
+		pars += len;
+	}
+
+	len = 0;
+	if (sscanf(pars, "%2d:%2d%n", &tm.tm_hour, &tm.tm_min, &len) != 2 || pars[len])
+		return 1;
+
+	tm.tm_sec = 0;
+	tm.tm_isdst = -1;
+
+	*when = mktime(&tm);
+
+	return *when == (time_t)-1;
+}
+
+static void cmd_hist_at(gp_widget *self, const char *pars)
+{
+	struct hist_view *view = hist_by_widget(self);
+	time_t when;
+
+	if (parse_when(pars, &when)) {
+		gp_widget_log_append(self, "/at expects [today|yesterday|YYYY-MM-DD] HH:MM");
+		return;
+	}
+
+	gpirc_hist_refresh(&view->hist);
+	hist_show(view, gpirc_hist_find(&view->hist, when));
+}
+
+static void cmd_hist_wc(gp_widget *self, const char *pars)
+{
+	if (pars[0]) {
+		gp_widget_log_append(self, "/wc command invalid parameters");
+		return;
+	}
+
+	hist_close(hist_by_widget(self));
+}
+
+static const char *hist_help[] = {
+	" /at [day] HH:MM - Jumps to time, day is today, yesterday or YYYY-MM-DD",
+	" /back [lines]   - Goes back in history, a page by default",
+	" /fwd [lines]    - Goes forward in history, a page by default",
+	" /help           - Prints this help",
+	" /wc             - Closes history",
+	" Alt+PageUp and Alt+PageDown page through the history",
+};
+
+static void cmd_hist_help(gp_widget *self, const char *pars)
+{
+	size_t i;
 
-	irc_cmd_msg(irc_session, channel->name, cmd);
+	(void) pars;
+
+	for (i = 0; i < GP_ARRAY_SIZE(hist_help); i++)
+		gp_widget_log_append(self, hist_help[i]);
+}
+
+static struct cmd search_cmds[] = {
+	{"search", cmd_search},
+	{"wc", cmd_search_wc},
+	{}
+};
+
+static void cmd_search_tab(gp_widget *self, const char *cmd)
+{
+	if (cmd[0] == '/') {
+		cmd_run(search_cmds, self, cmd);
+		return;
+	}
+
+	cmd_search(self, cmd);
+}
+
+static struct cmd hist_cmds[] = {
+	{"at", cmd_hist_at},
+	{"back", cmd_hist_back},
+	{"fwd", cmd_hist_fwd},
+	{"help", cmd_hist_help},
+	{"wc", cmd_hist_wc},
+	{}
+};
 
-	channels_printf(channel->name, "<%s> %s", conf->nick, cmd);
+static void cmd_hist(gp_widget *self, const char *cmd)
+{
+	if (cmd[0] == '/') {
+		cmd_run(hist_cmds, self, cmd);
+		return;
+	}
+
+	gp_widget_log_append(self, "-!- History is read only, try /help");
 }
 
 int cmdline(gp_widget_event *ev)
@@ -788,6 +4245,10 @@ int cmdline(gp_widget_event *ev)
 
 	if (channels_is_status_log(active))
 		cmd_status_log(active, cmd);
+	else if (active == search_log)
+		cmd_search_tab(active, cmd);
+	else if (hist_by_widget(active))
+		cmd_hist(active, cmd);
 	else
 		cmd_channel(active, cmd);
 
@@ -796,11 +4257,118 @@ int cmdline(gp_widget_event *ev)
 	return 1;
 }
 
+/*
+ * Nick completion.
+ *
+ * Tab completes the last word of the input line, repeated Tab cycles through
+ * the matches as long as the line is not edited in between. A nick at the
+ * start of the line is followed by ": ".
+ */
+#define COMPL_MAX 64
+
+static struct compl {
+	struct channel *chan;
+	/* The line up to the completed word */
+	char *line;
+	char *prefix;
+	/* Line set by the last completion */
+	char *last;
+	unsigned int idx;
+} compl;
+
+static void compl_reset(void)
+{
+	free(compl.line);
+	free(compl.prefix);
+	free(compl.last);
+	memset(&compl, 0, sizeof(compl));
+}
+
+static int compl_start(struct channel *chan, const char *text)
+{
+	const char *word = strrchr(text, ' ');
+
+	word = word ? word + 1 : text;
+
+	/* Commands are not completed */
+	if (text[0] == '/' && word == text)
+		return 1;
+
+	compl_reset();
+
+	compl.chan = chan;
+	compl.line = strndup(text, word - text);
+	compl.prefix = strdup(word);
+
+	if (!compl.line || !compl.prefix) {
+		compl_reset();
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Completes the nick before the cursor in the focused command line.
+ *
+ * @return Non-zero if a nick was completed and the Tab key is consumed.
+ */
+static int cmdline_complete(void)
+{
+	struct channel *chan = channels_active_chan();
+	struct gpirc_member *res[COMPL_MAX];
+	const char *text, *nick;
+	size_t i, j, cnt, len;
+	char *line;
+
+	if (!chan || !cmdline_tbox || !cmdline_tbox->focused)
+		return 0;
+
+	text = gp_widget_tbox_text(cmdline_tbox);
+
+	if (compl.last && compl.chan == chan && !strcmp(text, compl.last))
+		compl.idx++;
+	else if (compl_start(chan, text))
+		return 0;
+
+	cnt = gpirc_nicks_complete(&chan->nicks, compl.prefix, res, COMPL_MAX);
+
+	for (i = j = 0; i < cnt; i++) {
+		if (gpirc_nick_cmp(res[i]->user->nick, chan->net->conf.nick))
+			res[j++] = res[i];
+	}
+
+	/* Let Tab move the focus */
+	if (!j)
+		return 0;
+
+	nick = res[compl.idx % j]->user->nick;
+	len = strlen(compl.line) + strlen(nick) + 3;
+
+	line = malloc(len);
+	if (!line)
+		return 1;
+
+	snprintf(line, len, "%s%s%s", compl.line, nick, compl.line[0] ? " " : ": ");
+
+	gp_widget_tbox_set(cmdline_tbox, line);
+
+	free(compl.last);
+	compl.last = line;
+
+	return 1;
+}
+
 static int app_input_ev(gp_event *ev)
 {
+	struct hist_view *view;
+
 	if (ev->type != GP_EV_KEY || ev->code != GP_EV_KEY_DOWN)
 		return 0;
 
+	if (ev->val == GP_KEY_TAB)
+		return cmdline_complete();
+
 	if (!gp_ev_any_key_pressed(ev, GP_KEY_LEFT_ALT, GP_KEY_RIGHT_ALT))
 		return 0;
 
@@ -811,6 +4379,14 @@ static int app_input_ev(gp_event *ev)
 	case GP_KEY_RIGHT:
 		gp_widget_tabs_active_set_rel(channel_tabs, 1, 1);
 	break;
+	case GP_KEY_PAGE_UP:
+	case GP_KEY_PAGE_DOWN:
+		view = hist_by_widget(channels_active());
+		if (!view)
+			return 0;
+
+		hist_move(view, ev->val == GP_KEY_PAGE_UP ? -1 : 1, HIST_PAGE);
+	break;
 	default:
 		return 0;
 	}
@@ -822,7 +4398,9 @@ static int app_on_event(gp_widget_event *ev)
 {
 	switch (ev->type) {
 	case GP_WIDGET_EVENT_FREE:
-		//TODO: Any cleanup?
+		gpirc_net_exit();
+		gpirc_search_exit();
+		gpirc_logs_exit();
 	break;
 	case GP_WIDGET_EVENT_INPUT:
 		return app_input_ev(ev->input_ev);
@@ -832,16 +4410,44 @@ static int app_on_event(gp_widget_event *ev)
 	return 0;
 }
 
-static irc_callbacks_t callbacks = {
-	.event_connect = event_connect,
-	.event_join = event_join,
-	.event_part = event_part,
-	.event_nick = event_nick,
-	.event_channel = event_channel,
-	.event_topic = event_topic,
-	.event_numeric = event_numeric,
+static struct gpirc_proto_table handlers = {
+	.numeric = event_numeric,
 };
 
+static void handlers_init(void)
+{
+	static const struct {
+		const char *cmd;
+		gpirc_proto_handler handler;
+	} cmds[] = {
+		{"AWAY", event_away},
+		{"BATCH", event_batch},
+		{"CAP", event_cap},
+		{"JOIN", event_join},
+		{"MODE", event_mode},
+		{"NICK", event_nick},
+		{"PART", event_part},
+		{"PONG", event_pong},
+		{"PRIVMSG", event_privmsg},
+		{"QUIT", event_quit},
+		{"TOPIC", event_topic},
+	};
+	size_t i;
+
+	for (i = 0; i < GP_ARRAY_SIZE(cmds); i++)
+		gpirc_proto_table_add(&handlers, cmds[i].cmd, cmds[i].handler);
+}
+
+/*
+ * Called for each line received by the network thread and by the replay.
+ */
+static void net_msg(void *priv, struct gpirc_proto_msg *msg)
+{
+	cur_msg = msg;
+	gpirc_proto_dispatch(&handlers, priv, msg);
+	cur_msg = NULL;
+}
+
 gp_app_info app_info = {
 	.name = "gpirc",
 	.desc = "A simple IRC client",
@@ -854,8 +4460,199 @@ gp_app_info app_info = {
 	}
 };
 
+static void app_init(void)
+{
+	startup_ns = gpirc_monotonic_ns() - start_ns;
+}
+
+#ifdef GPIRC_REPLAY
+/*
+ * Headless replay of a capture through the message handlers, see make bench.
+ *
+ * The widgets are created without a backend, logging to disk is disabled and
+ * the frame flush is called after each batch of events as if the network
+ * thread woke up the UI.
+ */
+#define REPLAY_BATCH 256
+
+static int u32_cmp(const void *a, const void *b)
+{
+	uint32_t ua = *(const uint32_t*)a;
+	uint32_t ub = *(const uint32_t*)b;
+
+	return (ua > ub) - (ua < ub);
+}
+
+static uint64_t replay_frame(void)
+{
+	uint64_t start = gpirc_monotonic_ns();
+
+	if (!frame_pending)
+		return 0;
+
+	gp_widgets_timer_rem(&frame_timer);
+	frame_flush(&frame_timer);
+
+	return gpirc_monotonic_ns() - start;
+}
+
+static void replay_nick(struct network *net, const char *nick)
+{
+	char *tmp = strdup(nick);
+
+	if (!tmp)
+		return;
+
+	free(net->conf.nick);
+	net->conf.nick = tmp;
+
+	rules_compile(net);
+}
+
+static int replay_main(int argc, char *argv[])
+{
+	struct gpirc_capture_msg msg;
+	struct gpirc_conf conf;
+	struct network *net;
+	struct rusage ru;
+	const char *nick = "gpirc";
+	unsigned int loop, loops = 1;
+	uint32_t *lat = NULL;
+	size_t lat_cnt = 0, lat_size = 0, batch = 0, size = 0;
+	uint64_t start, total_ns, frames_ns = 0;
+	char *line = NULL;
+	FILE *f;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "l:n:")) != -1) {
+		switch (opt) {
+		case 'l':
+			loops = atoi(optarg);
+		break;
+		case 'n':
+			nick = optarg;
+		break;
+		default:
+			goto usage;
+		}
+	}
+
+	if (optind + 1 != argc)
+		goto usage;
+
+	f = fopen(argv[optind], "r");
+	if (!f) {
+		fprintf(stderr, "Failed to open '%s': %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+
+	status_log = gp_widget_log_new(GP_TATTR_MONO, 80, 25, CHAN_LOG_LINES);
+	channel_tabs = gp_widget_tabs_new(0, 0, NULL, 0);
+	topic = gp_widget_label_new("", 0, 80);
+	status_bar = gp_widget_label_new("", 0, 80);
+	tab_chans = gp_vec_new(0, sizeof(struct channel *));
+	networks = gp_vec_new(0, sizeof(struct network *));
+
+	if (!status_log || !channel_tabs || !topic || !status_bar || !tab_chans || !networks)
+		return 1;
+
+	if (tabs_append("Status", status_log, NULL))
+		return 1;
+
+	gpirc_search_init();
+
+	handlers_init();
+
+	if (gpirc_net_init(net_msg, net_disconnected))
+		return 1;
+
+	if (gpirc_conf_init(&conf, nick))
+		return 1;
+
+	conf.name = strdup("replay");
+
+	net = net_new(&conf);
+	if (!net)
+		return 1;
+
+	cur_net = net;
+	start = gpirc_monotonic_ns();
+
+	for (loop = 0; loop < loops; loop++) {
+		rewind(f);
+
+		while (getline(&line, &size, f) > 0) {
+			if (gpirc_capture_parse(line, &msg)) {
+				if (!strncmp(line, "# nick ", 7))
+					replay_nick(net, line + 7);
+				continue;
+			}
+
+			if (lat_cnt >= lat_size) {
+				size_t new_size = lat_size ? 2 * lat_size : 4096;
+				uint32_t *tmp = realloc(lat, new_size * sizeof(*lat));
+
+				if (!tmp)
+					return 1;
+
+				lat = tmp;
+				lat_size = new_size;
+			}
+
+			uint64_t ev_start = gpirc_monotonic_ns();
+
+			net_msg(net, &msg.proto);
+
+			uint64_t ev_ns = gpirc_monotonic_ns() - ev_start;
+
+			lat[lat_cnt++] = ev_ns > UINT32_MAX ? UINT32_MAX : ev_ns;
+
+			if (++batch >= REPLAY_BATCH) {
+				frames_ns += replay_frame();
+				batch = 0;
+			}
+		}
+	}
+
+	frames_ns += replay_frame();
+	total_ns = gpirc_monotonic_ns() - start;
+
+	fclose(f);
+	free(line);
+
+	if (!lat_cnt) {
+		fprintf(stderr, "No events in '%s'\n", argv[optind]);
+		return 1;
+	}
+
+	qsort(lat, lat_cnt, sizeof(*lat), u32_cmp);
+	getrusage(RUSAGE_SELF, &ru);
+
+	printf("Replayed %zu events in %.3fs, %.0f events/s\n",
+	       lat_cnt, total_ns / 1e9, lat_cnt / (total_ns / 1e9));
+	printf("Per event latency p50 %.2fus p99 %.2fus max %.2fus\n",
+	       lat[lat_cnt / 2] / 1e3, lat[lat_cnt * 99 / 100] / 1e3, lat[lat_cnt - 1] / 1e3);
+	printf("Frame flushes %.2fms, peak RSS %ldKB\n", frames_ns / 1e6, ru.ru_maxrss);
+
+	free(lat);
+	gpirc_net_exit();
+	gpirc_search_exit();
+
+	return 0;
+usage:
+	fprintf(stderr, "usage: %s [-l loops] [-n nick] capture\n", argv[0]);
+	return 1;
+}
+#endif /* GPIRC_REPLAY */
+
 int main(int argc, char *argv[])
 {
+#ifdef GPIRC_REPLAY
+	return replay_main(argc, argv);
+#endif
+	start_ns = gpirc_monotonic_ns();
+	srandom(time(NULL) ^ getpid());
+
 	gp_htable *uids;
 	gp_widget *layout = gp_app_layout_load("gpirc", &uids);
 
@@ -868,24 +4665,52 @@ int main(int argc, char *argv[])
 	status_log = gp_widget_by_uid(uids, "status_log", GP_WIDGET_LOG);
 	channel_tabs = gp_widget_by_uid(uids, "channel_tabs", GP_WIDGET_TABS);
 	topic = gp_widget_by_uid(uids, "topic", GP_WIDGET_LABEL);
+	status_bar = gp_widget_by_uid(uids, "status", GP_WIDGET_LABEL);
+	cmdline_tbox = gp_widget_by_uid(uids, "cmdline", GP_WIDGET_TBOX);
 
 	if (channel_tabs)
 		gp_widget_on_event_set(channel_tabs, channels_on_event, NULL);
 
+	tab_chans = gp_vec_new(gp_widget_tabs_cnt(channel_tabs), sizeof(struct channel *));
+	if (!tab_chans)
+		return 1;
+
 	gp_htable_free(uids);
 
-	if (channels_init())
+	networks = gp_vec_new(0, sizeof(struct network *));
+	if (!networks)
 		return 1;
 
-	irc_session = irc_create_session(&callbacks);
-	if (!irc_session)
+	if (gpirc_logs_init())
+		status_log_append("Failed to start disk logging");
+
+	if (gpirc_search_init())
+		status_log_append("Failed to start history indexing");
+
+	handlers_init();
+
+	if (gpirc_net_init(net_msg, net_disconnected))
 		return 1;
 
+	net_fd.fd = gpirc_net_fd();
+	gp_widget_poll_add(&net_fd);
+
 	gpirc_conf_load(status_log);
 
-	irc_set_ctx(irc_session, &gpirc_conf);
-	do_connect();
-	gp_widgets_main_loop(layout, NULL, argc, argv);
+	if (!gpirc_confs || !gp_vec_len(gpirc_confs))
+		return 1;
+
+	GP_VEC_FOREACH(gpirc_confs, struct gpirc_conf, conf) {
+		if (!net_new(conf))
+			return 1;
+	}
+
+	cur_net = networks[0];
+
+	GP_VEC_FOREACH(networks, struct network *, net)
+		do_connect(*net);
+
+	gp_widgets_main_loop(layout, app_init, argc, argv);
 
 	return 0;
 }
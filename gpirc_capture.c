@@ -0,0 +1,55 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "gpirc_capture.h"
+
+void gpirc_capture_write(FILE *f, uint64_t time_ns, const struct gpirc_proto_msg *msg)
+{
+	unsigned int i;
+
+	fprintf(f, "%llu ", (unsigned long long)time_ns);
+
+	if (msg->tags.len)
+		fprintf(f, "@%.*s ", (int)msg->tags.len, msg->tags.str);
+
+	if (msg->nick.len || msg->mask.len)
+		fprintf(f, ":%s%s ", msg->nick.str, msg->mask.str);
+
+	fputs(msg->cmd.str, f);
+
+	for (i = 0; i < msg->param_cnt; i++)
+		fprintf(f, i + 1 < msg->param_cnt ? " %s" : " :%s", msg->params[i].str);
+
+	fputc('\n', f);
+}
+
+int gpirc_capture_parse(char *line, struct gpirc_capture_msg *msg)
+{
+	char *end;
+
+	msg->time_ns = 0;
+
+	line[strcspn(line, "\r\n")] = 0;
+
+	if (line[0] >= '0' && line[0] <= '9') {
+		msg->time_ns = strtoull(line, &end, 10);
+		line = end;
+	}
+
+	while (*line == ' ')
+		line++;
+
+	if (*line == '#')
+		return 1;
+
+	return gpirc_proto_parse(line, &msg->proto);
+}
@@ -0,0 +1,51 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * Raw IRC traffic captures.
+ *
+ * A capture is a text file with a received line per line, prefixed with the
+ * receive time in nanoseconds since the recording started:
+ *
+ * 1234567 :nick!user@host PRIVMSG #chan :hello
+ *
+ * The time is optional, lines starting with '#' are comments and
+ * "# nick <nick>" sets our nick.
+ *
+ * The recorder writes the lines back from the parsed messages and the replay
+ * parses them with gpirc_proto, the same way gpirc_net does with the lines it
+ * reads from the socket.
+ */
+
+#ifndef GPIRC_CAPTURE_H__
+#define GPIRC_CAPTURE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "gpirc_proto.h"
+
+struct gpirc_capture_msg {
+	/* Receive time, zero if not recorded */
+	uint64_t time_ns;
+	struct gpirc_proto_msg proto;
+};
+
+/*
+ * Writes a parsed message as a raw line.
+ */
+void gpirc_capture_write(FILE *f, uint64_t time_ns, const struct gpirc_proto_msg *msg);
+
+/*
+ * Parses a capture line in place, the strings in msg point into the line.
+ *
+ * @return Zero on success, non-zero for empty lines and comments.
+ */
+int gpirc_capture_parse(char *line, struct gpirc_capture_msg *msg);
+
+#endif /* GPIRC_CAPTURE_H__ */
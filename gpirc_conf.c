@@ -13,11 +13,12 @@
 #include <utils/gp_json.h>
 #include <utils/gp_app_cfg.h>
 #include <utils/gp_vec.h>
+#include "gpirc_net.h"
 #include "gpirc_conf.h"
 
-struct gpirc_conf gpirc_conf = {
-	.port = 6667,
-};
+struct gpirc_conf *gpirc_confs;
+char **gpirc_conf_highlight;
+char **gpirc_conf_ignore;
 
 struct gp_json_struct chan_desc[] = {
 	GP_JSON_SERDES_STR_DUP(struct gpirc_chan, chan, 0, 1024, "name"),
@@ -25,7 +26,8 @@ struct gp_json_struct chan_desc[] = {
 	{}
 };
 
-static void parse_channels(gp_json_reader *json, gp_json_val *val)
+static void parse_channels(gp_json_reader *json, gp_json_val *val,
+                           struct gpirc_conf *conf)
 {
 	GP_JSON_ARR_FOREACH(json, val) {
 		struct gpirc_chan chan = {};
@@ -35,15 +37,47 @@ static void parse_channels(gp_json_reader *json, gp_json_val *val)
 			continue;
 		}
 
-		GP_VEC_APPEND(gpirc_conf.chans, chan);
+		GP_VEC_APPEND(conf->chans, chan);
+	}
+}
+
+static char **parse_strs(gp_json_reader *json, gp_json_val *val, char **strs)
+{
+	GP_JSON_ARR_FOREACH(json, val) {
+		char *str;
+
+		if (val->type != GP_JSON_STR) {
+			gp_json_err(json, "Expected string");
+			continue;
+		}
+
+		if (!strs) {
+			strs = gp_vec_new(0, sizeof(char *));
+			if (!strs)
+				return NULL;
+		}
+
+		str = strdup(val->val_str);
+		if (!str)
+			continue;
+
+		GP_VEC_APPEND(strs, str);
 	}
+
+	return strs;
 }
 
 static struct gp_json_obj_attr conf_attrs[] = {
 	GP_JSON_OBJ_ATTR("channels", GP_JSON_ARR),
+	GP_JSON_OBJ_ATTR("flood_burst", GP_JSON_INT),
+	GP_JSON_OBJ_ATTR("flood_interval_ms", GP_JSON_INT),
+	GP_JSON_OBJ_ATTR("highlight", GP_JSON_ARR),
+	GP_JSON_OBJ_ATTR("ignore", GP_JSON_ARR),
+	GP_JSON_OBJ_ATTR("name", GP_JSON_STR),
 	GP_JSON_OBJ_ATTR("nick", GP_JSON_STR),
 	GP_JSON_OBJ_ATTR("port", GP_JSON_INT),
 	GP_JSON_OBJ_ATTR("server", GP_JSON_STR),
+	GP_JSON_OBJ_ATTR("servers", GP_JSON_ARR),
 };
 
 static struct gp_json_obj conf_obj_filter = {
@@ -51,13 +85,116 @@ static struct gp_json_obj conf_obj_filter = {
 	.attr_cnt = GP_ARRAY_SIZE(conf_attrs),
 };
 
+/* Objects in the servers array take the same keys except for servers */
+static struct gp_json_obj server_obj_filter = {
+	.attrs = conf_attrs,
+	.attr_cnt = GP_ARRAY_SIZE(conf_attrs) - 1,
+};
+
 enum conf_keys {
 	CHANNELS,
+	FLOOD_BURST,
+	FLOOD_INTERVAL_MS,
+	HIGHLIGHT,
+	IGNORE,
+	NAME,
 	NICK,
 	PORT,
 	SERVER,
+	SERVERS,
 };
 
+int gpirc_conf_init(struct gpirc_conf *self, const char *nick)
+{
+	*self = (struct gpirc_conf) {
+		.port = 6667,
+		.flood_burst = GPIRC_NET_BURST,
+		.flood_interval_ms = GPIRC_NET_INTERVAL_MS,
+	};
+
+	self->chans = gp_vec_new(0, sizeof(struct gpirc_chan));
+	if (!self->chans)
+		return 1;
+
+	if (!nick)
+		return 0;
+
+	self->nick = strdup(nick);
+	if (!self->nick) {
+		gp_vec_free(self->chans);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void parse_attr(gp_json_reader *json, gp_json_val *val,
+                       struct gpirc_conf *conf)
+{
+	switch (val->idx) {
+	case CHANNELS:
+		parse_channels(json, val, conf);
+	break;
+	case FLOOD_BURST:
+		if (val->val_int < 1) {
+			gp_json_warn(json, "flood_burst must be at least 1");
+			break;
+		}
+		conf->flood_burst = val->val_int;
+	break;
+	case FLOOD_INTERVAL_MS:
+		if (val->val_int < 0) {
+			gp_json_warn(json, "flood_interval_ms must not be negative");
+			break;
+		}
+		conf->flood_interval_ms = val->val_int;
+	break;
+	case HIGHLIGHT:
+		conf->highlight = parse_strs(json, val, conf->highlight);
+	break;
+	case IGNORE:
+		conf->ignore = parse_strs(json, val, conf->ignore);
+	break;
+	case NAME:
+		conf->name = strdup(val->val_str);
+	break;
+	case NICK:
+		conf->nick = strdup(val->val_str);
+	break;
+	case PORT:
+		conf->port = val->val_int;
+	break;
+	case SERVER:
+		conf->server = strdup(val->val_str);
+	break;
+	}
+}
+
+static void parse_servers(gp_json_reader *json, gp_json_val *val)
+{
+	GP_JSON_ARR_FOREACH(json, val) {
+		struct gpirc_conf conf;
+
+		if (val->type != GP_JSON_OBJ) {
+			gp_json_err(json, "Expected {\"server\": \"irc.example.org\"} object");
+			continue;
+		}
+
+		if (gpirc_conf_init(&conf, NULL))
+			return;
+
+		GP_JSON_OBJ_FOREACH_FILTER(json, val, &server_obj_filter, NULL)
+			parse_attr(json, val, &conf);
+
+		if (!conf.server) {
+			gp_json_warn(json, "Server entry without \"server\" ignored");
+			continue;
+		}
+
+		GP_VEC_APPEND(gpirc_confs, conf);
+	}
+}
+
 static char *get_user_name(void)
 {
 	struct passwd *pw;
@@ -69,8 +206,53 @@ static char *get_user_name(void)
 	return strdup(pw->pw_name);
 }
 
+/*
+ * Networks from the servers array inherit the top level nick, the top level
+ * server, if set, is the first network.
+ */
+static int conf_finish(struct gpirc_conf *top)
+{
+	gpirc_conf_highlight = top->highlight;
+	gpirc_conf_ignore = top->ignore;
+	top->highlight = NULL;
+	top->ignore = NULL;
+
+	if (!top->nick) {
+		top->nick = get_user_name();
+		if (!top->nick)
+			return 1;
+	}
+
+	GP_VEC_FOREACH(gpirc_confs, struct gpirc_conf, conf) {
+		if (conf->nick)
+			continue;
+
+		conf->nick = strdup(top->nick);
+		if (!conf->nick)
+			return 1;
+	}
+
+	if (!top->server && gp_vec_len(gpirc_confs)) {
+		free(top->name);
+		free(top->nick);
+		gp_vec_free(top->chans);
+		return 0;
+	}
+
+	struct gpirc_conf *confs = gp_vec_ins(gpirc_confs, 0, 1);
+
+	if (!confs)
+		return 1;
+
+	gpirc_confs = confs;
+	gpirc_confs[0] = *top;
+
+	return 0;
+}
+
 int gpirc_conf_load(gp_widget *status_log)
 {
+	struct gpirc_conf top;
 	char *conf_path;
 	gp_json_reader *json;
 	char buf[128];
@@ -79,8 +261,11 @@ int gpirc_conf_load(gp_widget *status_log)
 		.buf_size = sizeof(buf),
 	};
 
-	gpirc_conf.chans = gp_vec_new(0, sizeof(struct gpirc_chan));
-	if (!gpirc_conf.chans)
+	gpirc_confs = gp_vec_new(0, sizeof(struct gpirc_conf));
+	if (!gpirc_confs)
+		return 1;
+
+	if (gpirc_conf_init(&top, NULL))
 		return 1;
 
 	conf_path = gp_app_cfg_path("gpirc", "config.json");
@@ -91,10 +276,8 @@ int gpirc_conf_load(gp_widget *status_log)
 	if (!json) {
 		if (errno == ENOENT) {
 			gp_widget_log_append(status_log, "Config file not present");
-			gpirc_conf.nick = get_user_name();
-			if (!gpirc_conf.nick)
-				return 1;
-			return 0;
+			free(conf_path);
+			return conf_finish(&top);
 		}
 
 		gp_widget_log_append(status_log, "Failed to load config.json");
@@ -106,20 +289,10 @@ int gpirc_conf_load(gp_widget *status_log)
 	json->err_print = (void*)gp_widget_log_append;
 
 	GP_JSON_OBJ_FOREACH_FILTER(json, &val, &conf_obj_filter, NULL) {
-		switch (val.idx) {
-		case CHANNELS:
-			parse_channels(json, &val);
-		break;
-		case NICK:
-			gpirc_conf.nick = strdup(val.val_str);
-		break;
-		case PORT:
-			gpirc_conf.port = val.val_int;
-		break;
-		case SERVER:
-			gpirc_conf.server = strdup(val.val_str);
-		break;
-		}
+		if (val.idx == SERVERS)
+			parse_servers(json, &val);
+		else
+			parse_attr(json, &val, &top);
 	}
 
 	int err = gp_json_reader_err(json);
@@ -127,11 +300,8 @@ int gpirc_conf_load(gp_widget *status_log)
 	gp_json_reader_free(json);
 	free(conf_path);
 
-	if (!gpirc_conf.nick) {
-		gpirc_conf.nick = get_user_name();
-		if (!gpirc_conf.nick)
-			return 1;
-	}
+	if (conf_finish(&top))
+		return 1;
 
 	return err;
 }
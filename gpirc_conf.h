@@ -16,17 +16,47 @@ struct gpirc_chan {
 	char *pass;
 };
 
+/*
+ * Per network configuration.
+ */
 struct gpirc_conf {
+	/* Network name, defaults to the server hostname */
+	char *name;
 	char *server;
 	int port;
 	char *nick;
 	struct gpirc_chan *chans;
+	/* Send flood control, see gpirc_net_flood_set() */
+	unsigned int flood_burst;
+	unsigned int flood_interval_ms;
+	/*
+	 * Vectors of highlighted words and of ignored nicks or nick!user@host
+	 * substrings, NULL if empty.
+	 */
+	char **highlight;
+	char **ignore;
 };
 
-extern struct gpirc_conf gpirc_conf;
+/*
+ * Configured networks, a vector with at least one entry after a successful
+ * gpirc_conf_load().
+ */
+extern struct gpirc_conf *gpirc_confs;
+
+/*
+ * Rules from the top level of the config file, these apply to all networks
+ * in addition to the per network rules.
+ */
+extern char **gpirc_conf_highlight;
+extern char **gpirc_conf_ignore;
 
 int gpirc_conf_load(gp_widget *status_log);
 
+/*
+ * Initializes a network configuration with defaults.
+ */
+int gpirc_conf_init(struct gpirc_conf *self, const char *nick);
+
 int gpirc_conf_conn_set(struct gpirc_conf *self, const char *server, int port);
 
 int gpirc_conf_nick_set(struct gpirc_conf *self, const char *nick);
@@ -0,0 +1,241 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+#include <string.h>
+#include "gpirc_fmt.h"
+
+#define CODE_BOLD 0x02
+#define CODE_COLOR 0x03
+#define CODE_HEX_COLOR 0x04
+#define CODE_RESET 0x0f
+#define CODE_MONO 0x11
+#define CODE_REVERSE 0x16
+#define CODE_ITALIC 0x1d
+#define CODE_STRIKE 0x1e
+#define CODE_UNDERLINE 0x1f
+
+#define CODES ((1u<<CODE_BOLD) | (1u<<CODE_COLOR) | (1u<<CODE_HEX_COLOR) | \
+               (1u<<CODE_RESET) | (1u<<CODE_MONO) | (1u<<CODE_REVERSE) | \
+               (1u<<CODE_ITALIC) | (1u<<CODE_STRIKE) | (1u<<CODE_UNDERLINE))
+
+static inline int is_code(unsigned char c)
+{
+	return c < 0x20 && (CODES>>c) & 1;
+}
+
+#define ONES 0x0101010101010101ull
+
+int gpirc_fmt_plain(const char *str, size_t len)
+{
+	size_t i = 0;
+
+	/*
+	 * A byte under 0x20 sets the top bit of the byte after the subtraction
+	 * while ~w masks out bytes that had it set before. Borrows only
+	 * propagate from such bytes so there are no false negatives. The few
+	 * words with a control byte are checked bytewise, these are mostly
+	 * CTCP delimiters.
+	 */
+	for (; i + 8 <= len; i += 8) {
+		uint64_t w;
+		size_t j;
+
+		memcpy(&w, str + i, 8);
+
+		if (!((w - 0x20 * ONES) & ~w & 0x80 * ONES))
+			continue;
+
+		for (j = 0; j < 8; j++) {
+			if (is_code(str[i+j]))
+				return 0;
+		}
+	}
+
+	for (; i < len; i++) {
+		if (is_code(str[i]))
+			return 0;
+	}
+
+	return 1;
+}
+
+struct style {
+	uint8_t flags;
+	uint8_t fg;
+	uint8_t bg;
+};
+
+static const struct style style_default = {
+	.fg = GPIRC_FMT_COLOR_DEFAULT,
+	.bg = GPIRC_FMT_COLOR_DEFAULT,
+};
+
+static int style_eq(struct style a, struct style b)
+{
+	return a.flags == b.flags && a.fg == b.fg && a.bg == b.bg;
+}
+
+static int is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static int is_hex(char c)
+{
+	return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+/*
+ * Parses a one or two digit color, 99 is the default color.
+ */
+static size_t parse_color(const char *str, size_t len, uint8_t *color)
+{
+	unsigned int val;
+
+	if (!len || !is_digit(str[0]))
+		return 0;
+
+	val = str[0] - '0';
+
+	if (len < 2 || !is_digit(str[1])) {
+		*color = val;
+		return 1;
+	}
+
+	val = 10 * val + str[1] - '0';
+	*color = val == 99 ? GPIRC_FMT_COLOR_DEFAULT : val;
+
+	return 2;
+}
+
+/*
+ * Parses the fg[,bg] after the color code, no color resets both.
+ */
+static size_t parse_colors(const char *str, size_t len, struct style *style)
+{
+	size_t ret, bg_len;
+
+	ret = parse_color(str, len, &style->fg);
+	if (!ret) {
+		style->fg = GPIRC_FMT_COLOR_DEFAULT;
+		style->bg = GPIRC_FMT_COLOR_DEFAULT;
+		return 0;
+	}
+
+	/* A comma not followed by a color is part of the text */
+	if (ret < len && str[ret] == ',') {
+		bg_len = parse_color(str + ret + 1, len - ret - 1, &style->bg);
+		if (bg_len)
+			ret += bg_len + 1;
+	}
+
+	return ret;
+}
+
+/*
+ * RGB colors are skipped, there is no palette entry to map them to.
+ */
+static size_t skip_hex_colors(const char *str, size_t len)
+{
+	size_t i = 0, j;
+
+	for (j = 0; j < 6 && i < len && is_hex(str[i]); j++)
+		i++;
+
+	if (!i || i + 1 >= len || str[i] != ',' || !is_hex(str[i+1]))
+		return i;
+
+	i++;
+
+	for (j = 0; j < 6 && i < len && is_hex(str[i]); j++)
+		i++;
+
+	return i;
+}
+
+static void span_add(struct gpirc_fmt_span *spans, size_t *cnt,
+                     size_t start, size_t end, struct style style)
+{
+	if (!spans || end <= start || style_eq(style, style_default))
+		return;
+
+	if (*cnt >= GPIRC_FMT_SPANS_MAX || end > UINT16_MAX)
+		return;
+
+	spans[(*cnt)++] = (struct gpirc_fmt_span) {
+		.off = start,
+		.len = end - start,
+		.flags = style.flags,
+		.fg = style.fg,
+		.bg = style.bg,
+	};
+}
+
+size_t gpirc_fmt_parse(const char *str, size_t len, char *out,
+                       struct gpirc_fmt_span *spans, size_t *spans_cnt)
+{
+	struct style cur = style_default;
+	size_t i = 0, o = 0, run = 0;
+
+	*spans_cnt = 0;
+
+	while (i < len) {
+		unsigned char c = str[i];
+		struct style next = cur;
+
+		if (!is_code(c)) {
+			out[o++] = str[i++];
+			continue;
+		}
+
+		i++;
+
+		switch (c) {
+		case CODE_BOLD:
+			next.flags ^= GPIRC_FMT_BOLD;
+		break;
+		case CODE_ITALIC:
+			next.flags ^= GPIRC_FMT_ITALIC;
+		break;
+		case CODE_UNDERLINE:
+			next.flags ^= GPIRC_FMT_UNDERLINE;
+		break;
+		case CODE_STRIKE:
+			next.flags ^= GPIRC_FMT_STRIKE;
+		break;
+		case CODE_MONO:
+			next.flags ^= GPIRC_FMT_MONO;
+		break;
+		case CODE_REVERSE:
+			next.flags ^= GPIRC_FMT_REVERSE;
+		break;
+		case CODE_COLOR:
+			i += parse_colors(str + i, len - i, &next);
+		break;
+		case CODE_HEX_COLOR:
+			i += skip_hex_colors(str + i, len - i);
+			next.fg = GPIRC_FMT_COLOR_DEFAULT;
+			next.bg = GPIRC_FMT_COLOR_DEFAULT;
+		break;
+		case CODE_RESET:
+			next = style_default;
+		break;
+		}
+
+		if (style_eq(cur, next))
+			continue;
+
+		span_add(spans, spans_cnt, run, o, cur);
+		run = o;
+		cur = next;
+	}
+
+	span_add(spans, spans_cnt, run, o, cur);
+
+	return o;
+}
@@ -0,0 +1,71 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * mIRC formatting codes.
+ *
+ * A message is scanned once when it's received. The control codes are
+ * stripped from the text and the style is recorded as a list of spans. Most
+ * of the messages have no formatting at all, these are detected by checking
+ * a word at a time for control bytes and are stored as they are.
+ */
+
+#ifndef GPIRC_FMT_H__
+#define GPIRC_FMT_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum gpirc_fmt_flags {
+	GPIRC_FMT_BOLD = 0x01,
+	GPIRC_FMT_ITALIC = 0x02,
+	GPIRC_FMT_UNDERLINE = 0x04,
+	GPIRC_FMT_STRIKE = 0x08,
+	GPIRC_FMT_MONO = 0x10,
+	GPIRC_FMT_REVERSE = 0x20,
+};
+
+/* Colors are the mIRC palette indexes 0 to 98 */
+#define GPIRC_FMT_COLOR_DEFAULT 0xff
+
+/* Runs past the limit are stripped but not recorded */
+#define GPIRC_FMT_SPANS_MAX 32
+
+/*
+ * A run of text with non-default style.
+ */
+struct gpirc_fmt_span {
+	/* Offset and length in the stripped text */
+	uint16_t off;
+	uint16_t len;
+	uint8_t flags;
+	uint8_t fg;
+	uint8_t bg;
+};
+
+/*
+ * Returns non-zero if there are no formatting codes in the string.
+ */
+int gpirc_fmt_plain(const char *str, size_t len);
+
+/*
+ * Strips the formatting codes and records the style spans.
+ *
+ * @str A message text.
+ * @len A message length.
+ * @out A buffer for the stripped text, at least len bytes, may be the same as
+ *      str. The text is not null terminated.
+ * @spans An array of GPIRC_FMT_SPANS_MAX spans or NULL to strip the codes only.
+ * @spans_cnt Set to the number of spans stored.
+ *
+ * @return Length of the stripped text.
+ */
+size_t gpirc_fmt_parse(const char *str, size_t len, char *out,
+                       struct gpirc_fmt_span *spans, size_t *spans_cnt);
+
+#endif /* GPIRC_FMT_H__ */
@@ -0,0 +1,358 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gpirc_hist.h"
+
+/* Maximal number of files mapped at a time */
+#define HIST_MAPS 4
+
+static void file_unmap(struct gpirc_hist_file *file)
+{
+	if (!file->log)
+		return;
+
+	munmap((void *)file->log, file->log_size);
+	munmap((void *)file->idx, file->lines * sizeof(*file->idx));
+
+	file->log = NULL;
+	file->idx = NULL;
+}
+
+static void *map_fd(const char *path, size_t *size)
+{
+	struct stat st;
+	void *ret;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) || !st.st_size || (*size && (size_t)st.st_size < *size)) {
+		close(fd);
+		return NULL;
+	}
+
+	if (!*size)
+		*size = st.st_size;
+
+	ret = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	return ret == MAP_FAILED ? NULL : ret;
+}
+
+static int file_map(struct gpirc_hist *self, struct gpirc_hist_file *file)
+{
+	struct gpirc_hist_file *lru = NULL;
+	size_t i, mapped = 0, size;
+	char path[4096];
+	void *log, *idx;
+
+	file->used = ++self->use_cnt;
+
+	if (file->log)
+		return 0;
+
+	for (i = 0; i < self->files_cnt; i++) {
+		struct gpirc_hist_file *f = &self->files[i];
+
+		if (!f->log)
+			continue;
+
+		mapped++;
+
+		if (!lru || f->used < lru->used)
+			lru = f;
+	}
+
+	if (mapped >= HIST_MAPS)
+		file_unmap(lru);
+
+	snprintf(path, sizeof(path), "%s/%s.log", self->dir, file->name);
+
+	size = 0;
+	log = map_fd(path, &size);
+	if (!log)
+		return 1;
+
+	file->log_size = size;
+
+	snprintf(path, sizeof(path), "%s/%s.idx", self->dir, file->name);
+
+	size = file->lines * sizeof(*file->idx);
+	idx = map_fd(path, &size);
+	if (!idx) {
+		munmap(log, file->log_size);
+		return 1;
+	}
+
+	file->log = log;
+	file->idx = idx;
+
+	return 0;
+}
+
+static int parse_name(const char *name, struct gpirc_hist_file *file)
+{
+	struct tm tm = {.tm_isdst = -1};
+	int len = 0;
+
+	if (sscanf(name, "%4d-%2d-%2d.idx%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &len) != 3)
+		return 1;
+
+	if (len != 14 || name[len])
+		return 1;
+
+	tm.tm_year -= 1900;
+	tm.tm_mon--;
+
+	memset(file, 0, sizeof(*file));
+	memcpy(file->name, name, 10);
+	file->day_start = mktime(&tm);
+
+	return 0;
+}
+
+static int file_cmp(const void *a, const void *b)
+{
+	const struct gpirc_hist_file *fa = a, *fb = b;
+
+	return strcmp(fa->name, fb->name);
+}
+
+static size_t file_lines(struct gpirc_hist *self, struct gpirc_hist_file *file)
+{
+	char path[4096];
+	struct stat st;
+
+	snprintf(path, sizeof(path), "%s/%s.idx", self->dir, file->name);
+
+	if (stat(path, &st))
+		return 0;
+
+	return st.st_size / sizeof(struct gpirc_log_idx);
+}
+
+static void files_free(struct gpirc_hist *self)
+{
+	size_t i;
+
+	for (i = 0; i < self->files_cnt; i++)
+		file_unmap(&self->files[i]);
+
+	free(self->files);
+	self->files = NULL;
+	self->files_cnt = 0;
+	self->lines = 0;
+}
+
+/*
+ * Only the last file is appended to and new files sort after the old ones so
+ * the mappings of older files are kept.
+ */
+int gpirc_hist_refresh(struct gpirc_hist *self)
+{
+	struct gpirc_hist_file *files = NULL, file;
+	size_t i, cnt = 0, lines;
+	struct dirent *ent;
+	DIR *dir;
+
+	dir = opendir(self->dir);
+	if (!dir) {
+		files_free(self);
+		return errno != ENOENT;
+	}
+
+	while ((ent = readdir(dir))) {
+		if (parse_name(ent->d_name, &file))
+			continue;
+
+		if (!(cnt % 64)) {
+			void *tmp = realloc(files, (cnt + 64) * sizeof(*files));
+
+			if (!tmp) {
+				free(files);
+				closedir(dir);
+				return 1;
+			}
+
+			files = tmp;
+		}
+
+		files[cnt++] = file;
+	}
+
+	closedir(dir);
+
+	qsort(files, cnt, sizeof(*files), file_cmp);
+
+	for (i = 0; i < self->files_cnt; i++) {
+		if (i >= cnt || strcmp(files[i].name, self->files[i].name))
+			break;
+	}
+
+	/* Something was removed, start from scratch */
+	if (i < self->files_cnt)
+		files_free(self);
+
+	for (i = 0; i < self->files_cnt; i++)
+		files[i] = self->files[i];
+
+	free(self->files);
+	self->files = files;
+	self->files_cnt = cnt;
+	self->lines = 0;
+
+	for (i = 0; i < cnt; i++) {
+		struct gpirc_hist_file *f = &files[i];
+
+		/* Only the index for the current day grows */
+		if (!f->lines || i + 1 == cnt) {
+			lines = file_lines(self, f);
+
+			if (lines != f->lines) {
+				file_unmap(f);
+				f->lines = lines;
+			}
+		}
+
+		f->first = self->lines;
+		self->lines += f->lines;
+	}
+
+	return 0;
+}
+
+int gpirc_hist_open(struct gpirc_hist *self, const char *dir)
+{
+	memset(self, 0, sizeof(*self));
+
+	self->dir = strdup(dir);
+	if (!self->dir)
+		return 1;
+
+	if (gpirc_hist_refresh(self)) {
+		gpirc_hist_close(self);
+		return 1;
+	}
+
+	return 0;
+}
+
+void gpirc_hist_close(struct gpirc_hist *self)
+{
+	files_free(self);
+	free(self->dir);
+	self->dir = NULL;
+}
+
+static struct gpirc_hist_file *file_by_line(struct gpirc_hist *self, size_t nr)
+{
+	size_t l = 0, r = self->files_cnt;
+
+	while (r - l > 1) {
+		size_t mid = (l + r) / 2;
+
+		if (self->files[mid].first <= nr)
+			l = mid;
+		else
+			r = mid;
+	}
+
+	/* Skip files with no lines */
+	while (!self->files[l].lines)
+		l++;
+
+	return &self->files[l];
+}
+
+int gpirc_hist_line(struct gpirc_hist *self, size_t nr, struct gpirc_hist_line *line)
+{
+	struct gpirc_hist_file *file;
+	size_t i, off, end;
+
+	if (nr >= self->lines)
+		return 1;
+
+	file = file_by_line(self, nr);
+
+	if (file_map(self, file))
+		return 1;
+
+	i = nr - file->first;
+	off = file->idx[i].off;
+
+	if (off >= file->log_size)
+		return 1;
+
+	if (i + 1 < file->lines && file->idx[i+1].off <= file->log_size) {
+		end = file->idx[i+1].off;
+	} else {
+		const char *nl = memchr(file->log + off, '\n', file->log_size - off);
+
+		end = nl ? (size_t)(nl - file->log) + 1 : file->log_size;
+	}
+
+	if (end > off && file->log[end - 1] == '\n')
+		end--;
+
+	line->str = file->log + off;
+	line->len = end > off ? end - off : 0;
+	line->time = file->idx[i].time;
+	line->day_first = !i;
+
+	return 0;
+}
+
+size_t gpirc_hist_find(struct gpirc_hist *self, time_t time)
+{
+	struct gpirc_hist_file *file;
+	size_t l = 0, r = self->files_cnt;
+
+	if (!self->lines || time < self->files[0].day_start)
+		return 0;
+
+	while (r - l > 1) {
+		size_t mid = (l + r) / 2;
+
+		if (self->files[mid].day_start <= time)
+			l = mid;
+		else
+			r = mid;
+	}
+
+	file = &self->files[l];
+
+	if (!file->lines || file_map(self, file))
+		return file->first + file->lines;
+
+	l = 0;
+	r = file->lines;
+
+	while (l < r) {
+		size_t mid = (l + r) / 2;
+
+		if ((time_t)file->idx[mid].time < time)
+			l = mid + 1;
+		else
+			r = mid;
+	}
+
+	return file->first + l;
+}
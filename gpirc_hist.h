@@ -0,0 +1,95 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * Read only access to the on disk channel logs.
+ *
+ * Lines are numbered across all daily files of a channel, a line is looked up
+ * by a binary search over the files and an O(1) lookup into the file .idx
+ * sidecar. Both the log and the index are mmapped on demand, only a few files
+ * are kept mapped at a time, so jumping anywhere in years of logs touches only
+ * the pages that are actually shown.
+ */
+
+#ifndef GPIRC_HIST_H__
+#define GPIRC_HIST_H__
+
+#include <stddef.h>
+#include <time.h>
+#include "gpirc_log.h"
+
+struct gpirc_hist_file {
+	/* Local midnight the file starts at */
+	time_t day_start;
+	/* Number of indexed lines and the number of the first one */
+	size_t lines;
+	size_t first;
+
+	/* Mappings, NULL when not mapped */
+	const char *log;
+	size_t log_size;
+	const struct gpirc_log_idx *idx;
+	unsigned long used;
+
+	char name[16];
+};
+
+struct gpirc_hist {
+	char *dir;
+	struct gpirc_hist_file *files;
+	size_t files_cnt;
+	size_t lines;
+	unsigned long use_cnt;
+};
+
+struct gpirc_hist_line {
+	const char *str;
+	size_t len;
+	time_t time;
+	/* Set for the first line of a day */
+	int day_first;
+};
+
+/*
+ * Opens the history of a channel.
+ *
+ * @dir A channel log directory as returned by gpirc_log_dir().
+ *
+ * @return Zero on success, non-zero on allocation failure. A directory that
+ *         does not exist yet is an empty history.
+ */
+int gpirc_hist_open(struct gpirc_hist *self, const char *dir);
+
+void gpirc_hist_close(struct gpirc_hist *self);
+
+/*
+ * Picks up lines that were written since the last refresh.
+ *
+ * @return Zero on success.
+ */
+int gpirc_hist_refresh(struct gpirc_hist *self);
+
+static inline size_t gpirc_hist_lines(struct gpirc_hist *self)
+{
+	return self->lines;
+}
+
+/*
+ * Looks up a line, the string points into a mapping and is valid until the
+ * next call. It's not terminated and does not include the newline.
+ *
+ * @return Zero on success, non-zero if nr is out of range or on I/O failure.
+ */
+int gpirc_hist_line(struct gpirc_hist *self, size_t nr, struct gpirc_hist_line *line);
+
+/*
+ * Returns number of the first line logged at or after time.
+ */
+size_t gpirc_hist_find(struct gpirc_hist *self, time_t time);
+
+#endif /* GPIRC_HIST_H__ */
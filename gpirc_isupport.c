@@ -0,0 +1,69 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gpirc_isupport.h"
+
+void gpirc_isupport_init(struct gpirc_isupport *self)
+{
+	self->join_targets = 0;
+	self->line_len = GPIRC_LINE_LEN;
+}
+
+/*
+ * TARGMAX=NAMES:1,LIST:1,KICK:1,WHOIS:1,PRIVMSG:4,NOTICE:4,JOIN:
+ *
+ * A command with an empty value has no limit.
+ */
+static void parse_targmax(struct gpirc_isupport *self, const char *val)
+{
+	while (val && *val) {
+		if (!strncmp(val, "JOIN:", 5)) {
+			self->join_targets = strtoul(val + 5, NULL, 10);
+			return;
+		}
+
+		val = strchr(val, ',');
+		if (val)
+			val++;
+	}
+}
+
+static void parse_token(struct gpirc_isupport *self, const char *tok)
+{
+	if (!strcmp(tok, "-TARGMAX")) {
+		self->join_targets = 0;
+		return;
+	}
+
+	if (!strncmp(tok, "TARGMAX=", 8)) {
+		parse_targmax(self, tok + 8);
+		return;
+	}
+
+	if (!strncmp(tok, "LINELEN=", 8)) {
+		unsigned long len = strtoul(tok + 8, NULL, 10);
+
+		/* Longer lines work only with the IRCv3 extensions we don't do */
+		if (len >= 64 && len <= GPIRC_LINE_LEN)
+			self->line_len = len;
+
+		return;
+	}
+}
+
+void gpirc_isupport_parse(struct gpirc_isupport *self, const char **params,
+                          unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 1; i + 1 < count; i++)
+		parse_token(self, params[i]);
+}
@@ -0,0 +1,38 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * Server limits and features advertised in RPL_ISUPPORT (005).
+ */
+
+#ifndef GPIRC_ISUPPORT_H__
+#define GPIRC_ISUPPORT_H__
+
+/* RFC1459 line length including the CRLF */
+#define GPIRC_LINE_LEN 512
+
+struct gpirc_isupport {
+	/* Maximal number of channels in a single JOIN, 0 for no limit */
+	unsigned int join_targets;
+	/* Maximal length of a line we send including the CRLF */
+	unsigned int line_len;
+};
+
+/*
+ * Resets to the defaults that are used until the server says otherwise.
+ */
+void gpirc_isupport_init(struct gpirc_isupport *self);
+
+/*
+ * Parses RPL_ISUPPORT parameters, the first one is our nick and the last one
+ * the "are supported by this server" text.
+ */
+void gpirc_isupport_parse(struct gpirc_isupport *self, const char **params,
+                          unsigned int count);
+
+#endif /* GPIRC_ISUPPORT_H__ */
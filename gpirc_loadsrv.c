@@ -0,0 +1,880 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * Loopback IRC server stand-in for load testing.
+ *
+ * Accepts clients on localhost, registers them and lets them join any
+ * channel. All simulated users are members of every channel, the channels a
+ * client joined are flooded with messages from random users, users change
+ * nicks and every once in a while a part of them is lost in a netsplit and
+ * rejoins a few seconds later.
+ *
+ * The client lag is measured by PING round trips. Generating traffic for a
+ * client is paused while it has more than BACKLOG_PAUSE bytes unread, the
+ * backlog is printed along with the lag each second.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "gpirc_time.h"
+
+#define SRV_NAME "load.gpirc"
+#define SPLIT_NAME "split.gpirc"
+
+#define CLIENTS_MAX 16
+#define TICK_MS 10
+/* Generation is paused while the client has this much unread data */
+#define BACKLOG_PAUSE (1024 * 1024)
+/* Client is dropped when it has this much unread data */
+#define BACKLOG_MAX (64 * 1024 * 1024)
+/* Split users rejoin after */
+#define SPLIT_HEAL_MS 5000
+/* Maximal length of the nick list in a NAMES reply line */
+#define NAMES_LEN 400
+
+static struct opts {
+	int port;
+	unsigned int users;
+	unsigned int msg_rate;
+	unsigned int nick_rate;
+	unsigned int split_period;
+	unsigned int split_pct;
+	unsigned int ping_ms;
+	unsigned int duration;
+} opts = {
+	.port = 6667,
+	.users = 2000,
+	.msg_rate = 1000,
+	.nick_rate = 10,
+	.split_period = 30,
+	.split_pct = 25,
+	.ping_ms = 1000,
+};
+
+struct user {
+	char nick[32];
+	unsigned int renames;
+	int split;
+};
+
+static struct user *users;
+
+struct client {
+	int fd;
+	int registered;
+	char nick[64];
+	int has_user;
+
+	char in[4096];
+	size_t in_len;
+
+	char *out;
+	size_t out_off;
+	size_t out_len;
+	size_t out_size;
+
+	char **chans;
+	size_t chans_cnt;
+
+	uint64_t ping_ns;
+	uint64_t ping_token;
+
+	/* Per second stats */
+	uint64_t lines;
+	uint64_t bytes;
+	uint64_t lag_min;
+	uint64_t lag_max;
+	uint64_t lag_sum;
+	unsigned int lag_cnt;
+};
+
+static struct client clients[CLIENTS_MAX];
+static unsigned int clients_cnt;
+
+static volatile sig_atomic_t quit;
+
+static const char *words[] = {
+	"hello", "world", "gfxprim", "widgets", "irc", "client", "load", "test",
+	"the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "lorem",
+	"ipsum", "dolor", "sit", "amet", "kernel", "patch", "review", "build",
+	"merge", "commit", "branch", "latency", "throughput", "ping", "lag",
+};
+
+static void client_close(struct client *self, const char *reason)
+{
+	size_t i;
+
+	fprintf(stderr, "Client %s closed: %s\n", self->nick[0] ? self->nick : "(unregistered)", reason);
+
+	close(self->fd);
+
+	for (i = 0; i < self->chans_cnt; i++)
+		free(self->chans[i]);
+
+	free(self->chans);
+	free(self->out);
+
+	*self = clients[--clients_cnt];
+	memset(&clients[clients_cnt], 0, sizeof(*self));
+}
+
+static int client_vprintf(struct client *self, const char *fmt, va_list va)
+{
+	va_list va2;
+	int len;
+
+	va_copy(va2, va);
+	len = vsnprintf(NULL, 0, fmt, va2);
+	va_end(va2);
+
+	if (len < 0)
+		return 1;
+
+	if (self->out_len + len + 3 > self->out_size) {
+		size_t size = self->out_size ? self->out_size : 64 * 1024;
+		char *out;
+
+		/* Drop the data that were already written */
+		if (self->out_off) {
+			memmove(self->out, self->out + self->out_off, self->out_len - self->out_off);
+			self->out_len -= self->out_off;
+			self->out_off = 0;
+		}
+
+		while (size < self->out_len + len + 3)
+			size *= 2;
+
+		if (size > BACKLOG_MAX)
+			return 1;
+
+		out = realloc(self->out, size);
+		if (!out)
+			return 1;
+
+		self->out = out;
+		self->out_size = size;
+	}
+
+	vsnprintf(self->out + self->out_len, len + 1, fmt, va);
+	self->out_len += len;
+	self->out[self->out_len++] = '\r';
+	self->out[self->out_len++] = '\n';
+
+	self->lines++;
+	self->bytes += len + 2;
+
+	return 0;
+}
+
+static void client_printf(struct client *self, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+static void client_printf(struct client *self, const char *fmt, ...)
+{
+	va_list va;
+
+	va_start(va, fmt);
+	client_vprintf(self, fmt, va);
+	va_end(va);
+}
+
+static size_t client_backlog(struct client *self)
+{
+	return self->out_len - self->out_off;
+}
+
+static int client_flush(struct client *self)
+{
+	while (self->out_off < self->out_len) {
+		ssize_t ret = write(self->fd, self->out + self->out_off, self->out_len - self->out_off);
+
+		if (ret < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+
+			if (errno == EINTR)
+				continue;
+
+			return 1;
+		}
+
+		self->out_off += ret;
+	}
+
+	self->out_off = self->out_len = 0;
+
+	return 0;
+}
+
+static void user_nick_gen(unsigned int i)
+{
+	struct user *user = &users[i];
+
+	if (user->renames)
+		snprintf(user->nick, sizeof(user->nick), "u%u_%u", i, user->renames);
+	else
+		snprintf(user->nick, sizeof(user->nick), "u%u", i);
+}
+
+static const char *user_prefix(unsigned int i)
+{
+	static char buf[128];
+
+	snprintf(buf, sizeof(buf), "%s!user%u@host%u.load.gpirc", users[i].nick, i, i % 256);
+
+	return buf;
+}
+
+static void send_numeric(struct client *self, unsigned int numeric, const char *fmt, ...)
+	__attribute__((format(printf, 3, 4)));
+
+static void send_numeric(struct client *self, unsigned int numeric, const char *fmt, ...)
+{
+	char buf[1024];
+	va_list va;
+
+	va_start(va, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, va);
+	va_end(va);
+
+	client_printf(self, ":" SRV_NAME " %03u %s %s", numeric, self->nick, buf);
+}
+
+static void client_register(struct client *self)
+{
+	send_numeric(self, 1, ":Welcome to the gpirc load test server %s", self->nick);
+	send_numeric(self, 2, ":Your host is " SRV_NAME);
+	send_numeric(self, 3, ":This server was created just now");
+	send_numeric(self, 4, SRV_NAME " gpirc-loadsrv io ovb");
+	send_numeric(self, 5, "CHANTYPES=# PREFIX=(ov)@+ NICKLEN=30 TARGMAX=JOIN:10 :are supported by this server");
+	send_numeric(self, 375, ":- " SRV_NAME " Message of the day -");
+	send_numeric(self, 372, ":- %u users, %u messages/s, %u nick changes/s",
+	             opts.users, opts.msg_rate, opts.nick_rate);
+	send_numeric(self, 376, ":End of /MOTD command.");
+
+	self->registered = 1;
+}
+
+static int client_in_chan(struct client *self, const char *chan)
+{
+	size_t i;
+
+	for (i = 0; i < self->chans_cnt; i++) {
+		if (!strcmp(self->chans[i], chan))
+			return i;
+	}
+
+	return -1;
+}
+
+static void send_names(struct client *self, const char *chan)
+{
+	char buf[NAMES_LEN + 64];
+	size_t len = 0;
+	unsigned int i;
+
+	len = snprintf(buf, sizeof(buf), "%s", self->nick);
+
+	for (i = 0; i < opts.users; i++) {
+		const char *prefix = !(i % 50) ? "@" : (!(i % 10) ? "+" : "");
+
+		if (users[i].split)
+			continue;
+
+		if (len > NAMES_LEN) {
+			send_numeric(self, 353, "= %s :%s", chan, buf);
+			len = 0;
+		}
+
+		len += snprintf(buf + len, sizeof(buf) - len, "%s%s%s",
+		                len ? " " : "", prefix, users[i].nick);
+	}
+
+	if (len)
+		send_numeric(self, 353, "= %s :%s", chan, buf);
+
+	send_numeric(self, 366, "%s :End of /NAMES list.", chan);
+}
+
+static void client_join(struct client *self, const char *chan)
+{
+	char **chans;
+
+	if (chan[0] != '#' || client_in_chan(self, chan) >= 0)
+		return;
+
+	chans = realloc(self->chans, (self->chans_cnt + 1) * sizeof(*chans));
+	if (!chans)
+		return;
+
+	self->chans = chans;
+	self->chans[self->chans_cnt] = strdup(chan);
+	if (!self->chans[self->chans_cnt])
+		return;
+
+	self->chans_cnt++;
+
+	client_printf(self, ":%s!gpirc@localhost JOIN %s", self->nick, chan);
+	send_numeric(self, 332, "%s :Load test channel, %u users", chan, opts.users);
+	send_names(self, chan);
+}
+
+static void client_part(struct client *self, const char *chan)
+{
+	int i = client_in_chan(self, chan);
+
+	if (i < 0)
+		return;
+
+	client_printf(self, ":%s!gpirc@localhost PART %s", self->nick, chan);
+
+	free(self->chans[i]);
+	self->chans[i] = self->chans[--self->chans_cnt];
+}
+
+static void client_pong(struct client *self, const char *token)
+{
+	uint64_t lag;
+
+	if (!self->ping_ns || strtoull(token, NULL, 10) != self->ping_token)
+		return;
+
+	lag = gpirc_monotonic_ns() - self->ping_ns;
+	self->ping_ns = 0;
+
+	if (!self->lag_cnt || lag < self->lag_min)
+		self->lag_min = lag;
+
+	if (lag > self->lag_max)
+		self->lag_max = lag;
+
+	self->lag_sum += lag;
+	self->lag_cnt++;
+}
+
+/*
+ * Splits the line into the command and parameters in place.
+ */
+static unsigned int parse_line(char *line, char **cmd, char **params, unsigned int max)
+{
+	unsigned int cnt = 0;
+
+	*cmd = "";
+
+	/* Clients do not send prefixes but skip one anyway */
+	if (*line == ':') {
+		line = strchr(line, ' ');
+		if (!line)
+			return 0;
+	}
+
+	while (*line == ' ')
+		line++;
+
+	*cmd = line;
+	line += strcspn(line, " ");
+
+	while (*line && cnt < max) {
+		*line++ = 0;
+
+		while (*line == ' ')
+			line++;
+
+		if (!*line)
+			break;
+
+		if (*line == ':') {
+			params[cnt++] = line + 1;
+			break;
+		}
+
+		params[cnt++] = line;
+		line += strcspn(line, " ");
+	}
+
+	return cnt;
+}
+
+static void client_line(struct client *self, char *line)
+{
+	char *cmd, *params[16], *chan, *save;
+	unsigned int cnt = parse_line(line, &cmd, params, 16);
+
+	if (!strcmp(cmd, "NICK") && cnt >= 1) {
+		if (self->registered)
+			client_printf(self, ":%s!gpirc@localhost NICK :%s", self->nick, params[0]);
+
+		snprintf(self->nick, sizeof(self->nick), "%s", params[0]);
+
+		if (!self->registered && self->has_user)
+			client_register(self);
+
+		return;
+	}
+
+	if (!strcmp(cmd, "USER")) {
+		self->has_user = 1;
+
+		if (!self->registered && self->nick[0])
+			client_register(self);
+
+		return;
+	}
+
+	if (!strcmp(cmd, "CAP") && cnt >= 1 && !strcmp(params[0], "LS")) {
+		client_printf(self, ":" SRV_NAME " CAP * LS :");
+		return;
+	}
+
+	if (!strcmp(cmd, "PING")) {
+		client_printf(self, ":" SRV_NAME " PONG " SRV_NAME " :%s", cnt ? params[0] : "");
+		return;
+	}
+
+	if (!strcmp(cmd, "PONG") && cnt >= 1) {
+		client_pong(self, params[cnt - 1]);
+		return;
+	}
+
+	if (!strcmp(cmd, "QUIT")) {
+		client_printf(self, "ERROR :Closing link");
+		return;
+	}
+
+	if (!self->registered)
+		return;
+
+	if (!strcmp(cmd, "JOIN") && cnt >= 1) {
+		for (chan = strtok_r(params[0], ",", &save); chan; chan = strtok_r(NULL, ",", &save))
+			client_join(self, chan);
+		return;
+	}
+
+	if (!strcmp(cmd, "PART") && cnt >= 1) {
+		for (chan = strtok_r(params[0], ",", &save); chan; chan = strtok_r(NULL, ",", &save))
+			client_part(self, chan);
+		return;
+	}
+}
+
+/*
+ * Returns non-zero if the client should be closed.
+ */
+static int client_read(struct client *self)
+{
+	ssize_t ret;
+	char *nl, *start;
+
+	ret = read(self->fd, self->in + self->in_len, sizeof(self->in) - self->in_len - 1);
+	if (ret <= 0)
+		return ret == 0 || (errno != EAGAIN && errno != EINTR);
+
+	self->in_len += ret;
+	self->in[self->in_len] = 0;
+
+	start = self->in;
+
+	while ((nl = strchr(start, '\n'))) {
+		*nl = 0;
+
+		if (nl > start && nl[-1] == '\r')
+			nl[-1] = 0;
+
+		client_line(self, start);
+		start = nl + 1;
+	}
+
+	self->in_len -= start - self->in;
+	memmove(self->in, start, self->in_len);
+
+	/* Line too long, drop it */
+	if (self->in_len >= sizeof(self->in) - 1)
+		self->in_len = 0;
+
+	return 0;
+}
+
+static unsigned int rand_user(void)
+{
+	unsigned int i, user = 0;
+
+	for (i = 0; i < 16; i++) {
+		user = random() % opts.users;
+
+		if (!users[user].split)
+			break;
+	}
+
+	return user;
+}
+
+static int client_ready(struct client *self)
+{
+	return self->registered && client_backlog(self) < BACKLOG_PAUSE;
+}
+
+static void gen_msg(void)
+{
+	unsigned int i, user = rand_user(), words_cnt = 1 + random() % 24;
+	char text[512];
+	size_t len = 0;
+
+	for (i = 0; i < words_cnt; i++) {
+		len += snprintf(text + len, sizeof(text) - len, "%s%s", i ? " " : "",
+		                words[random() % (sizeof(words)/sizeof(*words))]);
+	}
+
+	for (i = 0; i < clients_cnt; i++) {
+		struct client *client = &clients[i];
+
+		if (!client_ready(client) || !client->chans_cnt)
+			continue;
+
+		client_printf(client, ":%s PRIVMSG %s :%s", user_prefix(user),
+		              client->chans[random() % client->chans_cnt], text);
+	}
+}
+
+static void gen_nick(void)
+{
+	unsigned int i, user = rand_user();
+	char old[128];
+
+	if (users[user].split)
+		return;
+
+	snprintf(old, sizeof(old), "%s", user_prefix(user));
+
+	users[user].renames++;
+	user_nick_gen(user);
+
+	for (i = 0; i < clients_cnt; i++) {
+		if (client_ready(&clients[i]) && clients[i].chans_cnt)
+			client_printf(&clients[i], ":%s NICK :%s", old, users[user].nick);
+	}
+}
+
+static void gen_split(int heal)
+{
+	unsigned int i, j, u, cnt = 0;
+
+	for (u = 0; u < opts.users; u++) {
+		if (heal != users[u].split)
+			continue;
+
+		if (!heal && (unsigned int)(random() % 100) >= opts.split_pct)
+			continue;
+
+		users[u].split = !heal;
+		cnt++;
+
+		for (i = 0; i < clients_cnt; i++) {
+			struct client *client = &clients[i];
+
+			if (!client->registered || !client->chans_cnt)
+				continue;
+
+			if (!heal) {
+				client_printf(client, ":%s QUIT :" SRV_NAME " " SPLIT_NAME, user_prefix(u));
+				continue;
+			}
+
+			for (j = 0; j < client->chans_cnt; j++)
+				client_printf(client, ":%s JOIN %s", user_prefix(u), client->chans[j]);
+		}
+	}
+
+	fprintf(stderr, "Netsplit %s, %u users\n", heal ? "healed" : "started", cnt);
+}
+
+static void send_pings(uint64_t now)
+{
+	static uint64_t token;
+	unsigned int i;
+
+	for (i = 0; i < clients_cnt; i++) {
+		struct client *client = &clients[i];
+
+		/* Previous ping is still pending */
+		if (!client->registered || client->ping_ns)
+			continue;
+
+		client->ping_ns = now;
+		client->ping_token = ++token;
+		client_printf(client, "PING :%llu", (unsigned long long)token);
+	}
+}
+
+static void print_stats(double secs)
+{
+	unsigned int i;
+
+	for (i = 0; i < clients_cnt; i++) {
+		struct client *client = &clients[i];
+		uint64_t pending = client->ping_ns ? gpirc_monotonic_ns() - client->ping_ns : 0;
+
+		printf("%s: %.0f lines/s %.0fKB/s, backlog %zuKB, ",
+		       client->nick[0] ? client->nick : "(unregistered)",
+		       client->lines / secs, client->bytes / secs / 1024,
+		       client_backlog(client) / 1024);
+
+		if (client->lag_cnt) {
+			printf("lag min %.2fms avg %.2fms max %.2fms",
+			       client->lag_min / 1e6, client->lag_sum / 1e6 / client->lag_cnt,
+			       client->lag_max / 1e6);
+		} else {
+			printf("no PONG");
+		}
+
+		if (pending > 1000000000)
+			printf(", PING pending for %.1fs", pending / 1e9);
+
+		printf("\n");
+
+		client->lines = client->bytes = 0;
+		client->lag_min = client->lag_max = client->lag_sum = 0;
+		client->lag_cnt = 0;
+	}
+
+	fflush(stdout);
+}
+
+static int listen_fd_new(void)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(opts.port),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	int fd, one = 1;
+
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 16)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void client_accept(int listen_fd)
+{
+	int fd = accept(listen_fd, NULL, NULL);
+
+	if (fd < 0)
+		return;
+
+	if (fcntl(fd, F_SETFL, O_NONBLOCK)) {
+		close(fd);
+		return;
+	}
+
+	if (clients_cnt >= CLIENTS_MAX) {
+		close(fd);
+		return;
+	}
+
+	memset(&clients[clients_cnt], 0, sizeof(struct client));
+	clients[clients_cnt++].fd = fd;
+
+	fprintf(stderr, "Client connected\n");
+}
+
+static void sig_quit(int sig)
+{
+	(void) sig;
+	quit = 1;
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [opts]\n\n", name);
+	printf(" -p port     listen on localhost port (%i)\n", opts.port);
+	printf(" -u users    number of simulated users (%u)\n", opts.users);
+	printf(" -m rate     messages per second (%u)\n", opts.msg_rate);
+	printf(" -n rate     nick changes per second (%u)\n", opts.nick_rate);
+	printf(" -s secs     netsplit period, 0 disables netsplits (%u)\n", opts.split_period);
+	printf(" -S pct      percentage of users lost in a netsplit (%u)\n", opts.split_pct);
+	printf(" -P ms       PING period (%u)\n", opts.ping_ms);
+	printf(" -t secs     exit after secs, 0 runs until interrupted (%u)\n", opts.duration);
+}
+
+int main(int argc, char *argv[])
+{
+	struct pollfd fds[CLIENTS_MAX + 1];
+	uint64_t now, start, last, last_stats, last_ping, split_at, heal_at = 0;
+	double msg_credit = 0, nick_credit = 0;
+	unsigned int i;
+	int opt, listen_fd;
+
+	while ((opt = getopt(argc, argv, "hp:u:m:n:s:S:P:t:")) != -1) {
+		switch (opt) {
+		case 'p':
+			opts.port = atoi(optarg);
+		break;
+		case 'u':
+			opts.users = atoi(optarg);
+		break;
+		case 'm':
+			opts.msg_rate = atoi(optarg);
+		break;
+		case 'n':
+			opts.nick_rate = atoi(optarg);
+		break;
+		case 's':
+			opts.split_period = atoi(optarg);
+		break;
+		case 'S':
+			opts.split_pct = atoi(optarg);
+		break;
+		case 'P':
+			opts.ping_ms = atoi(optarg);
+		break;
+		case 't':
+			opts.duration = atoi(optarg);
+		break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!opts.users || !opts.ping_ms) {
+		fprintf(stderr, "Users and PING period must be non-zero\n");
+		return 1;
+	}
+
+	users = calloc(opts.users, sizeof(*users));
+	if (!users)
+		return 1;
+
+	for (i = 0; i < opts.users; i++)
+		user_nick_gen(i);
+
+	listen_fd = listen_fd_new();
+	if (listen_fd < 0) {
+		fprintf(stderr, "Failed to listen on port %i: %s\n", opts.port, strerror(errno));
+		return 1;
+	}
+
+	signal(SIGINT, sig_quit);
+	signal(SIGTERM, sig_quit);
+	signal(SIGPIPE, SIG_IGN);
+
+	printf("Listening on 127.0.0.1:%i\n", opts.port);
+
+	start = last = last_stats = last_ping = gpirc_monotonic_ns();
+	split_at = start + opts.split_period * 1000000000ull;
+
+	while (!quit) {
+		fds[0] = (struct pollfd) {.fd = listen_fd, .events = POLLIN};
+
+		for (i = 0; i < clients_cnt; i++) {
+			fds[i + 1] = (struct pollfd) {
+				.fd = clients[i].fd,
+				.events = POLLIN | (client_backlog(&clients[i]) ? POLLOUT : 0),
+			};
+		}
+
+		if (poll(fds, clients_cnt + 1, TICK_MS) < 0 && errno != EINTR)
+			break;
+
+		/* Closing a client moves the last one into its place, go backwards */
+		for (i = clients_cnt; i-- > 0;) {
+			short revents = fds[i + 1].revents;
+
+			if (revents & (POLLIN | POLLHUP | POLLERR) && client_read(&clients[i])) {
+				client_close(&clients[i], "connection closed");
+				continue;
+			}
+
+			if (client_flush(&clients[i]))
+				client_close(&clients[i], strerror(errno));
+		}
+
+		if (fds[0].revents & POLLIN)
+			client_accept(listen_fd);
+
+		now = gpirc_monotonic_ns();
+
+		msg_credit += opts.msg_rate * ((now - last) / 1e9);
+		nick_credit += opts.nick_rate * ((now - last) / 1e9);
+		last = now;
+
+		for (; msg_credit >= 1; msg_credit--)
+			gen_msg();
+
+		for (; nick_credit >= 1; nick_credit--)
+			gen_nick();
+
+		/* The next split starts once the previous one healed */
+		if (opts.split_period && !heal_at && now >= split_at) {
+			gen_split(0);
+			split_at = now + opts.split_period * 1000000000ull;
+			heal_at = now + SPLIT_HEAL_MS * 1000000ull;
+		}
+
+		if (heal_at && now >= heal_at) {
+			gen_split(1);
+			heal_at = 0;
+		}
+
+		if (now - last_ping >= opts.ping_ms * 1000000ull) {
+			send_pings(now);
+			last_ping = now;
+		}
+
+		if (now - last_stats >= 1000000000) {
+			print_stats((now - last_stats) / 1e9);
+			last_stats = now;
+		}
+
+		for (i = clients_cnt; i-- > 0;) {
+			if (client_backlog(&clients[i]) >= BACKLOG_MAX - 64 * 1024) {
+				client_close(&clients[i], "backlog overflow");
+				continue;
+			}
+
+			if (client_flush(&clients[i]))
+				client_close(&clients[i], strerror(errno));
+		}
+
+		if (opts.duration && now - start >= opts.duration * 1000000000ull)
+			break;
+	}
+
+	while (clients_cnt)
+		client_close(&clients[0], "server exiting");
+
+	close(listen_fd);
+	free(users);
+
+	return 0;
+}
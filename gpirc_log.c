@@ -0,0 +1,757 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+#include "gpirc_ring.h"
+#include "gpirc_time.h"
+#include "gpirc_log.h"
+
+#define RING_SIZE 1024
+#define REC_INLINE 512
+/* Records queued when the ring is full before we start dropping */
+#define OVERFLOW_MAX (64 * 1024)
+
+/* Flush a file once it has this much data buffered */
+#define FLUSH_SIZE (64 * 1024)
+/* Index records buffered per file */
+#define IDX_BUF 2048
+/* Flush all files at least this often */
+#define FLUSH_MS 1000
+
+struct gpirc_log {
+	char *dir;
+	char *chan;
+
+	/* Writer thread state */
+	int fd;
+	int idx_fd;
+	/* Day of the currently open file, year * 1000 + day of the year */
+	int day;
+	/* Bytes in the log file */
+	uint64_t size;
+	char *buf;
+	size_t buf_len;
+	struct gpirc_log_idx idx[IDX_BUF];
+	size_t idx_len;
+	int listed;
+	struct gpirc_log *next;
+};
+
+enum rec_type {
+	REC_WRITE,
+	REC_CLOSE,
+};
+
+struct log_rec {
+	struct log_rec *next;
+	struct gpirc_log *log;
+	uint8_t rec_type;
+	time_t time;
+	uint8_t type;
+	uint32_t sender_len;
+	uint32_t body_len;
+	/* Sender and body that did not fit into buf */
+	char *heap;
+	char buf[REC_INLINE];
+};
+
+static char *base_dir;
+
+static struct gpirc_ring ring;
+static int efd = -1;
+static pthread_t writer;
+
+static atomic_int quit;
+
+/*
+ * Records that did not fit into the ring. Once there is anything queued here
+ * all records go here until the writer thread picks them up so that the
+ * order is preserved. The lock is taken only on this slow path.
+ */
+static pthread_mutex_t overflow_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct log_rec *overflow_head;
+static struct log_rec **overflow_tail = &overflow_head;
+static unsigned int overflow_cnt;
+/* UI thread state */
+static int overflowing;
+
+static uint64_t dropped;
+static atomic_uint_fast64_t errors;
+static atomic_uint_fast64_t writes;
+static atomic_uint_fast64_t bytes;
+/* Open logs, each holds a write buffer */
+static atomic_uint open_logs;
+
+/* Writer thread state */
+static struct gpirc_log *logs;
+static time_t tm_time = -1;
+static struct tm tm_cache;
+
+static void wake(void)
+{
+	uint64_t val = 1;
+
+	if (write(efd, &val, sizeof(val)) != sizeof(val))
+		return;
+}
+
+static int mkdir_p(char *path)
+{
+	char *p;
+
+	for (p = path + 1; *p; p++) {
+		if (*p != '/')
+			continue;
+
+		*p = 0;
+		if (mkdir(path, 0700) && errno != EEXIST) {
+			*p = '/';
+			return 1;
+		}
+		*p = '/';
+	}
+
+	if (mkdir(path, 0700) && errno != EEXIST)
+		return 1;
+
+	return 0;
+}
+
+static size_t write_all(int fd, const void *buf, size_t len)
+{
+	size_t off = 0;
+
+	while (off < len) {
+		ssize_t ret = write(fd, (const char *)buf + off, len - off);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			atomic_fetch_add_explicit(&errors, 1, memory_order_relaxed);
+			break;
+		}
+
+		atomic_fetch_add_explicit(&writes, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit(&bytes, ret, memory_order_relaxed);
+		off += ret;
+	}
+
+	return off;
+}
+
+/*
+ * The log data go first so that the index never points past the log end.
+ */
+static void log_flush(struct gpirc_log *self)
+{
+	if (self->buf_len) {
+		self->size += write_all(self->fd, self->buf, self->buf_len);
+		self->buf_len = 0;
+	}
+
+	if (self->idx_len) {
+		if (self->idx_fd >= 0)
+			write_all(self->idx_fd, self->idx, self->idx_len * sizeof(*self->idx));
+		self->idx_len = 0;
+	}
+}
+
+static void idx_add(struct gpirc_log *self, uint64_t off, time_t time)
+{
+	if (self->idx_len >= IDX_BUF)
+		log_flush(self);
+
+	self->idx[self->idx_len++] = (struct gpirc_log_idx) {
+		.off = off,
+		.time = time,
+	};
+}
+
+static int parse_hms(const char *str, size_t len)
+{
+	if (len < 8 || str[2] != ':' || str[5] != ':')
+		return -1;
+
+	return ((str[0] - '0') * 10 + str[1] - '0') * 3600 +
+	       ((str[3] - '0') * 10 + str[4] - '0') * 60 +
+	       (str[6] - '0') * 10 + str[7] - '0';
+}
+
+/*
+ * Indexes lines that are missing in the index, i.e. after a crash or for
+ * logs written before the index existed.
+ */
+static void idx_repair(struct gpirc_log *self, time_t day_start)
+{
+	struct gpirc_log_idx last;
+	uint64_t off = 0, idx_cnt;
+	time_t time = day_start;
+	int line_start = 1;
+	struct stat st;
+	char buf[4096];
+
+	if (fstat(self->fd, &st))
+		return;
+
+	self->size = st.st_size;
+
+	if (fstat(self->idx_fd, &st))
+		return;
+
+	idx_cnt = st.st_size / sizeof(last);
+
+	if (idx_cnt && pread(self->idx_fd, &last, sizeof(last),
+	                     (idx_cnt - 1) * sizeof(last)) == sizeof(last) &&
+	    last.off < self->size) {
+		off = last.off;
+		time = last.time;
+		line_start = 0;
+	} else {
+		idx_cnt = 0;
+	}
+
+	/* Drops partially written record or an index that does not match */
+	if (ftruncate(self->idx_fd, idx_cnt * sizeof(last)))
+		return;
+
+	while (off < self->size) {
+		ssize_t i, ret = pread(self->fd, buf, sizeof(buf), off);
+
+		if (ret <= 0)
+			break;
+
+		for (i = 0; i < ret; i++) {
+			if (line_start) {
+				int hms = parse_hms(buf + i, ret - i);
+
+				if (hms >= 0)
+					time = day_start + hms;
+
+				idx_add(self, off + i, time);
+				line_start = 0;
+			}
+
+			if (buf[i] == '\n')
+				line_start = 1;
+		}
+
+		off += ret;
+	}
+
+	/* Terminate a partially written line */
+	if (self->size && !line_start)
+		self->size += write_all(self->fd, "\n", 1);
+
+	log_flush(self);
+}
+
+static void log_rotate(struct gpirc_log *self, struct tm *tm)
+{
+	struct tm day = *tm;
+	char path[4096];
+	int len;
+
+	log_flush(self);
+
+	if (self->fd >= 0)
+		close(self->fd);
+
+	if (self->idx_fd >= 0)
+		close(self->idx_fd);
+
+	self->idx_fd = -1;
+	self->day = (tm->tm_year + 1900) * 1000 + tm->tm_yday;
+
+	len = snprintf(path, sizeof(path) - 4, "%s/%04i-%02i-%02i.", self->dir,
+	               tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday);
+
+	strcpy(path + len, "log");
+
+	self->fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+	if (self->fd < 0 && errno == ENOENT && !mkdir_p(self->dir))
+		self->fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+
+	if (self->fd < 0)
+		return;
+
+	strcpy(path + len, "idx");
+
+	self->idx_fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+	if (self->idx_fd < 0)
+		return;
+
+	day.tm_hour = 0;
+	day.tm_min = 0;
+	day.tm_sec = 0;
+	day.tm_isdst = -1;
+
+	idx_repair(self, mktime(&day));
+}
+
+static void log_append(struct log_rec *rec)
+{
+	struct gpirc_log *self = rec->log;
+	const char *data = rec->heap ? rec->heap : rec->buf;
+	const char *sender = rec->sender_len ? data : NULL;
+	const char *body = data + rec->sender_len + 1;
+	struct tm tm;
+	int len;
+
+	if (!self->listed) {
+		self->next = logs;
+		logs = self;
+		self->listed = 1;
+	}
+
+	if (rec->time != tm_time) {
+		localtime_r(&rec->time, &tm_cache);
+		tm_time = rec->time;
+	}
+
+	tm = tm_cache;
+
+	if (self->day != (tm.tm_year + 1900) * 1000 + tm.tm_yday)
+		log_rotate(self, &tm);
+
+	if (self->fd < 0) {
+		atomic_fetch_add_explicit(&errors, 1, memory_order_relaxed);
+		return;
+	}
+
+	/* Timestamp, the line and a newline */
+	len = gpirc_msg_fmt(NULL, 0, rec->type, sender, body, self->chan) + 10;
+
+	if (self->buf_len + len > FLUSH_SIZE || self->idx_len >= IDX_BUF)
+		log_flush(self);
+
+	char *line = self->buf + self->buf_len;
+
+	/* Does not fit into the buffer at all, e.g. a huge NAMES dump */
+	if (len > FLUSH_SIZE) {
+		line = malloc(len + 1);
+		if (!line) {
+			atomic_fetch_add_explicit(&errors, 1, memory_order_relaxed);
+			return;
+		}
+	}
+
+	idx_add(self, self->size + self->buf_len, rec->time);
+
+	snprintf(line, 10, "%02i:%02i:%02i ", tm.tm_hour, tm.tm_min, tm.tm_sec);
+	gpirc_msg_fmt(line + 9, len - 9, rec->type, sender, body, self->chan);
+	line[len - 1] = '\n';
+
+	if (len > FLUSH_SIZE) {
+		self->size += write_all(self->fd, line, len);
+		free(line);
+		return;
+	}
+
+	self->buf_len += len;
+}
+
+static void log_free(struct gpirc_log *self)
+{
+	if (self->buf)
+		atomic_fetch_sub(&open_logs, 1);
+
+	free(self->buf);
+	free(self->dir);
+	free(self->chan);
+	free(self);
+}
+
+static void log_destroy(struct gpirc_log *self)
+{
+	struct gpirc_log **i;
+
+	log_flush(self);
+
+	if (self->fd >= 0)
+		close(self->fd);
+
+	if (self->idx_fd >= 0)
+		close(self->idx_fd);
+
+	for (i = &logs; *i; i = &(*i)->next) {
+		if (*i == self) {
+			*i = self->next;
+			break;
+		}
+	}
+
+	log_free(self);
+}
+
+static void rec_process(struct log_rec *rec)
+{
+	switch (rec->rec_type) {
+	case REC_WRITE:
+		log_append(rec);
+	break;
+	case REC_CLOSE:
+		log_destroy(rec->log);
+	break;
+	}
+
+	free(rec->heap);
+}
+
+/*
+ * The ring has to be drained first, the overflow list holds newer records.
+ */
+static void drain(void)
+{
+	struct log_rec *rec, *next;
+
+	while ((rec = gpirc_ring_cons_slot(&ring))) {
+		rec_process(rec);
+		gpirc_ring_cons_release(&ring);
+	}
+
+	pthread_mutex_lock(&overflow_lock);
+	rec = overflow_head;
+	overflow_head = NULL;
+	overflow_tail = &overflow_head;
+	overflow_cnt = 0;
+	pthread_mutex_unlock(&overflow_lock);
+
+	for (; rec; rec = next) {
+		next = rec->next;
+		rec_process(rec);
+		free(rec);
+	}
+}
+
+static void flush_all(void)
+{
+	struct gpirc_log *i;
+
+	for (i = logs; i; i = i->next)
+		log_flush(i);
+}
+
+static void *writer_main(void *arg)
+{
+	struct pollfd pfd = {.fd = efd, .events = POLLIN};
+	uint64_t last_flush = gpirc_monotonic_ns();
+
+	(void) arg;
+
+	for (;;) {
+		/* Has to be read before we drain so that no record is lost */
+		int stop = atomic_load(&quit);
+		uint64_t now;
+
+		drain();
+
+		if (stop)
+			break;
+
+		now = gpirc_monotonic_ns();
+		if (now - last_flush >= FLUSH_MS * 1000000ull) {
+			flush_all();
+			last_flush = now;
+		}
+
+		if (poll(&pfd, 1, FLUSH_MS) > 0) {
+			uint64_t val;
+
+			if (read(efd, &val, sizeof(val)) != sizeof(val))
+				continue;
+		}
+	}
+
+	while (logs)
+		log_destroy(logs);
+
+	return NULL;
+}
+
+static char *logs_base_dir(void)
+{
+	const char *data_home = getenv("XDG_DATA_HOME");
+	const char *home = getenv("HOME");
+	char path[4096];
+
+	if (data_home && data_home[0])
+		snprintf(path, sizeof(path), "%s/gpirc/logs", data_home);
+	else if (home)
+		snprintf(path, sizeof(path), "%s/.local/share/gpirc/logs", home);
+	else
+		return NULL;
+
+	return strdup(path);
+}
+
+int gpirc_logs_init(void)
+{
+	atomic_store(&quit, 0);
+
+	base_dir = logs_base_dir();
+	if (!base_dir)
+		return 1;
+
+	if (gpirc_ring_init(&ring, RING_SIZE, sizeof(struct log_rec)))
+		goto err0;
+
+	efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (efd < 0)
+		goto err1;
+
+	if (pthread_create(&writer, NULL, writer_main, NULL))
+		goto err2;
+
+	return 0;
+err2:
+	close(efd);
+	efd = -1;
+err1:
+	gpirc_ring_exit(&ring);
+err0:
+	free(base_dir);
+	base_dir = NULL;
+	return 1;
+}
+
+void gpirc_logs_exit(void)
+{
+	if (efd < 0)
+		return;
+
+	atomic_store(&quit, 1);
+	wake();
+
+	pthread_join(writer, NULL);
+
+	close(efd);
+	efd = -1;
+
+	gpirc_ring_exit(&ring);
+	free(base_dir);
+	base_dir = NULL;
+}
+
+void gpirc_logs_stats(struct gpirc_log_stats *stats)
+{
+	stats->dropped = dropped;
+	stats->errors = atomic_load(&errors);
+	stats->writes = atomic_load(&writes);
+	stats->bytes = atomic_load(&bytes);
+
+	stats->mem = 0;
+	if (!base_dir)
+		return;
+
+	pthread_mutex_lock(&overflow_lock);
+	stats->mem = (RING_SIZE + overflow_cnt) * sizeof(struct log_rec);
+	pthread_mutex_unlock(&overflow_lock);
+
+	stats->mem += atomic_load(&open_logs) * (sizeof(struct gpirc_log) + FLUSH_SIZE);
+}
+
+const char *gpirc_logs_dir(void)
+{
+	return base_dir;
+}
+
+/*
+ * Path components must not escape the log directory.
+ */
+static void path_sanitize(char *str)
+{
+	if (str[0] == '.')
+		str[0] = '_';
+
+	for (; *str; str++) {
+		if (*str == '/')
+			*str = '_';
+	}
+}
+
+char *gpirc_log_dir(const char *net, const char *chan)
+{
+	char net_buf[256], chan_buf[256], path[4096];
+
+	if (!base_dir)
+		return NULL;
+
+	snprintf(net_buf, sizeof(net_buf), "%s", net);
+	snprintf(chan_buf, sizeof(chan_buf), "%s", chan);
+
+	path_sanitize(net_buf);
+	path_sanitize(chan_buf);
+
+	snprintf(path, sizeof(path), "%s/%s/%s", base_dir, net_buf, chan_buf);
+
+	return strdup(path);
+}
+
+struct gpirc_log *gpirc_log_open(const char *net, const char *chan)
+{
+	struct gpirc_log *self;
+
+	if (!base_dir)
+		return NULL;
+
+	self = calloc(1, sizeof(struct gpirc_log));
+	if (!self)
+		return NULL;
+
+	self->fd = -1;
+	self->idx_fd = -1;
+	self->day = -1;
+
+	self->dir = gpirc_log_dir(net, chan);
+	self->chan = strdup(chan);
+	self->buf = malloc(FLUSH_SIZE);
+
+	if (self->buf)
+		atomic_fetch_add(&open_logs, 1);
+
+	if (!self->dir || !self->chan || !self->buf) {
+		log_free(self);
+		return NULL;
+	}
+
+	return self;
+}
+
+static struct log_rec *rec_alloc(void)
+{
+	struct log_rec *rec;
+	int full = 0;
+
+	if (overflowing) {
+		pthread_mutex_lock(&overflow_lock);
+		overflowing = !!overflow_head;
+		full = overflow_cnt >= OVERFLOW_MAX;
+		pthread_mutex_unlock(&overflow_lock);
+	}
+
+	if (!overflowing) {
+		rec = gpirc_ring_prod_slot(&ring);
+		if (rec)
+			return rec;
+	}
+
+	if (full)
+		return NULL;
+
+	rec = malloc(sizeof(struct log_rec));
+	if (rec)
+		overflowing = 1;
+
+	return rec;
+}
+
+static void rec_commit(struct log_rec *rec)
+{
+	if (!overflowing) {
+		gpirc_ring_prod_commit(&ring);
+
+		/* The writer wakes up once per second anyway, kick it only when busy */
+		if (gpirc_ring_used(&ring) == RING_SIZE / 2)
+			wake();
+
+		return;
+	}
+
+	rec->next = NULL;
+
+	pthread_mutex_lock(&overflow_lock);
+	*overflow_tail = rec;
+	overflow_tail = &rec->next;
+	int first = !overflow_cnt++;
+	pthread_mutex_unlock(&overflow_lock);
+
+	if (first)
+		wake();
+}
+
+static void rec_abort(struct log_rec *rec)
+{
+	if (overflowing)
+		free(rec);
+}
+
+void gpirc_log_close(struct gpirc_log *self)
+{
+	struct log_rec *rec;
+
+	if (!self)
+		return;
+
+	/* Nothing is lost here, only the handle leaks */
+	rec = rec_alloc();
+	if (!rec)
+		return;
+
+	rec->log = self;
+	rec->rec_type = REC_CLOSE;
+	rec->heap = NULL;
+
+	rec_commit(rec);
+	wake();
+}
+
+void gpirc_log_write(struct gpirc_log *self, time_t time,
+                     enum gpirc_msg_type type, const char *sender,
+                     const char *body, size_t len)
+{
+	size_t sender_len = sender ? strlen(sender) : 0;
+	struct log_rec *rec;
+	char *data;
+
+	if (!self)
+		return;
+
+	rec = rec_alloc();
+	if (!rec) {
+		dropped++;
+		return;
+	}
+
+	rec->heap = NULL;
+	data = rec->buf;
+
+	if (sender_len + len + 2 > REC_INLINE) {
+		rec->heap = malloc(sender_len + len + 2);
+		if (!rec->heap) {
+			rec_abort(rec);
+			dropped++;
+			return;
+		}
+
+		data = rec->heap;
+	}
+
+	rec->log = self;
+	rec->rec_type = REC_WRITE;
+	rec->time = time;
+	rec->type = type;
+	rec->sender_len = sender_len;
+	rec->body_len = len;
+
+	memcpy(data, sender ? sender : "", sender_len + 1);
+	memcpy(data + sender_len + 1, body, len);
+	data[sender_len + 1 + len] = 0;
+
+	rec_commit(rec);
+}
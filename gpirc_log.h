@@ -0,0 +1,103 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * Persistent per channel chat logs.
+ *
+ * Logs are append-only text files, one line per message, rotated daily:
+ *
+ * $XDG_DATA_HOME/gpirc/logs/$network/$channel/YYYY-MM-DD.log
+ *
+ * Each log file has a sidecar YYYY-MM-DD.idx index with a record per line,
+ * the writer thread repairs the index when it opens a file so that it always
+ * covers all lines that were written.
+ *
+ * The UI thread only copies messages into a lock-free queue, with a capped
+ * overflow list for bursts, the formatting and the I/O is done by a writer
+ * thread which batches the writes and flushes each file once its buffer fills
+ * up or once per second. There is no fsync() per line, a crash may lose up to
+ * the last second of logs.
+ */
+
+#ifndef GPIRC_LOG_H__
+#define GPIRC_LOG_H__
+
+#include <stdint.h>
+#include <time.h>
+#include "gpirc_msgs.h"
+
+struct gpirc_log;
+
+struct gpirc_log_idx {
+	/* Line offset in the log file */
+	uint32_t off;
+	/* Message timestamp */
+	uint32_t time;
+};
+
+struct gpirc_log_stats {
+	/* Messages dropped because the queue was full */
+	uint64_t dropped;
+	/* Failed writes, the data are lost */
+	uint64_t errors;
+	/* Number of write() calls */
+	uint64_t writes;
+	uint64_t bytes;
+	/* Memory used by the queue and the per file write buffers */
+	size_t mem;
+};
+
+/*
+ * Starts the writer thread.
+ *
+ * @return Zero on success.
+ */
+int gpirc_logs_init(void);
+
+/*
+ * Flushes all logs and stops the writer thread.
+ */
+void gpirc_logs_exit(void);
+
+void gpirc_logs_stats(struct gpirc_log_stats *stats);
+
+/*
+ * Returns the base log directory or NULL if logging is disabled.
+ */
+const char *gpirc_logs_dir(void);
+
+/*
+ * Returns a directory the logs for a channel are stored in.
+ */
+char *gpirc_log_dir(const char *net, const char *chan);
+
+/*
+ * Opens a channel log.
+ *
+ * @net A network name.
+ * @chan A channel name.
+ *
+ * @return A log handle or NULL if logging is disabled or on a failure.
+ */
+struct gpirc_log *gpirc_log_open(const char *net, const char *chan);
+
+/*
+ * Flushes and closes the log, the handle must not be used afterwards.
+ */
+void gpirc_log_close(struct gpirc_log *self);
+
+/*
+ * Queues a message to be written into the log.
+ *
+ * @self A log handle, may be NULL in which case nothing is done.
+ */
+void gpirc_log_write(struct gpirc_log *self, time_t time,
+                     enum gpirc_msg_type type, const char *sender,
+                     const char *body, size_t len);
+
+#endif /* GPIRC_LOG_H__ */
@@ -0,0 +1,220 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "gpirc_users.h"
+#include "gpirc_match.h"
+
+int gpirc_match_add(struct gpirc_match *self, const char *pat, size_t len)
+{
+	size_t i;
+
+	if (!len)
+		return 0;
+
+	if (self->pats_len + len + 1 > self->pats_size) {
+		size_t size = self->pats_size ? 2 * self->pats_size : 1024;
+		char *pats;
+
+		while (size < self->pats_len + len + 1)
+			size *= 2;
+
+		pats = realloc(self->pats, size);
+		if (!pats)
+			return 1;
+
+		self->pats = pats;
+		self->pats_size = size;
+	}
+
+	for (i = 0; i < len; i++)
+		self->pats[self->pats_len++] = gpirc_fold(pat[i]);
+
+	self->pats[self->pats_len++] = 0;
+	self->pats_cnt++;
+
+	return 0;
+}
+
+static void pats_free(struct gpirc_match *self)
+{
+	free(self->pats);
+	self->pats = NULL;
+	self->pats_len = 0;
+	self->pats_size = 0;
+	self->pats_cnt = 0;
+}
+
+/*
+ * Builds a trie of the patterns in the transition table, zero stands for a
+ * missing edge since no edge leads back to the root.
+ *
+ * @return Number of states.
+ */
+static uint32_t trie_build(const char *pats, size_t pats_len, uint32_t *delta,
+                           uint8_t *accept, uint32_t *lens, const uint16_t *cls,
+                           uint32_t classes)
+{
+	uint32_t states = 1;
+	size_t i = 0;
+
+	while (i < pats_len) {
+		uint32_t state = 0;
+		size_t start = i;
+
+		for (; pats[i]; i++) {
+			uint32_t *next = &delta[state * classes + cls[(unsigned char)pats[i]]];
+
+			if (!*next)
+				*next = states++;
+
+			state = *next;
+		}
+
+		accept[state] = 1;
+		lens[state] = i - start;
+		i++;
+	}
+
+	return states;
+}
+
+/*
+ * Resolves the failure transitions in breadth first order, a missing edge is
+ * replaced by the edge of the longest proper suffix that is in the trie. The
+ * states are numbered in insertion order so a separate queue is needed.
+ *
+ * The out links chain the states to the longest proper suffix a pattern ends
+ * in, so that all the patterns ending at a place can be listed.
+ */
+static int dfa_build(uint32_t *delta, uint8_t *accept, const uint32_t *lens,
+                     uint32_t *out, uint32_t states, uint32_t classes)
+{
+	uint32_t *queue, *fail;
+	uint32_t head = 0, tail = 0, c;
+
+	queue = malloc(sizeof(uint32_t) * states);
+	fail = calloc(states, sizeof(uint32_t));
+
+	if (!queue || !fail) {
+		free(queue);
+		free(fail);
+		return 1;
+	}
+
+	for (c = 0; c < classes; c++) {
+		uint32_t next = delta[c];
+
+		if (next)
+			queue[tail++] = next;
+	}
+
+	while (head < tail) {
+		uint32_t state = queue[head++];
+		uint32_t *row = &delta[state * classes];
+		uint32_t *fail_row = &delta[fail[state] * classes];
+
+		/* A pattern that is a suffix of the current one matches too */
+		accept[state] |= accept[fail[state]];
+		out[state] = lens[fail[state]] ? fail[state] : out[fail[state]];
+
+		for (c = 0; c < classes; c++) {
+			if (!row[c]) {
+				row[c] = fail_row[c];
+				continue;
+			}
+
+			fail[row[c]] = fail_row[c];
+			queue[tail++] = row[c];
+		}
+	}
+
+	free(queue);
+	free(fail);
+
+	return 0;
+}
+
+int gpirc_match_compile(struct gpirc_match *self)
+{
+	uint16_t cls[256] = {};
+	uint32_t classes = 1, states;
+	uint32_t *delta = NULL, *lens = NULL, *out = NULL;
+	uint8_t *accept = NULL;
+	size_t i;
+
+	if (!self->pats_cnt) {
+		gpirc_match_free(self);
+		return 0;
+	}
+
+	for (i = 0; i < self->pats_len; i++) {
+		unsigned char c = self->pats[i];
+
+		if (c && !cls[c])
+			cls[c] = classes++;
+	}
+
+	/* Upper bound, one state per pattern character and the root */
+	states = self->pats_len - self->pats_cnt + 1;
+
+	delta = calloc((size_t)states * classes, sizeof(uint32_t));
+	accept = calloc(states, 1);
+	lens = calloc(states, sizeof(uint32_t));
+	out = calloc(states, sizeof(uint32_t));
+	if (!delta || !accept || !lens || !out)
+		goto err;
+
+	states = trie_build(self->pats, self->pats_len, delta, accept, lens, cls, classes);
+
+	if (dfa_build(delta, accept, lens, out, states, classes))
+		goto err;
+
+	/* Shared prefixes need fewer states than the upper bound */
+	uint32_t *tmp = realloc(delta, sizeof(uint32_t) * states * classes);
+	if (tmp)
+		delta = tmp;
+
+	pats_free(self);
+
+	free(self->delta);
+	free(self->accept);
+	free(self->lens);
+	free(self->out);
+
+	self->delta = delta;
+	self->accept = accept;
+	self->lens = lens;
+	self->out = out;
+	self->states = states;
+	self->classes = classes;
+
+	/* The scan goes through the raw bytes */
+	for (i = 0; i < 256; i++)
+		self->cls[i] = cls[gpirc_fold(i)];
+
+	return 0;
+err:
+	pats_free(self);
+	free(delta);
+	free(accept);
+	free(lens);
+	free(out);
+	return 1;
+}
+
+void gpirc_match_free(struct gpirc_match *self)
+{
+	pats_free(self);
+	free(self->delta);
+	free(self->accept);
+	free(self->lens);
+	free(self->out);
+	gpirc_match_init(self);
+}
@@ -0,0 +1,156 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * Multi pattern substring matcher.
+ *
+ * Patterns are compiled into an Aho-Corasick automaton with all failure
+ * transitions resolved upfront, i.e. a DFA, so that a text is scanned once
+ * with a single table lookup per byte no matter how many patterns there are.
+ * Matching is case insensitive with the RFC1459 case mapping.
+ *
+ * Bytes that do not appear in any pattern share a single input class, which
+ * keeps the transition table rows short.
+ */
+
+#ifndef GPIRC_MATCH_H__
+#define GPIRC_MATCH_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct gpirc_match {
+	/* Transition table row length */
+	uint32_t classes;
+	uint32_t states;
+	/* Input class for each byte */
+	uint16_t cls[256];
+	/* Transitions, states * classes entries, NULL if there are no patterns */
+	uint32_t *delta;
+	/* Non-zero for states where any of the patterns ends */
+	uint8_t *accept;
+	/* Length of the pattern ending in a state, zero if there is none */
+	uint32_t *lens;
+	/* Next suffix state with a pattern end, zero if there is none */
+	uint32_t *out;
+
+	/* Case folded patterns added since the last compile */
+	char *pats;
+	size_t pats_len;
+	size_t pats_size;
+	size_t pats_cnt;
+};
+
+static inline void gpirc_match_init(struct gpirc_match *self)
+{
+	*self = (struct gpirc_match) {};
+}
+
+/*
+ * Adds a pattern, empty patterns are ignored.
+ *
+ * @return Zero on success, non-zero on allocation failure.
+ */
+int gpirc_match_add(struct gpirc_match *self, const char *pat, size_t len);
+
+/*
+ * Builds the automaton from the patterns added so far and replaces the
+ * previous one.
+ *
+ * @return Zero on success, non-zero on allocation failure in which case the
+ *         added patterns are dropped and the previous automaton is kept.
+ */
+int gpirc_match_compile(struct gpirc_match *self);
+
+void gpirc_match_free(struct gpirc_match *self);
+
+/*
+ * Returns non-zero if any of the patterns occurs in the string.
+ */
+static inline int gpirc_match_any(const struct gpirc_match *self, const char *str)
+{
+	const uint32_t *delta = self->delta;
+	uint32_t state = 0;
+
+	if (!delta)
+		return 0;
+
+	for (; *str; str++) {
+		state = delta[state * self->classes + self->cls[(unsigned char)*str]];
+
+		if (self->accept[state])
+			return 1;
+	}
+
+	return 0;
+}
+
+struct gpirc_match_pos {
+	/* Offset just past the match */
+	size_t end;
+	/* Length of the matched pattern */
+	size_t len;
+	uint32_t state;
+	uint32_t out;
+};
+
+/*
+ * Finds the next occurrence of any of the patterns, all patterns ending at
+ * the same place are reported one by one, the longest first.
+ *
+ * @str A string to scan.
+ * @len A string length.
+ * @pos Scan position, zeroed before the first call.
+ *
+ * @return Non-zero if a match was stored into pos.
+ */
+static inline int gpirc_match_next(const struct gpirc_match *self, const char *str,
+                                   size_t len, struct gpirc_match_pos *pos)
+{
+	uint32_t state = pos->state;
+
+	if (!self->delta)
+		return 0;
+
+	if (pos->out) {
+		pos->len = self->lens[pos->out];
+		pos->out = self->out[pos->out];
+		return 1;
+	}
+
+	while (pos->end < len) {
+		state = self->delta[state * self->classes + self->cls[(unsigned char)str[pos->end++]]];
+
+		if (!self->accept[state])
+			continue;
+
+		pos->state = state;
+
+		if (!self->lens[state])
+			state = self->out[state];
+
+		pos->len = self->lens[state];
+		pos->out = self->out[state];
+		return 1;
+	}
+
+	pos->state = state;
+
+	return 0;
+}
+
+/*
+ * Returns memory used by the automaton.
+ */
+static inline size_t gpirc_match_size(const struct gpirc_match *self)
+{
+	return (size_t)self->states * (self->classes * sizeof(uint32_t) + 1 +
+	                               2 * sizeof(uint32_t));
+}
+
+#endif /* GPIRC_MATCH_H__ */
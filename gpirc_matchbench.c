@@ -0,0 +1,218 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * Highlight and ignore matcher benchmark.
+ *
+ * Compiles a number of random word rules and scans random chat lines with
+ * them, the same lines are scanned with a naive loop over the rules for
+ * comparison.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gpirc_users.h"
+#include "gpirc_time.h"
+#include "gpirc_match.h"
+
+#define LINE_LEN 120
+/* The naive scan is orders of magnitude slower, it's run on fewer lines */
+#define NAIVE_LINES 1000
+
+static struct opts {
+	unsigned int rules;
+	unsigned int lines;
+	unsigned int loops;
+} opts = {
+	.rules = 5000,
+	.lines = 100000,
+	.loops = 10,
+};
+
+static void rand_word(char *buf, size_t min, size_t max)
+{
+	size_t i, len = min + random() % (max - min + 1);
+
+	for (i = 0; i < len; i++)
+		buf[i] = 'a' + random() % 26;
+
+	buf[len] = 0;
+}
+
+static char *rand_line(void)
+{
+	char *line = malloc(LINE_LEN + 1);
+	size_t len = 0;
+
+	if (!line)
+		return NULL;
+
+	while (len < LINE_LEN - 12) {
+		rand_word(line + len, 2, 8);
+		len += strlen(line + len);
+		line[len++] = ' ';
+	}
+
+	line[len - 1] = 0;
+
+	return line;
+}
+
+static int naive_find(const char *line, const char *rule)
+{
+	size_t i;
+
+	for (; *line; line++) {
+		for (i = 0; rule[i] && gpirc_fold(line[i]) == gpirc_fold(rule[i]); i++);
+
+		if (!rule[i])
+			return 1;
+	}
+
+	return 0;
+}
+
+static int naive_match(char **rules, const char *line)
+{
+	unsigned int i;
+
+	for (i = 0; i < opts.rules; i++) {
+		if (naive_find(line, rules[i]))
+			return 1;
+	}
+
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [opts]\n\n", name);
+	printf(" -r rules    number of rules (%u)\n", opts.rules);
+	printf(" -n lines    number of lines (%u)\n", opts.lines);
+	printf(" -l loops    scans over the lines (%u)\n", opts.loops);
+}
+
+int main(int argc, char *argv[])
+{
+	struct gpirc_match match;
+	char **rules, **lines;
+	uint64_t start, ns;
+	unsigned int i, l, hits = 0, naive_hits = 0, naive_lines, check_hits = 0;
+	size_t bytes = 0, naive_bytes = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "hr:n:l:")) != -1) {
+		switch (opt) {
+		case 'r':
+			opts.rules = atoi(optarg);
+		break;
+		case 'n':
+			opts.lines = atoi(optarg);
+		break;
+		case 'l':
+			opts.loops = atoi(optarg);
+		break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!opts.lines || !opts.loops) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	srandom(1);
+
+	rules = calloc(opts.rules + 1, sizeof(char *));
+	lines = calloc(opts.lines, sizeof(char *));
+	if (!rules || !lines)
+		goto oom;
+
+	gpirc_match_init(&match);
+
+	/* Mostly longer words so that only some of the lines match */
+	for (i = 0; i < opts.rules; i++) {
+		rules[i] = malloc(16);
+		if (!rules[i])
+			goto oom;
+
+		rand_word(rules[i], 5, 12);
+
+		if (gpirc_match_add(&match, rules[i], strlen(rules[i])))
+			goto oom;
+	}
+
+	for (i = 0; i < opts.lines; i++) {
+		lines[i] = rand_line();
+		if (!lines[i])
+			goto oom;
+
+		bytes += strlen(lines[i]);
+	}
+
+	start = gpirc_monotonic_ns();
+	if (gpirc_match_compile(&match))
+		goto oom;
+	ns = gpirc_monotonic_ns() - start;
+
+	printf("Compiled %u rules in %.2fms, %u states, %u classes, %zuKB\n",
+	       opts.rules, ns / 1e6, match.states, match.classes,
+	       gpirc_match_size(&match) / 1024);
+
+	start = gpirc_monotonic_ns();
+
+	for (l = 0; l < opts.loops; l++) {
+		for (i = 0; i < opts.lines; i++)
+			hits += gpirc_match_any(&match, lines[i]);
+	}
+
+	ns = gpirc_monotonic_ns() - start;
+
+	printf("Automaton %.1fns per line, %.1fMB/s, %u matches\n",
+	       (double)ns / opts.lines / opts.loops,
+	       (double)bytes * opts.loops / (ns / 1e9) / (1024 * 1024),
+	       hits / opts.loops);
+
+	naive_lines = opts.lines < NAIVE_LINES ? opts.lines : NAIVE_LINES;
+
+	start = gpirc_monotonic_ns();
+
+	for (i = 0; i < naive_lines; i++)
+		naive_hits += naive_match(rules, lines[i]);
+
+	ns = gpirc_monotonic_ns() - start;
+
+	for (i = 0; i < naive_lines; i++) {
+		naive_bytes += strlen(lines[i]);
+		check_hits += gpirc_match_any(&match, lines[i]);
+	}
+
+	printf("Naive     %.1fns per line, %.1fMB/s, %u matches in the first %u lines\n",
+	       (double)ns / naive_lines, (double)naive_bytes / (ns / 1e9) / (1024 * 1024),
+	       naive_hits, naive_lines);
+
+	gpirc_match_free(&match);
+
+	if (naive_hits != check_hits) {
+		printf("Match count mismatch!\n");
+		return 1;
+	}
+
+	return 0;
+oom:
+	printf("Allocation failure\n");
+	return 1;
+}
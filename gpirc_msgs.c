@@ -0,0 +1,351 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gpirc_msgs.h"
+
+#define RECS_MIN 64
+#define BUF_MIN 4096
+
+/*
+ * Intern table, open addressing with linear probing.
+ */
+static struct intern {
+	size_t size;
+	size_t cnt;
+	struct gpirc_str **slots;
+} intern;
+
+static uint32_t str_hash(const char *str, size_t len)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)str[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static size_t intern_find(const char *str, size_t len, uint32_t hash)
+{
+	size_t mask = intern.size - 1;
+	size_t i = hash & mask;
+
+	for (;;) {
+		struct gpirc_str *s = intern.slots[i];
+
+		if (!s)
+			return i;
+
+		if (s->hash == hash && s->len == len && !memcmp(s->str, str, len))
+			return i;
+
+		i = (i + 1) & mask;
+	}
+}
+
+static int intern_grow(void)
+{
+	size_t i, new_size = intern.size ? 2 * intern.size : 256;
+	struct gpirc_str **old_slots = intern.slots;
+	size_t old_size = intern.size;
+
+	intern.slots = calloc(new_size, sizeof(struct gpirc_str *));
+	if (!intern.slots) {
+		intern.slots = old_slots;
+		return 1;
+	}
+
+	intern.size = new_size;
+
+	for (i = 0; i < old_size; i++) {
+		struct gpirc_str *s = old_slots[i];
+
+		if (s)
+			intern.slots[intern_find(s->str, s->len, s->hash)] = s;
+	}
+
+	free(old_slots);
+
+	return 0;
+}
+
+struct gpirc_str *gpirc_str_intern(const char *str, size_t len)
+{
+	uint32_t hash = str_hash(str, len);
+	struct gpirc_str **slot, *s;
+
+	if (2 * (intern.cnt + 1) > intern.size && intern_grow())
+		return NULL;
+
+	slot = &intern.slots[intern_find(str, len, hash)];
+	if (*slot) {
+		(*slot)->refcnt++;
+		return *slot;
+	}
+
+	s = malloc(sizeof(struct gpirc_str) + len + 1);
+	if (!s)
+		return NULL;
+
+	s->refcnt = 1;
+	s->hash = hash;
+	s->len = len;
+	memcpy(s->str, str, len);
+	s->str[len] = 0;
+
+	*slot = s;
+	intern.cnt++;
+
+	return s;
+}
+
+void gpirc_str_unref(struct gpirc_str *self)
+{
+	size_t mask = intern.size - 1;
+	size_t i, j;
+
+	if (--self->refcnt)
+		return;
+
+	i = j = intern_find(self->str, self->len, self->hash);
+
+	/* Backward shift deletion */
+	for (;;) {
+		size_t k;
+
+		j = (j + 1) & mask;
+
+		if (!intern.slots[j])
+			break;
+
+		k = intern.slots[j]->hash & mask;
+
+		if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+
+		intern.slots[i] = intern.slots[j];
+		i = j;
+	}
+
+	intern.slots[i] = NULL;
+	intern.cnt--;
+
+	free(self);
+}
+
+static size_t msg_size(struct gpirc_msg *msg)
+{
+	return msg->len + 1 + msg->attrs_len;
+}
+
+static void evict(struct gpirc_msgs *self)
+{
+	struct gpirc_msg *msg = gpirc_msgs_get(self, self->head);
+
+	if (msg->sender)
+		gpirc_str_unref(msg->sender);
+
+	self->buf_used -= msg_size(msg);
+	self->head++;
+}
+
+void gpirc_msgs_free(struct gpirc_msgs *self)
+{
+	while (self->head < self->tail)
+		evict(self);
+
+	free(self->recs);
+	free(self->buf);
+
+	self->recs = NULL;
+	self->buf = NULL;
+	self->recs_size = 0;
+	self->buf_size = 0;
+	self->buf_tail = 0;
+	self->buf_used = 0;
+}
+
+/*
+ * Reallocates both rings and copies the messages over in order, the bodies
+ * end up contiguous at the start of the new byte ring.
+ */
+static int resize(struct gpirc_msgs *self, size_t recs_size, size_t buf_size)
+{
+	struct gpirc_msg *recs;
+	size_t off = 0;
+	uint64_t id;
+	char *buf;
+
+	recs = malloc(recs_size * sizeof(struct gpirc_msg));
+	if (!recs)
+		return 1;
+
+	buf = malloc(buf_size);
+	if (!buf) {
+		free(recs);
+		return 1;
+	}
+
+	for (id = self->head; id < self->tail; id++) {
+		struct gpirc_msg *old = gpirc_msgs_get(self, id);
+		struct gpirc_msg *new = &recs[id & (recs_size - 1)];
+
+		*new = *old;
+		new->off = off;
+		memcpy(buf + off, self->buf + old->off, msg_size(old));
+		off += msg_size(old);
+	}
+
+	free(self->recs);
+	free(self->buf);
+
+	self->recs = recs;
+	self->recs_size = recs_size;
+	self->buf = buf;
+	self->buf_size = buf_size;
+	self->buf_tail = off;
+	self->buf_used = off;
+
+	return 0;
+}
+
+/*
+ * Grows the rings if there is not enough space and we are under the limits.
+ */
+static int maybe_grow(struct gpirc_msgs *self, size_t len)
+{
+	size_t recs_size = self->recs_size;
+	size_t buf_size = self->buf_size;
+
+	if (!recs_size)
+		recs_size = RECS_MIN;
+	else if (gpirc_msgs_cnt(self) >= recs_size && recs_size < self->recs_max)
+		recs_size *= 2;
+
+	if (!buf_size) {
+		buf_size = BUF_MIN;
+	} else if (buf_size < self->buf_max) {
+		size_t need = self->buf_used + len;
+
+		while (need > buf_size / 2 && buf_size < self->buf_max)
+			buf_size *= 2;
+	}
+
+	while (len > buf_size)
+		buf_size *= 2;
+
+	if (recs_size == self->recs_size && buf_size == self->buf_size)
+		return 0;
+
+	return resize(self, recs_size, buf_size);
+}
+
+static int need_space(struct gpirc_msgs *self, size_t len)
+{
+	if (self->buf_tail + len > self->buf_size)
+		return 1;
+
+	/* Once at the limit a full record ring just evicts the oldest message */
+	return gpirc_msgs_cnt(self) >= self->recs_size && self->recs_size < self->recs_max;
+}
+
+struct gpirc_msg *gpirc_msgs_add_attrs(struct gpirc_msgs *self, enum gpirc_msg_type type,
+                                       time_t time, const char *sender,
+                                       const char *body, size_t len,
+                                       const void *attrs, size_t attrs_len)
+{
+	struct gpirc_str *s = NULL;
+	struct gpirc_msg *msg;
+	size_t size = len + 1 + attrs_len;
+
+	if (attrs_len > UINT16_MAX)
+		return NULL;
+
+	if ((!self->recs || need_space(self, size)) && maybe_grow(self, size))
+		return NULL;
+
+	if (sender) {
+		s = gpirc_str_intern(sender, strlen(sender));
+		if (!s)
+			return NULL;
+	}
+
+	if (gpirc_msgs_cnt(self) >= self->recs_size)
+		evict(self);
+
+	/*
+	 * Bodies are never split, wrap around if it does not fit. The oldest
+	 * messages past the current tail have to go first in that case.
+	 */
+	if (self->buf_tail + size > self->buf_size) {
+		while (self->head < self->tail &&
+		       gpirc_msgs_get(self, self->head)->off >= self->buf_tail)
+			evict(self);
+
+		self->buf_tail = 0;
+	}
+
+	/* Evict messages that occupy the space we are going to write to */
+	while (self->head < self->tail) {
+		size_t head_off = gpirc_msgs_get(self, self->head)->off;
+
+		if (head_off < self->buf_tail || head_off >= self->buf_tail + size)
+			break;
+
+		evict(self);
+	}
+
+	msg = &self->recs[self->tail & (self->recs_size - 1)];
+	self->tail++;
+
+	msg->time = time;
+	msg->sender = s;
+	msg->off = self->buf_tail;
+	msg->len = len;
+	msg->type = type;
+	msg->attrs_len = attrs_len;
+
+	if (body)
+		memcpy(self->buf + msg->off, body, len);
+
+	self->buf[msg->off + len] = 0;
+
+	if (attrs_len)
+		memcpy(self->buf + msg->off + len + 1, attrs, attrs_len);
+
+	self->buf_tail += size;
+	self->buf_used += size;
+
+	return msg;
+}
+
+int gpirc_msg_fmt(char *buf, size_t size, enum gpirc_msg_type type,
+                  const char *sender, const char *body, const char *chan)
+{
+	if (!sender)
+		sender = "";
+
+	switch (type) {
+	case GPIRC_MSG_PRIVMSG:
+		return snprintf(buf, size, "<%s> %s", sender, body);
+	case GPIRC_MSG_JOIN:
+		return snprintf(buf, size, "-!- %s [%s] has joined %s", sender, body, chan);
+	case GPIRC_MSG_PART:
+		return snprintf(buf, size, "-!- %s [%s] has left %s", sender, body, chan);
+	case GPIRC_MSG_INFO:
+	break;
+	}
+
+	return snprintf(buf, size, "%s", body);
+}
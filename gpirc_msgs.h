@@ -0,0 +1,161 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * Per channel message store.
+ *
+ * Messages are stored as compact records in a ring, the message bodies are
+ * stored in a contiguous byte ring and senders are interned strings shared
+ * between all channels. Both rings start small and grow up to a limit, after
+ * that the oldest messages are evicted.
+ *
+ * Nothing is formatted when a message is stored, the text is rendered only
+ * when it's about to be shown.
+ */
+
+#ifndef GPIRC_MSGS_H__
+#define GPIRC_MSGS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+struct gpirc_str {
+	uint32_t refcnt;
+	uint32_t hash;
+	uint32_t len;
+	char str[];
+};
+
+/*
+ * Returns interned string with an incremented reference counter or NULL on
+ * allocation failure.
+ */
+struct gpirc_str *gpirc_str_intern(const char *str, size_t len);
+
+void gpirc_str_unref(struct gpirc_str *self);
+
+enum gpirc_msg_type {
+	/* Preformatted informational message */
+	GPIRC_MSG_INFO,
+	/* Channel message, body is the text */
+	GPIRC_MSG_PRIVMSG,
+	/* Channel join, body is the nick!user@host */
+	GPIRC_MSG_JOIN,
+	/* Channel part, body is the nick!user@host */
+	GPIRC_MSG_PART,
+};
+
+struct gpirc_msg {
+	time_t time;
+	struct gpirc_str *sender;
+	/* Body offset in the byte ring */
+	uint32_t off;
+	/* Body length without the null terminator */
+	uint32_t len;
+	uint8_t type;
+	/* Size of the attributes stored after the body null terminator */
+	uint16_t attrs_len;
+};
+
+struct gpirc_msgs {
+	/* Record ring, power of two */
+	struct gpirc_msg *recs;
+	size_t recs_size;
+	size_t recs_max;
+
+	/* Id of the oldest message and id of next message */
+	uint64_t head;
+	uint64_t tail;
+
+	/* Body ring */
+	char *buf;
+	size_t buf_size;
+	size_t buf_max;
+	size_t buf_tail;
+	/* Bytes taken by the stored messages */
+	size_t buf_used;
+};
+
+static inline void gpirc_msgs_init(struct gpirc_msgs *self, size_t recs_max, size_t buf_max)
+{
+	*self = (struct gpirc_msgs) {
+		.recs_max = recs_max,
+		.buf_max = buf_max,
+	};
+}
+
+void gpirc_msgs_free(struct gpirc_msgs *self);
+
+/*
+ * Stores a message.
+ *
+ * @type A message type.
+ * @time A message timestamp.
+ * @sender A sender nick, may be NULL.
+ * @body A message body, may be NULL in which case the space is reserved and
+ *       has to be filled in by the caller with gpirc_msg_body().
+ * @len A message body length.
+ * @attrs Opaque attributes stored along with the body, e.g. text style spans.
+ * @attrs_len Size of the attributes, zero if there are none.
+ *
+ * @return Newly stored message or NULL on allocation failure.
+ */
+struct gpirc_msg *gpirc_msgs_add_attrs(struct gpirc_msgs *self, enum gpirc_msg_type type,
+                                       time_t time, const char *sender,
+                                       const char *body, size_t len,
+                                       const void *attrs, size_t attrs_len);
+
+static inline struct gpirc_msg *gpirc_msgs_add(struct gpirc_msgs *self, enum gpirc_msg_type type,
+                                               time_t time, const char *sender,
+                                               const char *body, size_t len)
+{
+	return gpirc_msgs_add_attrs(self, type, time, sender, body, len, NULL, 0);
+}
+
+/*
+ * Returns a message by id or NULL if it was evicted or not stored yet.
+ */
+static inline struct gpirc_msg *gpirc_msgs_get(struct gpirc_msgs *self, uint64_t id)
+{
+	if (id < self->head || id >= self->tail)
+		return NULL;
+
+	return &self->recs[id & (self->recs_size - 1)];
+}
+
+static inline char *gpirc_msg_body(struct gpirc_msgs *self, struct gpirc_msg *msg)
+{
+	return self->buf + msg->off;
+}
+
+/*
+ * Returns the msg->attrs_len bytes of attributes, the pointer is not aligned.
+ */
+static inline const void *gpirc_msg_attrs(struct gpirc_msgs *self, struct gpirc_msg *msg)
+{
+	return self->buf + msg->off + msg->len + 1;
+}
+
+static inline size_t gpirc_msgs_cnt(struct gpirc_msgs *self)
+{
+	return self->tail - self->head;
+}
+
+/*
+ * Formats a message into a text line.
+ *
+ * @sender A sender nick, may be NULL.
+ * @chan A channel name the message belongs to.
+ *
+ * @return Length of the line, the same as snprintf().
+ */
+int gpirc_msg_fmt(char *buf, size_t size, enum gpirc_msg_type type,
+                  const char *sender, const char *body, const char *chan);
+
+#endif /* GPIRC_MSGS_H__ */
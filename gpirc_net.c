@@ -0,0 +1,1217 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "gpirc_ring.h"
+#include "gpirc_time.h"
+#include "gpirc_capture.h"
+#include "gpirc_stats.h"
+#include "gpirc_net.h"
+
+#define EV_RING_SIZE 256
+#define CMD_RING_SIZE 256
+
+/* Lines shorter than that are stored in the event, longer ones are allocated */
+#define EV_BUF 1024
+
+/* IRCv3 allows 8191 bytes of tags on top of the 512 bytes RFC1459 line */
+#define IN_LINE_MAX (8191 + 512)
+#define IN_BUF 16384
+#define OUT_BUF 16384
+
+/* Maximal number of events dispatched before we let the UI breathe */
+#define EVS_PER_PROCESS 256
+
+enum ev_type {
+	EV_MSG,
+	EV_DISCONNECTED,
+};
+
+struct net_ev {
+	struct net_ev *next;
+	struct gpirc_net_sess *sess;
+	uint64_t recv_ns;
+	uint8_t type;
+	/* The parsed line or the disconnect reason, points to buf for short lines */
+	char *line;
+	struct gpirc_proto_msg msg;
+	char buf[EV_BUF];
+};
+
+enum cmd_type {
+	CMD_RAW,
+	CMD_CONNECT,
+	CMD_DISCONNECT,
+	CMD_FLOOD,
+	CMD_PING,
+	CMD_EXIT,
+};
+
+struct net_cmd {
+	uint8_t type;
+	uint8_t prio;
+	int port;
+	unsigned int burst;
+	unsigned int interval_ms;
+	struct gpirc_net_sess *sess;
+	char buf[GPIRC_NET_CMD_MAX];
+};
+
+struct sendq_line {
+	struct sendq_line *next;
+	char buf[];
+};
+
+struct gpirc_net_sess {
+	void *ctx;
+	atomic_int connected;
+	atomic_uint queued;
+	atomic_int throttled;
+
+	/* Network thread state */
+	int active;
+	int fd;
+	uint32_t events;
+	/* Set until the non-blocking connect completes */
+	int connecting;
+	/* Set while the rest of a line that does not fit is being dropped */
+	int skip;
+
+	struct sendq_line *sendq_head[GPIRC_NET_PRIOS];
+	struct sendq_line **sendq_tail[GPIRC_NET_PRIOS];
+	unsigned int sendq_cnt;
+	/* Token bucket, the bucket is full once now reaches penalty_ns */
+	uint64_t penalty_ns;
+	uint64_t interval_ns;
+	unsigned int burst;
+
+	/* Received data, starts with an incomplete line if any */
+	size_t in_len;
+	char in[IN_BUF];
+	/* Lines waiting for the socket to become writable */
+	size_t out_len;
+	char out[OUT_BUF];
+};
+
+static struct gpirc_net_sess sessions[GPIRC_NET_MAX];
+static unsigned int sessions_cnt;
+
+static void (*ui_on_msg)(void *ctx, struct gpirc_proto_msg *msg);
+static void (*ui_on_disconnect)(void *ctx, const char *reason);
+
+/* Traffic counters, written by the network thread */
+static atomic_uint_fast64_t lines_in;
+static atomic_uint_fast64_t bytes_in;
+static atomic_uint_fast64_t lines_out;
+static atomic_uint_fast64_t bytes_out;
+
+static struct gpirc_ring ev_ring;
+static struct gpirc_ring cmd_ring;
+
+static int ui_efd = -1;
+static int net_efd = -1;
+
+/* Set when the network thread waits for free ring slots */
+static atomic_int overflow_wait;
+
+static pthread_t net_thread;
+
+/* Network thread state */
+static int epfd = -1;
+static struct gpirc_net_sess *active[GPIRC_NET_MAX];
+static unsigned int active_cnt;
+static uint64_t cur_recv_ns;
+static struct net_ev *overflow_head;
+static struct net_ev *overflow_tail;
+static int evs_produced;
+
+/* UI thread state */
+static uint64_t dispatch_recv_ns;
+
+static void efd_wake(int fd)
+{
+	uint64_t val = 1;
+
+	if (write(fd, &val, sizeof(val)) != sizeof(val))
+		return;
+}
+
+static void efd_clear(int fd)
+{
+	uint64_t val;
+
+	if (read(fd, &val, sizeof(val)) != sizeof(val))
+		return;
+}
+
+static void str_rebase(struct gpirc_proto_str *str, const char *from, size_t size, char *to)
+{
+	uintptr_t off = (uintptr_t)str->str - (uintptr_t)from;
+
+	/* The empty spans point to a static string */
+	if (off <= size)
+		str->str = to + off;
+}
+
+/*
+ * Moves the spans of a parsed line to a copy of the line.
+ */
+static void msg_rebase(struct gpirc_proto_msg *msg, const char *from, size_t size, char *to)
+{
+	unsigned int i;
+
+	str_rebase(&msg->tags, from, size, to);
+	str_rebase(&msg->nick, from, size, to);
+	str_rebase(&msg->mask, from, size, to);
+	str_rebase(&msg->cmd, from, size, to);
+
+	for (i = 0; i < msg->param_cnt; i++)
+		str_rebase(&msg->params[i], from, size, to);
+}
+
+/*
+ * Events that do not fit into the ring are queued on the network thread side,
+ * the ring order is preserved and the socket is not read until the queue is
+ * drained. The UI thread wakes us up once it has freed some slots.
+ */
+static void overflow_drain(void)
+{
+	while (overflow_head) {
+		struct net_ev *slot = gpirc_ring_prod_slot(&ev_ring);
+		struct net_ev *ev = overflow_head;
+
+		if (!slot)
+			return;
+
+		memcpy(slot, ev, sizeof(*ev));
+
+		if (ev->line == ev->buf) {
+			slot->line = slot->buf;
+
+			if (ev->type == EV_MSG)
+				msg_rebase(&slot->msg, ev->buf, EV_BUF, slot->buf);
+		}
+
+		gpirc_ring_prod_commit(&ev_ring);
+		evs_produced = 1;
+
+		overflow_head = ev->next;
+		if (!overflow_head)
+			overflow_tail = NULL;
+
+		free(ev);
+	}
+}
+
+static struct net_ev *ev_alloc(void)
+{
+	struct net_ev *ev = NULL;
+
+	if (!overflow_head)
+		ev = gpirc_ring_prod_slot(&ev_ring);
+
+	if (ev)
+		return ev;
+
+	ev = malloc(sizeof(*ev));
+	if (!ev)
+		return NULL;
+
+	ev->next = NULL;
+	atomic_store(&overflow_wait, 1);
+
+	if (overflow_tail)
+		overflow_tail->next = ev;
+	else
+		overflow_head = ev;
+
+	overflow_tail = ev;
+
+	return ev;
+}
+
+static void ev_commit(struct net_ev *ev)
+{
+	if (ev == overflow_tail)
+		return;
+
+	gpirc_ring_prod_commit(&ev_ring);
+	evs_produced = 1;
+}
+
+/*
+ * The line is parsed in place in the receive buffer, which is reused by the
+ * next read, so it's copied once into the event along with the spans.
+ */
+static void ev_push_msg(struct gpirc_net_sess *sess, const char *line, size_t len,
+                        const struct gpirc_proto_msg *msg)
+{
+	char *copy = NULL;
+	struct net_ev *ev;
+
+	if (len >= EV_BUF) {
+		copy = malloc(len + 1);
+		if (!copy)
+			return;
+	}
+
+	ev = ev_alloc();
+	if (!ev) {
+		free(copy);
+		return;
+	}
+
+	ev->sess = sess;
+	ev->recv_ns = cur_recv_ns;
+	ev->type = EV_MSG;
+	ev->line = copy ? copy : ev->buf;
+	ev->msg = *msg;
+
+	memcpy(ev->line, line, len + 1);
+	msg_rebase(&ev->msg, line, len, ev->line);
+
+	ev_commit(ev);
+}
+
+static void post_disconnected(struct gpirc_net_sess *sess, const char *reason)
+{
+	struct net_ev *ev = ev_alloc();
+
+	if (!ev)
+		return;
+
+	ev->sess = sess;
+	ev->recv_ns = cur_recv_ns;
+	ev->type = EV_DISCONNECTED;
+	ev->line = ev->buf;
+	snprintf(ev->buf, sizeof(ev->buf), "%s", reason);
+
+	ev_commit(ev);
+}
+
+/*
+ * Appends a line to the output buffer, the socket is written from the main
+ * loop.
+ *
+ * @return Zero on success, non-zero if there is no room for the line.
+ */
+static int out_line(struct gpirc_net_sess *sess, const char *line, size_t len)
+{
+	if (sess->out_len + len + 2 > OUT_BUF)
+		return 1;
+
+	memcpy(sess->out + sess->out_len, line, len);
+	memcpy(sess->out + sess->out_len + len, "\r\n", 2);
+	sess->out_len += len + 2;
+
+	atomic_fetch_add_explicit(&lines_out, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&bytes_out, len + 2, memory_order_relaxed);
+
+	return 0;
+}
+
+__attribute__((format(printf, 2, 3)))
+static int out_printf(struct gpirc_net_sess *sess, const char *fmt, ...)
+{
+	char buf[GPIRC_NET_CMD_MAX];
+	va_list args;
+	int len;
+
+	va_start(args, fmt);
+	len = vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+
+	if (len < 0 || (size_t)len >= sizeof(buf))
+		return 1;
+
+	return out_line(sess, buf, len);
+}
+
+static void sess_update(struct gpirc_net_sess *sess)
+{
+	uint32_t events = 0;
+
+	if (!overflow_head)
+		events |= EPOLLIN;
+
+	if (sess->connecting || sess->out_len)
+		events |= EPOLLOUT;
+
+	if (events == sess->events)
+		return;
+
+	struct epoll_event ev = {
+		.events = events,
+		.data.ptr = sess,
+	};
+
+	if (epoll_ctl(epfd, EPOLL_CTL_MOD, sess->fd, &ev))
+		return;
+
+	sess->events = events;
+}
+
+static void sendq_push(struct gpirc_net_sess *sess, enum gpirc_net_prio prio, const char *buf)
+{
+	size_t len = strlen(buf) + 1;
+	struct sendq_line *line = malloc(sizeof(*line) + len);
+
+	if (!line)
+		return;
+
+	line->next = NULL;
+	memcpy(line->buf, buf, len);
+
+	*sess->sendq_tail[prio] = line;
+	sess->sendq_tail[prio] = &line->next;
+
+	atomic_store_explicit(&sess->queued, ++sess->sendq_cnt, memory_order_relaxed);
+}
+
+static struct sendq_line *sendq_pop(struct gpirc_net_sess *sess)
+{
+	struct sendq_line *line;
+	int prio;
+
+	for (prio = 0; prio < GPIRC_NET_PRIOS; prio++) {
+		line = sess->sendq_head[prio];
+
+		if (!line)
+			continue;
+
+		sess->sendq_head[prio] = line->next;
+		if (!line->next)
+			sess->sendq_tail[prio] = &sess->sendq_head[prio];
+
+		atomic_store_explicit(&sess->queued, --sess->sendq_cnt, memory_order_relaxed);
+
+		return line;
+	}
+
+	return NULL;
+}
+
+static void sendq_clear(struct gpirc_net_sess *sess)
+{
+	struct sendq_line *line;
+
+	while ((line = sendq_pop(sess)))
+		free(line);
+
+	atomic_store_explicit(&sess->throttled, 0, memory_order_relaxed);
+}
+
+/*
+ * A token bucket in the RFC1459 penalty timer form. Each line sent moves the
+ * timer one interval ahead and lines are sent only while the timer is at most
+ * burst intervals ahead of now.
+ *
+ * @return Nanoseconds until the next line can be sent, zero if there is
+ *         nothing to send or the lines wait for the output buffer to drain.
+ */
+static uint64_t sendq_flush(struct gpirc_net_sess *sess, uint64_t now)
+{
+	uint64_t cap = sess->burst * sess->interval_ns;
+	struct sendq_line *line;
+
+	while (sess->sendq_cnt) {
+		if (sess->penalty_ns < now)
+			sess->penalty_ns = now;
+
+		if (sess->penalty_ns + sess->interval_ns > now + cap) {
+			atomic_store_explicit(&sess->throttled, 1, memory_order_relaxed);
+			return sess->penalty_ns + sess->interval_ns - now - cap;
+		}
+
+		/* Flushed again once the socket becomes writable */
+		if (sess->out_len + GPIRC_NET_CMD_MAX + 2 > OUT_BUF)
+			return 0;
+
+		line = sendq_pop(sess);
+		out_line(sess, line->buf, strlen(line->buf));
+		free(line);
+
+		sess->penalty_ns += sess->interval_ns;
+	}
+
+	atomic_store_explicit(&sess->throttled, 0, memory_order_relaxed);
+
+	return 0;
+}
+
+static void sess_deactivate(struct gpirc_net_sess *sess)
+{
+	unsigned int i;
+
+	sendq_clear(sess);
+
+	if (sess->fd >= 0) {
+		epoll_ctl(epfd, EPOLL_CTL_DEL, sess->fd, NULL);
+		close(sess->fd);
+		sess->fd = -1;
+	}
+
+	sess->events = 0;
+	sess->in_len = 0;
+	sess->out_len = 0;
+	atomic_store(&sess->connected, 0);
+
+	if (!sess->active)
+		return;
+
+	for (i = 0; i < active_cnt; i++) {
+		if (active[i] == sess) {
+			active[i] = active[--active_cnt];
+			break;
+		}
+	}
+
+	sess->active = 0;
+}
+
+static void sess_close(struct gpirc_net_sess *sess, const char *reason)
+{
+	post_disconnected(sess, reason);
+	sess_deactivate(sess);
+}
+
+/*
+ * PINGs are answered right here so that the server does not time us out
+ * while the UI thread is busy.
+ */
+static void sess_line(struct gpirc_net_sess *sess, char *line, size_t len)
+{
+	struct gpirc_proto_msg msg;
+
+	atomic_fetch_add_explicit(&lines_in, 1, memory_order_relaxed);
+
+	if (gpirc_proto_parse(line, &msg))
+		return;
+
+	if (!strcmp(msg.cmd.str, "PING")) {
+		out_printf(sess, "PONG :%s", msg.param_cnt ? msg.params[msg.param_cnt - 1].str : "");
+		return;
+	}
+
+	ev_push_msg(sess, line, len, &msg);
+}
+
+/*
+ * Splits the received data into lines, the last incomplete line is moved to
+ * the start of the buffer. A line that does not end within IN_LINE_MAX bytes
+ * is dropped.
+ *
+ * @return Non-zero if the session was closed.
+ */
+static int sess_read(struct gpirc_net_sess *sess)
+{
+	char *line = sess->in, *end, *in_end;
+	ssize_t ret;
+
+	ret = recv(sess->fd, sess->in + sess->in_len, IN_BUF - sess->in_len, 0);
+
+	if (ret < 0 && (errno == EAGAIN || errno == EINTR))
+		return 0;
+
+	if (ret <= 0) {
+		sess_close(sess, ret ? strerror(errno) : "Connection closed by server");
+		return 1;
+	}
+
+	atomic_fetch_add_explicit(&bytes_in, ret, memory_order_relaxed);
+
+	sess->in_len += ret;
+	in_end = sess->in + sess->in_len;
+
+	while ((end = memchr(line, '\n', in_end - line))) {
+		size_t len = end - line;
+
+		if (sess->skip || len > IN_LINE_MAX) {
+			sess->skip = 0;
+		} else {
+			if (len && line[len - 1] == '\r')
+				len--;
+
+			line[len] = 0;
+			sess_line(sess, line, len);
+		}
+
+		line = end + 1;
+	}
+
+	sess->in_len = in_end - line;
+
+	if (sess->in_len > IN_LINE_MAX) {
+		sess->skip = 1;
+		sess->in_len = 0;
+	}
+
+	memmove(sess->in, line, sess->in_len);
+
+	return 0;
+}
+
+/*
+ * @return Non-zero if the session was closed.
+ */
+static int sess_write(struct gpirc_net_sess *sess)
+{
+	ssize_t ret;
+
+	ret = send(sess->fd, sess->out, sess->out_len, MSG_NOSIGNAL);
+
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 0;
+
+		sess_close(sess, strerror(errno));
+		return 1;
+	}
+
+	sess->out_len -= ret;
+	memmove(sess->out, sess->out + ret, sess->out_len);
+
+	return 0;
+}
+
+static void sess_process(struct gpirc_net_sess *sess, uint32_t revents)
+{
+	if (sess->connecting) {
+		socklen_t len = sizeof(int);
+		int err;
+
+		if (getsockopt(sess->fd, SOL_SOCKET, SO_ERROR, &err, &len))
+			err = errno;
+
+		if (err) {
+			sess_close(sess, strerror(err));
+			return;
+		}
+
+		sess->connecting = 0;
+	}
+
+	if ((revents & (EPOLLIN | EPOLLERR | EPOLLHUP)) && sess_read(sess))
+		return;
+
+	if (sess->out_len)
+		sess_write(sess);
+}
+
+/*
+ * Starts a non-blocking connect to the first address that does not fail
+ * right away.
+ *
+ * @return A socket or -1 with the reason in err.
+ */
+static int sock_connect(const char *server, int port, const char **err)
+{
+	struct addrinfo *res, *ai, hints = {
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM,
+	};
+	char port_str[16];
+	int fd = -1, ret;
+
+	snprintf(port_str, sizeof(port_str), "%i", port);
+
+	ret = getaddrinfo(server, port_str, &hints, &res);
+	if (ret) {
+		*err = gai_strerror(ret);
+		return -1;
+	}
+
+	*err = "No address";
+
+	for (ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+		            ai->ai_protocol);
+		if (fd < 0)
+			continue;
+
+		if (!connect(fd, ai->ai_addr, ai->ai_addrlen) || errno == EINPROGRESS)
+			break;
+
+		*err = strerror(errno);
+		close(fd);
+		fd = -1;
+	}
+
+	freeaddrinfo(res);
+
+	return fd;
+}
+
+/*
+ * The registration is queued into the output buffer before the connect
+ * completes. CAP LS goes first so that the server holds the registration until
+ * we end the negotiation with CAP END.
+ */
+static void do_connect(struct net_cmd *cmd)
+{
+	struct gpirc_net_sess *sess = cmd->sess;
+	const char *server = cmd->buf;
+	const char *nick = server + strlen(server) + 1;
+	const char *err;
+	int fd;
+
+	sess_deactivate(sess);
+	sess->penalty_ns = 0;
+	sess->skip = 0;
+
+	/* libircclient used to talk TLS to servers prefixed with '#' */
+	if (server[0] == '#') {
+		post_disconnected(sess, "TLS is not supported");
+		return;
+	}
+
+	fd = sock_connect(server, cmd->port, &err);
+	if (fd < 0) {
+		post_disconnected(sess, err);
+		return;
+	}
+
+	struct epoll_event ev = {
+		.events = EPOLLOUT,
+		.data.ptr = sess,
+	};
+
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev)) {
+		close(fd);
+		post_disconnected(sess, strerror(errno));
+		return;
+	}
+
+	sess->fd = fd;
+	sess->events = EPOLLOUT;
+	sess->connecting = 1;
+
+	out_printf(sess, "CAP LS 302");
+	out_printf(sess, "NICK %s", nick);
+	out_printf(sess, "USER %s 0 * :%s", nick, nick);
+
+	atomic_store(&sess->connected, 1);
+	active[active_cnt++] = sess;
+	sess->active = 1;
+}
+
+/*
+ * Lag probes skip the queues so that the measurement does not include the
+ * time spent there, the line still counts against the token bucket.
+ */
+static void do_ping(struct gpirc_net_sess *sess)
+{
+	if (!sess->active || sess->connecting)
+		return;
+
+	out_printf(sess, "PING :%s%llu", GPIRC_NET_PING_TOKEN,
+	           (unsigned long long)gpirc_monotonic_ns());
+
+	sess->penalty_ns += sess->interval_ns;
+}
+
+/*
+ * Returns non-zero if the thread should exit.
+ */
+static int process_cmds(void)
+{
+	struct net_cmd *cmd;
+
+	while ((cmd = gpirc_ring_cons_slot(&cmd_ring))) {
+		switch (cmd->type) {
+		case CMD_RAW:
+			if (cmd->sess->active)
+				sendq_push(cmd->sess, cmd->prio, cmd->buf);
+		break;
+		case CMD_CONNECT:
+			do_connect(cmd);
+		break;
+		case CMD_DISCONNECT:
+			if (cmd->sess->active)
+				sess_close(cmd->sess, cmd->buf);
+		break;
+		case CMD_PING:
+			do_ping(cmd->sess);
+		break;
+		case CMD_FLOOD:
+			cmd->sess->burst = cmd->burst ? cmd->burst : 1;
+			cmd->sess->interval_ns = cmd->interval_ms * 1000000ull;
+		break;
+		case CMD_EXIT:
+			gpirc_ring_cons_release(&cmd_ring);
+			return 1;
+		}
+
+		gpirc_ring_cons_release(&cmd_ring);
+	}
+
+	return 0;
+}
+
+/*
+ * Moves queued lines the flood control allows to the output buffers, writes
+ * them out and returns epoll timeout.
+ *
+ * The sessions are walked backwards since a failed write removes the session
+ * from the active array by moving the last one in its place.
+ */
+static int sendq_flush_all(void)
+{
+	uint64_t wait, min_wait = UINT64_MAX, now = gpirc_monotonic_ns();
+	unsigned int i;
+
+	for (i = active_cnt; i-- > 0;) {
+		struct gpirc_net_sess *sess = active[i];
+
+		wait = sendq_flush(sess, now);
+
+		if (wait && wait < min_wait)
+			min_wait = wait;
+
+		if (sess->out_len && !sess->connecting && sess_write(sess))
+			continue;
+
+		sess_update(sess);
+	}
+
+	if (min_wait == UINT64_MAX)
+		return -1;
+
+	return (min_wait + 999999) / 1000000;
+}
+
+static void *net_thread_main(void *arg)
+{
+	struct epoll_event evs[GPIRC_NET_MAX + 1];
+	unsigned int i;
+	int cnt, timeout, quit = 0;
+
+	(void) arg;
+
+	while (!quit) {
+		timeout = sendq_flush_all();
+
+		cnt = epoll_wait(epfd, evs, sizeof(evs)/sizeof(*evs), timeout);
+		if (cnt < 0)
+			continue;
+
+		cur_recv_ns = gpirc_monotonic_ns();
+		evs_produced = 0;
+
+		overflow_drain();
+
+		for (i = 0; i < (unsigned int)cnt; i++) {
+			struct gpirc_net_sess *sess = evs[i].data.ptr;
+
+			if (!sess) {
+				efd_clear(net_efd);
+				quit = process_cmds();
+				continue;
+			}
+
+			/* Could have been disconnected by a command in this round */
+			if (sess->active && sess->fd >= 0)
+				sess_process(sess, evs[i].events);
+		}
+
+		if (evs_produced)
+			efd_wake(ui_efd);
+	}
+
+	while (active_cnt)
+		sess_deactivate(active[0]);
+
+	return NULL;
+}
+
+int gpirc_net_init(void (*on_msg)(void *ctx, struct gpirc_proto_msg *msg),
+                   void (*on_disconnect)(void *ctx, const char *reason))
+{
+	struct epoll_event ev = {
+		.events = EPOLLIN,
+		.data.ptr = NULL,
+	};
+
+	ui_on_msg = on_msg;
+	ui_on_disconnect = on_disconnect;
+
+	if (gpirc_ring_init(&ev_ring, EV_RING_SIZE, sizeof(struct net_ev)))
+		return 1;
+
+	if (gpirc_ring_init(&cmd_ring, CMD_RING_SIZE, sizeof(struct net_cmd)))
+		goto err0;
+
+	ui_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (ui_efd < 0)
+		goto err1;
+
+	net_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (net_efd < 0)
+		goto err2;
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0)
+		goto err3;
+
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, net_efd, &ev))
+		goto err4;
+
+	if (pthread_create(&net_thread, NULL, net_thread_main, NULL))
+		goto err4;
+
+	return 0;
+err4:
+	close(epfd);
+err3:
+	close(net_efd);
+err2:
+	close(ui_efd);
+err1:
+	gpirc_ring_exit(&cmd_ring);
+err0:
+	gpirc_ring_exit(&ev_ring);
+	return 1;
+}
+
+struct gpirc_net_sess *gpirc_net_session_new(void *ctx)
+{
+	struct gpirc_net_sess *sess;
+	int i;
+
+	if (sessions_cnt >= GPIRC_NET_MAX)
+		return NULL;
+
+	sess = &sessions[sessions_cnt];
+
+	sess->ctx = ctx;
+	atomic_init(&sess->connected, 0);
+	atomic_init(&sess->queued, 0);
+	atomic_init(&sess->throttled, 0);
+	sess->active = 0;
+	sess->fd = -1;
+	sess->events = 0;
+	sess->burst = GPIRC_NET_BURST;
+	sess->interval_ns = GPIRC_NET_INTERVAL_MS * 1000000ull;
+
+	for (i = 0; i < GPIRC_NET_PRIOS; i++)
+		sess->sendq_tail[i] = &sess->sendq_head[i];
+
+	sessions_cnt++;
+
+	return sess;
+}
+
+static struct net_cmd *cmd_slot(enum cmd_type type, struct gpirc_net_sess *sess)
+{
+	struct net_cmd *cmd = gpirc_ring_prod_slot(&cmd_ring);
+
+	if (!cmd)
+		return NULL;
+
+	cmd->type = type;
+	cmd->sess = sess;
+
+	return cmd;
+}
+
+static void cmd_commit(void)
+{
+	gpirc_ring_prod_commit(&cmd_ring);
+	efd_wake(net_efd);
+}
+
+static int cmd_push(enum cmd_type type, struct gpirc_net_sess *sess, int port,
+                    const char *buf, size_t len)
+{
+	struct net_cmd *cmd;
+
+	if (len > sizeof(cmd->buf))
+		return 1;
+
+	cmd = cmd_slot(type, sess);
+	if (!cmd)
+		return 1;
+
+	cmd->port = port;
+	memcpy(cmd->buf, buf, len);
+
+	cmd_commit();
+
+	return 0;
+}
+
+void gpirc_net_exit(void)
+{
+	struct net_ev *ev;
+
+	if (net_efd < 0)
+		return;
+
+	while (cmd_push(CMD_EXIT, NULL, 0, "", 0))
+		usleep(1000);
+
+	pthread_join(net_thread, NULL);
+
+	close(epfd);
+	close(net_efd);
+	close(ui_efd);
+	epfd = net_efd = ui_efd = -1;
+
+	while ((ev = gpirc_ring_cons_slot(&ev_ring))) {
+		if (ev->line != ev->buf)
+			free(ev->line);
+
+		gpirc_ring_cons_release(&ev_ring);
+	}
+
+	gpirc_ring_exit(&cmd_ring);
+	gpirc_ring_exit(&ev_ring);
+
+	sessions_cnt = 0;
+}
+
+int gpirc_net_fd(void)
+{
+	return ui_efd;
+}
+
+uint64_t gpirc_net_recv_ns(void)
+{
+	return dispatch_recv_ns;
+}
+
+/* Capture of messages of a single session, UI thread only */
+static FILE *rec_file;
+static struct gpirc_net_sess *rec_sess;
+static uint64_t rec_start_ns;
+
+int gpirc_net_record(struct gpirc_net_sess *sess, const char *path, const char *nick)
+{
+	if (rec_file) {
+		fclose(rec_file);
+		rec_file = NULL;
+		rec_sess = NULL;
+	}
+
+	if (!sess)
+		return 0;
+
+	rec_file = fopen(path, "w");
+	if (!rec_file)
+		return 1;
+
+	fprintf(rec_file, "# nick %s\n", nick);
+
+	rec_sess = sess;
+	rec_start_ns = gpirc_monotonic_ns();
+
+	return 0;
+}
+
+static void ev_record(struct net_ev *ev)
+{
+	uint64_t time_ns = ev->recv_ns > rec_start_ns ? ev->recv_ns - rec_start_ns : 0;
+
+	switch (ev->type) {
+	case EV_MSG:
+		gpirc_capture_write(rec_file, time_ns, &ev->msg);
+	break;
+	case EV_DISCONNECTED:
+		fprintf(rec_file, "# disconnected %s\n", ev->line);
+	break;
+	}
+}
+
+static void ev_dispatch(struct net_ev *ev)
+{
+	if (rec_file && ev->sess == rec_sess)
+		ev_record(ev);
+
+	dispatch_recv_ns = ev->recv_ns;
+
+	switch (ev->type) {
+	case EV_MSG: {
+		const char *cmd = ev->msg.cmd.str;
+		unsigned int numeric = ev->msg.numeric;
+		uint64_t start = gpirc_monotonic_ns();
+
+		ui_on_msg(ev->sess->ctx, &ev->msg);
+
+		if (numeric)
+			gpirc_stats_numeric(numeric, gpirc_monotonic_ns() - start);
+		else
+			gpirc_stats_event(cmd, gpirc_monotonic_ns() - start);
+	} break;
+	case EV_DISCONNECTED:
+		if (ui_on_disconnect)
+			ui_on_disconnect(ev->sess->ctx, ev->line);
+	break;
+	}
+
+	dispatch_recv_ns = 0;
+
+	if (ev->line != ev->buf)
+		free(ev->line);
+}
+
+void gpirc_net_process(void)
+{
+	struct net_ev *ev;
+	int i;
+
+	efd_clear(ui_efd);
+
+	for (i = 0; i < EVS_PER_PROCESS; i++) {
+		ev = gpirc_ring_cons_slot(&ev_ring);
+		if (!ev)
+			break;
+
+		ev_dispatch(ev);
+		gpirc_ring_cons_release(&ev_ring);
+	}
+
+	if (i && atomic_exchange(&overflow_wait, 0))
+		efd_wake(net_efd);
+
+	/* More events pending, get back to them after the UI had its turn */
+	if (i == EVS_PER_PROCESS && gpirc_ring_cons_slot(&ev_ring))
+		efd_wake(ui_efd);
+}
+
+int gpirc_net_connect(struct gpirc_net_sess *sess, const char *server, int port,
+                      const char *nick)
+{
+	char buf[1024];
+	int len;
+
+	len = snprintf(buf, sizeof(buf), "%s%c%s", server, 0, nick);
+	if (len < 0 || (size_t)len >= sizeof(buf))
+		return 1;
+
+	return cmd_push(CMD_CONNECT, sess, port, buf, len + 1);
+}
+
+int gpirc_net_disconnect(struct gpirc_net_sess *sess, const char *reason)
+{
+	return cmd_push(CMD_DISCONNECT, sess, 0, reason, strlen(reason) + 1);
+}
+
+int gpirc_net_ping(struct gpirc_net_sess *sess)
+{
+	struct net_cmd *cmd = cmd_slot(CMD_PING, sess);
+
+	if (!cmd)
+		return 1;
+
+	cmd_commit();
+
+	return 0;
+}
+
+uint64_t gpirc_net_pong_ns(const char *token)
+{
+	size_t len = strlen(GPIRC_NET_PING_TOKEN);
+
+	if (strncmp(token, GPIRC_NET_PING_TOKEN, len))
+		return 0;
+
+	return strtoull(token + len, NULL, 10);
+}
+
+int gpirc_net_connected(struct gpirc_net_sess *sess)
+{
+	return atomic_load(&sess->connected);
+}
+
+int gpirc_net_flood_set(struct gpirc_net_sess *sess, unsigned int burst,
+                        unsigned int interval_ms)
+{
+	struct net_cmd *cmd = cmd_slot(CMD_FLOOD, sess);
+
+	if (!cmd)
+		return 1;
+
+	cmd->burst = burst;
+	cmd->interval_ms = interval_ms;
+
+	cmd_commit();
+
+	return 0;
+}
+
+void gpirc_net_sendq(struct gpirc_net_sess *sess, struct gpirc_net_sendq *sendq)
+{
+	sendq->queued = atomic_load_explicit(&sess->queued, memory_order_relaxed);
+	sendq->throttled = atomic_load_explicit(&sess->throttled, memory_order_relaxed);
+}
+
+void gpirc_net_stats(struct gpirc_net_stats *stats)
+{
+	stats->lines_in = atomic_load_explicit(&lines_in, memory_order_relaxed);
+	stats->bytes_in = atomic_load_explicit(&bytes_in, memory_order_relaxed);
+	stats->lines_out = atomic_load_explicit(&lines_out, memory_order_relaxed);
+	stats->bytes_out = atomic_load_explicit(&bytes_out, memory_order_relaxed);
+}
+
+static int vsend(struct gpirc_net_sess *sess, enum gpirc_net_prio prio,
+                 const char *fmt, va_list args)
+{
+	struct net_cmd *cmd;
+	int len;
+
+	cmd = cmd_slot(CMD_RAW, sess);
+	if (!cmd)
+		return 1;
+
+	len = vsnprintf(cmd->buf, sizeof(cmd->buf), fmt, args);
+	if (len < 0 || (size_t)len >= sizeof(cmd->buf))
+		return 1;
+
+	cmd->prio = prio;
+
+	cmd_commit();
+
+	return 0;
+}
+
+int gpirc_net_send_prio(struct gpirc_net_sess *sess, enum gpirc_net_prio prio,
+                        const char *fmt, ...)
+{
+	va_list args;
+	int ret;
+
+	va_start(args, fmt);
+	ret = vsend(sess, prio, fmt, args);
+	va_end(args);
+
+	return ret;
+}
+
+int gpirc_net_send(struct gpirc_net_sess *sess, const char *fmt, ...)
+{
+	va_list args;
+	int ret;
+
+	va_start(args, fmt);
+	ret = vsend(sess, GPIRC_NET_INTERACTIVE, fmt, args);
+	va_end(args);
+
+	return ret;
+}
@@ -0,0 +1,208 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * Network thread.
+ *
+ * A dedicated thread does all the socket I/O, sockets of all sessions are
+ * multiplexed with a single epoll instance. Received data is split into lines
+ * in a per session buffer and each line is parsed in place by gpirc_proto.
+ * The line is then copied once, along with the spans, into a slot of a bounded
+ * lock-free ring and the message handler passed to gpirc_net_init() is called
+ * from gpirc_net_process() on the UI thread. Outgoing commands are passed the
+ * other way over a second ring and queued per session by priority, the queues
+ * are drained by a token bucket so that the server does not disconnect us for
+ * flooding.
+ *
+ * The registration starts with CAP LS, so that IRCv3 capabilities can be
+ * negotiated, followed by NICK and USER. Our nick is used as the user name
+ * and the real name as well.
+ */
+
+#ifndef GPIRC_NET_H__
+#define GPIRC_NET_H__
+
+#include <stdint.h>
+
+#include "gpirc_proto.h"
+
+/* Maximal number of sessions */
+#define GPIRC_NET_MAX 32
+
+/* Maximal length of a command passed to gpirc_net_send() including the terminator */
+#define GPIRC_NET_CMD_MAX 1024
+
+/* Default flood control, lines sent right away and one line per interval after */
+#define GPIRC_NET_BURST 5
+#define GPIRC_NET_INTERVAL_MS 1000
+
+/*
+ * Send queue priorities, a line is sent only when all queues with higher
+ * priority are empty.
+ *
+ * PING replies are sent by the network thread right away and never wait in
+ * the queues.
+ */
+enum gpirc_net_prio {
+	/* Connection management, e.g. nick changes during registration */
+	GPIRC_NET_URGENT,
+	/* Commands and messages typed by the user */
+	GPIRC_NET_INTERACTIVE,
+	/* Pastes, autojoin and scripts */
+	GPIRC_NET_BULK,
+	GPIRC_NET_PRIOS,
+};
+
+struct gpirc_net_sendq {
+	/* Lines waiting in the queues */
+	unsigned int queued;
+	/* Set while lines are held back by the flood control */
+	int throttled;
+};
+
+struct gpirc_net_stats {
+	uint64_t lines_in;
+	uint64_t bytes_in;
+	uint64_t lines_out;
+	uint64_t bytes_out;
+};
+
+struct gpirc_net_sess;
+
+/*
+ * Starts the network thread.
+ *
+ * @on_msg Called on the UI thread for each received line except for PING,
+ *         the message points into a buffer that is reused once it returns.
+ * @on_disconnect Called on the UI thread when connection failed or was closed.
+ *
+ * @return Zero on success.
+ */
+int gpirc_net_init(void (*on_msg)(void *ctx, struct gpirc_proto_msg *msg),
+                   void (*on_disconnect)(void *ctx, const char *reason));
+
+/*
+ * Stops the network thread and destroys all sessions.
+ */
+void gpirc_net_exit(void);
+
+/*
+ * Creates a new session.
+ *
+ * @ctx A context passed to the handlers.
+ *
+ * @return A session or NULL if we are out of sessions.
+ */
+struct gpirc_net_sess *gpirc_net_session_new(void *ctx);
+
+/*
+ * Returns file descriptor that becomes readable when there are events to be
+ * processed by gpirc_net_process().
+ */
+int gpirc_net_fd(void);
+
+/*
+ * Dispatches pending messages to the handlers.
+ */
+void gpirc_net_process(void);
+
+/*
+ * Returns monotonic timestamp of the socket read the message that is being
+ * dispatched was received in.
+ */
+uint64_t gpirc_net_recv_ns(void);
+
+/*
+ * Starts recording lines received by a session into a capture file, see
+ * gpirc_capture.h. Only one session is recorded at a time.
+ *
+ * @session A session to record or NULL to stop the recording.
+ * @path A capture file path.
+ * @nick Our nick, stored in the capture.
+ *
+ * @return Zero on success.
+ */
+int gpirc_net_record(struct gpirc_net_sess *session, const char *path, const char *nick);
+
+/*
+ * Asks the network thread to connect to a server.
+ *
+ * @return Zero if the request was queued.
+ */
+int gpirc_net_connect(struct gpirc_net_sess *session, const char *server, int port,
+                      const char *nick);
+
+/*
+ * Closes the connection, the on_disconnect callback is called with the reason.
+ *
+ * @return Zero if the request was queued.
+ */
+int gpirc_net_disconnect(struct gpirc_net_sess *session, const char *reason);
+
+/* Prefix of the PING tokens sent by gpirc_net_ping() */
+#define GPIRC_NET_PING_TOKEN "gpirc-lag-"
+
+/*
+ * Sends a PING right away, bypassing the send queues. The token is the
+ * monotonic send time and the server PONG is passed to the message handler.
+ *
+ * @return Zero if the request was queued.
+ */
+int gpirc_net_ping(struct gpirc_net_sess *session);
+
+/*
+ * Returns the send time of a PING from its PONG token, compare it against
+ * gpirc_net_recv_ns() for the round trip.
+ *
+ * @return Monotonic timestamp in ns or zero if the token is not ours.
+ */
+uint64_t gpirc_net_pong_ns(const char *token);
+
+/*
+ * Returns non-zero if the session is connected or connecting.
+ */
+int gpirc_net_connected(struct gpirc_net_sess *session);
+
+/*
+ * Sets the session flood control.
+ *
+ * @burst Number of lines that can be sent at once.
+ * @interval_ms Time it takes to earn sending one more line.
+ *
+ * @return Zero if the request was queued.
+ */
+int gpirc_net_flood_set(struct gpirc_net_sess *session, unsigned int burst,
+                        unsigned int interval_ms);
+
+/*
+ * Returns the session send queue state.
+ */
+void gpirc_net_sendq(struct gpirc_net_sess *session, struct gpirc_net_sendq *sendq);
+
+/*
+ * Returns traffic counters summed over all sessions.
+ */
+void gpirc_net_stats(struct gpirc_net_stats *stats);
+
+/*
+ * Queues a raw IRC command, the line terminator is added automatically.
+ *
+ * @return Zero if the command was queued, non-zero if the queue is full or
+ *         the command too long.
+ */
+int gpirc_net_send_prio(struct gpirc_net_sess *session, enum gpirc_net_prio prio,
+                        const char *fmt, ...)
+	__attribute__((format(printf, 3, 4)));
+
+/*
+ * Queues a raw IRC command with the interactive priority.
+ */
+int gpirc_net_send(struct gpirc_net_sess *session, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+#endif /* GPIRC_NET_H__ */
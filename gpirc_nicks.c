@@ -0,0 +1,602 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "gpirc_nicks.h"
+
+static const struct prefix {
+	char prefix;
+	uint8_t flag;
+} prefixes[] = {
+	{'~', GPIRC_NICK_OWNER},
+	{'&', GPIRC_NICK_ADMIN},
+	{'@', GPIRC_NICK_OP},
+	{'%', GPIRC_NICK_HALFOP},
+	{'+', GPIRC_NICK_VOICE},
+};
+
+uint8_t gpirc_nick_prefix_flag(char c)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(prefixes)/sizeof(*prefixes); i++) {
+		if (prefixes[i].prefix == c)
+			return prefixes[i].flag;
+	}
+
+	return 0;
+}
+
+char gpirc_nick_prefix(uint8_t flags)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(prefixes)/sizeof(*prefixes); i++) {
+		if (prefixes[i].flag & flags)
+			return prefixes[i].prefix;
+	}
+
+	return ' ';
+}
+
+static uint32_t user_hash(struct gpirc_user *user)
+{
+	return ((uintptr_t)user >> 4) * 2654435761u;
+}
+
+static void sorted_invalidate(struct gpirc_nicks *self)
+{
+	free(self->sorted);
+	self->sorted = NULL;
+}
+
+/*
+ * Compares at most len characters of a nick with a prefix.
+ */
+static int prefix_cmp(const char *nick, const char *prefix, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		unsigned char a = gpirc_fold(nick[i]);
+		unsigned char b = gpirc_fold(prefix[i]);
+
+		if (a != b || !a)
+			return (int)a - (int)b;
+	}
+
+	return 0;
+}
+
+static void by_nick_drop(struct gpirc_nicks *self)
+{
+	free(self->by_nick);
+	self->by_nick = NULL;
+	self->by_nick_cnt = 0;
+	self->by_nick_size = 0;
+}
+
+static int by_nick_cmp(const void *a, const void *b)
+{
+	const struct gpirc_member *ma = *(const struct gpirc_member **)a;
+	const struct gpirc_member *mb = *(const struct gpirc_member **)b;
+
+	return gpirc_nick_cmp(ma->user->nick, mb->user->nick);
+}
+
+static int by_nick_build(struct gpirc_nicks *self)
+{
+	size_t i, j = 0;
+
+	self->by_nick = malloc(sizeof(struct gpirc_member *) * (self->cnt + 16));
+	if (!self->by_nick)
+		return 1;
+
+	for (i = 0; i < self->size; i++) {
+		if (self->slots[i])
+			self->by_nick[j++] = self->slots[i];
+	}
+
+	qsort(self->by_nick, j, sizeof(struct gpirc_member *), by_nick_cmp);
+
+	self->by_nick_cnt = j;
+	self->by_nick_size = self->cnt + 16;
+
+	return 0;
+}
+
+/*
+ * Returns index of the first member that is not sorted before the prefix.
+ */
+static size_t by_nick_lower(struct gpirc_nicks *self, const char *prefix, size_t len)
+{
+	size_t lo = 0, hi = self->by_nick_cnt;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (prefix_cmp(self->by_nick[mid]->user->nick, prefix, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static void by_nick_ins(struct gpirc_nicks *self, struct gpirc_member *member)
+{
+	const char *nick = member->user->nick;
+	size_t i;
+
+	if (!self->by_nick)
+		return;
+
+	if (self->by_nick_cnt >= self->by_nick_size) {
+		size_t new_size = 2 * self->by_nick_size;
+		struct gpirc_member **tmp;
+
+		tmp = realloc(self->by_nick, sizeof(struct gpirc_member *) * new_size);
+		if (!tmp) {
+			/* Built again on the next completion */
+			by_nick_drop(self);
+			return;
+		}
+
+		self->by_nick = tmp;
+		self->by_nick_size = new_size;
+	}
+
+	i = by_nick_lower(self, nick, strlen(nick) + 1);
+
+	memmove(self->by_nick + i + 1, self->by_nick + i,
+	        sizeof(struct gpirc_member *) * (self->by_nick_cnt - i));
+
+	self->by_nick[i] = member;
+	self->by_nick_cnt++;
+}
+
+static void by_nick_del(struct gpirc_nicks *self, struct gpirc_member *member)
+{
+	const char *nick = member->user->nick;
+	size_t i;
+
+	if (!self->by_nick)
+		return;
+
+	/* A stale user may share the nick, see gpirc_users_rename() */
+	for (i = by_nick_lower(self, nick, strlen(nick) + 1); i < self->by_nick_cnt; i++) {
+		if (self->by_nick[i] == member)
+			break;
+	}
+
+	if (i >= self->by_nick_cnt)
+		return;
+
+	self->by_nick_cnt--;
+
+	memmove(self->by_nick + i, self->by_nick + i + 1,
+	        sizeof(struct gpirc_member *) * (self->by_nick_cnt - i));
+}
+
+static int spoke_linked(struct gpirc_nicks *self, struct gpirc_member *member)
+{
+	return member->spoke_prev || self->spoke == member;
+}
+
+static void spoke_unlink(struct gpirc_nicks *self, struct gpirc_member *member)
+{
+	if (!spoke_linked(self, member))
+		return;
+
+	if (member->spoke_prev)
+		member->spoke_prev->spoke_next = member->spoke_next;
+	else
+		self->spoke = member->spoke_next;
+
+	if (member->spoke_next)
+		member->spoke_next->spoke_prev = member->spoke_prev;
+
+	member->spoke_prev = NULL;
+	member->spoke_next = NULL;
+}
+
+static void member_unlink(struct gpirc_member *member)
+{
+	struct gpirc_user *user = member->user;
+
+	if (member->user_prev)
+		member->user_prev->user_next = member->user_next;
+	else
+		user->members = member->user_next;
+
+	if (member->user_next)
+		member->user_next->user_prev = member->user_prev;
+}
+
+void gpirc_nicks_free(struct gpirc_nicks *self)
+{
+	size_t i;
+
+	for (i = 0; i < self->size; i++) {
+		struct gpirc_member *member = self->slots[i];
+
+		if (!member)
+			continue;
+
+		member_unlink(member);
+		gpirc_users_unref(self->users, member->user);
+	}
+
+	free(self->slots);
+	gpirc_slab_destroy(&self->slab);
+	sorted_invalidate(self);
+	by_nick_drop(self);
+	self->spoke = NULL;
+
+	self->slots = NULL;
+	self->size = 0;
+	self->cnt = 0;
+}
+
+static size_t slot_find(struct gpirc_nicks *self, struct gpirc_user *user)
+{
+	size_t mask = self->size - 1;
+	size_t i = user_hash(user) & mask;
+
+	for (;;) {
+		struct gpirc_member *member = self->slots[i];
+
+		if (!member || member->user == user)
+			return i;
+
+		i = (i + 1) & mask;
+	}
+}
+
+static int resize(struct gpirc_nicks *self, size_t new_size)
+{
+	struct gpirc_member **old_slots = self->slots;
+	size_t i, old_size = self->size;
+
+	self->slots = calloc(new_size, sizeof(struct gpirc_member *));
+	if (!self->slots) {
+		self->slots = old_slots;
+		return 1;
+	}
+
+	self->size = new_size;
+
+	for (i = 0; i < old_size; i++) {
+		struct gpirc_member *member = old_slots[i];
+
+		if (member)
+			self->slots[slot_find(self, member->user)] = member;
+	}
+
+	free(old_slots);
+
+	return 0;
+}
+
+static int grow(struct gpirc_nicks *self)
+{
+	return resize(self, self->size ? 2 * self->size : 64);
+}
+
+int gpirc_nicks_reserve(struct gpirc_nicks *self, size_t cnt)
+{
+	size_t new_size = self->size ? self->size : 64;
+
+	while (new_size < 2 * cnt)
+		new_size *= 2;
+
+	if (new_size == self->size)
+		return 0;
+
+	return resize(self, new_size);
+}
+
+static struct gpirc_member **lookup(struct gpirc_nicks *self, struct gpirc_user *user)
+{
+	struct gpirc_member **slot;
+
+	if (!self->cnt || !user)
+		return NULL;
+
+	slot = &self->slots[slot_find(self, user)];
+
+	return *slot ? slot : NULL;
+}
+
+struct gpirc_member *gpirc_nicks_add(struct gpirc_nicks *self, const char *nick, size_t len)
+{
+	struct gpirc_member **slot, *member;
+	struct gpirc_user *user;
+	uint8_t flags = 0, flag;
+
+	while (len && (flag = gpirc_nick_prefix_flag(*nick))) {
+		flags |= flag;
+		nick++;
+		len--;
+	}
+
+	if (!len)
+		return NULL;
+
+	/* Keep load factor under 1/2 */
+	if (2 * (self->cnt + 1) > self->size && grow(self))
+		return NULL;
+
+	user = gpirc_users_ref(self->users, nick, len);
+	if (!user)
+		return NULL;
+
+	slot = &self->slots[slot_find(self, user)];
+
+	if (*slot) {
+		gpirc_users_unref(self->users, user);
+		(*slot)->flags = flags;
+		(*slot)->gen = self->gen;
+		sorted_invalidate(self);
+		return *slot;
+	}
+
+	member = gpirc_slab_alloc(&self->slab);
+	if (!member) {
+		gpirc_users_unref(self->users, user);
+		return NULL;
+	}
+
+	member->user = user;
+	member->nicks = self;
+	member->flags = flags;
+	member->gen = self->gen;
+	member->user_prev = NULL;
+	member->user_next = user->members;
+	if (user->members)
+		user->members->user_prev = member;
+	user->members = member;
+	member->spoke_prev = NULL;
+	member->spoke_next = NULL;
+
+	*slot = member;
+	self->cnt++;
+
+	sorted_invalidate(self);
+	by_nick_ins(self, member);
+
+	return member;
+}
+
+struct gpirc_member *gpirc_nicks_get(struct gpirc_nicks *self, const char *nick)
+{
+	struct gpirc_member **slot;
+
+	slot = lookup(self, gpirc_users_get(self->users, nick));
+
+	return slot ? *slot : NULL;
+}
+
+int gpirc_nicks_mode(struct gpirc_nicks *self, const char *nick, uint8_t flag, int set)
+{
+	struct gpirc_member *member = gpirc_nicks_get(self, nick);
+
+	if (!member)
+		return 1;
+
+	if (set)
+		member->flags |= flag;
+	else
+		member->flags &= ~flag;
+
+	sorted_invalidate(self);
+
+	return 0;
+}
+
+/*
+ * Backward shift deletion, moves entries from the probe sequence into the
+ * hole so that no tombstones are needed.
+ */
+static void slot_del(struct gpirc_nicks *self, struct gpirc_member **slot)
+{
+	size_t mask = self->size - 1;
+	size_t i = slot - self->slots;
+	size_t j = i;
+
+	for (;;) {
+		size_t k;
+
+		j = (j + 1) & mask;
+
+		if (!self->slots[j])
+			break;
+
+		k = user_hash(self->slots[j]->user) & mask;
+
+		if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+
+		self->slots[i] = self->slots[j];
+		i = j;
+	}
+
+	self->slots[i] = NULL;
+	self->cnt--;
+
+	sorted_invalidate(self);
+}
+
+void gpirc_nicks_del(struct gpirc_nicks *self, struct gpirc_member *member)
+{
+	struct gpirc_member **slot = lookup(self, member->user);
+
+	if (!slot)
+		return;
+
+	slot_del(self, slot);
+	by_nick_del(self, member);
+	spoke_unlink(self, member);
+	member_unlink(member);
+	gpirc_users_unref(self->users, member->user);
+	gpirc_slab_free(&self->slab, member);
+}
+
+void gpirc_nicks_mark(struct gpirc_nicks *self)
+{
+	self->gen++;
+
+	/* Cheaper to build it again than to insert a whole NAMES reply */
+	by_nick_drop(self);
+}
+
+/*
+ * The deletion shifts entries only backwards into the hole, the slot is
+ * checked again after a member was removed from it.
+ */
+size_t gpirc_nicks_sweep(struct gpirc_nicks *self)
+{
+	size_t i = 0, ret = 0;
+
+	while (i < self->size) {
+		struct gpirc_member *member = self->slots[i];
+
+		if (member && member->gen != self->gen) {
+			gpirc_nicks_del(self, member);
+			ret++;
+			continue;
+		}
+
+		i++;
+	}
+
+	/* Built here so that the first completion does not have to sort */
+	if (!self->by_nick)
+		by_nick_build(self);
+
+	return ret;
+}
+
+int gpirc_nicks_rem(struct gpirc_nicks *self, const char *nick)
+{
+	struct gpirc_member *member = gpirc_nicks_get(self, nick);
+
+	if (!member)
+		return 1;
+
+	gpirc_nicks_del(self, member);
+
+	return 0;
+}
+
+int gpirc_nicks_rename(struct gpirc_users *users, struct gpirc_user *user,
+                       const char *new_nick)
+{
+	struct gpirc_member *member;
+	int ret;
+
+	for (member = user->members; member; member = member->user_next)
+		by_nick_del(member->nicks, member);
+
+	ret = gpirc_users_rename(users, user, new_nick);
+
+	for (member = user->members; member; member = member->user_next)
+		by_nick_ins(member->nicks, member);
+
+	return ret;
+}
+
+void gpirc_nicks_spoke(struct gpirc_nicks *self, struct gpirc_member *member)
+{
+	if (self->spoke == member)
+		return;
+
+	spoke_unlink(self, member);
+
+	member->spoke_next = self->spoke;
+	if (self->spoke)
+		self->spoke->spoke_prev = member;
+	self->spoke = member;
+}
+
+size_t gpirc_nicks_complete(struct gpirc_nicks *self, const char *prefix,
+                            struct gpirc_member **res, size_t max)
+{
+	size_t i, len = strlen(prefix), cnt = 0;
+	struct gpirc_member *member;
+
+	for (member = self->spoke; member && cnt < max; member = member->spoke_next) {
+		if (!prefix_cmp(member->user->nick, prefix, len))
+			res[cnt++] = member;
+	}
+
+	if (cnt >= max)
+		return cnt;
+
+	if (!self->by_nick && by_nick_build(self))
+		return cnt;
+
+	for (i = by_nick_lower(self, prefix, len); i < self->by_nick_cnt && cnt < max; i++) {
+		member = self->by_nick[i];
+
+		if (prefix_cmp(member->user->nick, prefix, len))
+			break;
+
+		/* Already found in the recent speakers */
+		if (!spoke_linked(self, member))
+			res[cnt++] = member;
+	}
+
+	return cnt;
+}
+
+static int sorted_cmp(const void *a, const void *b)
+{
+	const struct gpirc_member *ma = *(const struct gpirc_member **)a;
+	const struct gpirc_member *mb = *(const struct gpirc_member **)b;
+	char pa = gpirc_nick_prefix(ma->flags);
+	char pb = gpirc_nick_prefix(mb->flags);
+
+	if (pa != pb) {
+		uint8_t fa = gpirc_nick_prefix_flag(pa);
+		uint8_t fb = gpirc_nick_prefix_flag(pb);
+
+		return fa > fb ? -1 : 1;
+	}
+
+	return gpirc_nick_cmp(ma->user->nick, mb->user->nick);
+}
+
+struct gpirc_member **gpirc_nicks_sorted(struct gpirc_nicks *self)
+{
+	size_t i, j = 0;
+
+	/* Any rename on the network invalidates the order */
+	if (self->sorted_gen != self->users->gen)
+		sorted_invalidate(self);
+
+	if (self->sorted)
+		return self->sorted;
+
+	self->sorted = malloc(sizeof(struct gpirc_member *) * (self->cnt + 1));
+	if (!self->sorted)
+		return NULL;
+
+	for (i = 0; i < self->size; i++) {
+		if (self->slots[i])
+			self->sorted[j++] = self->slots[i];
+	}
+
+	qsort(self->sorted, j, sizeof(struct gpirc_member *), sorted_cmp);
+
+	self->sorted_gen = self->users->gen;
+
+	return self->sorted;
+}
@@ -0,0 +1,196 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * Channel membership index.
+ *
+ * Open addressing hash table of memberships keyed by the gpirc_user pointer
+ * from the network wide user table, nick lookups go through the user table.
+ * Since the key is the user record rather than the nick string renames do not
+ * touch the channel tables at all. The mode prefixes from NAMES and MODE are
+ * stored as flags. Add and remove are O(1), sorted view for printing is built
+ * lazily and cached until next change.
+ *
+ * A fresh NAMES reply is applied as a diff, members are marked with the
+ * generation they were last added in and members that were not seen in the
+ * reply are swept at the end of it.
+ *
+ * Nick completion uses a second view sorted by the case folded nick and a
+ * list of members ordered by the time they last spoke. The sorted view is
+ * built once a NAMES reply is complete and then kept up to date on each
+ * change.
+ */
+
+#ifndef GPIRC_NICKS_H__
+#define GPIRC_NICKS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "gpirc_users.h"
+
+enum gpirc_nick_flags {
+	GPIRC_NICK_VOICE = 0x01,
+	GPIRC_NICK_HALFOP = 0x02,
+	GPIRC_NICK_OP = 0x04,
+	GPIRC_NICK_ADMIN = 0x08,
+	GPIRC_NICK_OWNER = 0x10,
+};
+
+struct gpirc_nicks;
+
+struct gpirc_member {
+	struct gpirc_user *user;
+	/* Channel this membership belongs to */
+	struct gpirc_nicks *nicks;
+	/* List of memberships of the user */
+	struct gpirc_member *user_prev;
+	struct gpirc_member *user_next;
+	/* Recent speakers list, the most recent first */
+	struct gpirc_member *spoke_prev;
+	struct gpirc_member *spoke_next;
+	uint8_t flags;
+	/* Generation the member was last added in */
+	uint8_t gen;
+};
+
+struct gpirc_nicks {
+	struct gpirc_users *users;
+	/* Power of two, zero if not allocated yet */
+	size_t size;
+	size_t cnt;
+	struct gpirc_member **slots;
+	/* Membership records, freed in one go in gpirc_nicks_free() */
+	struct gpirc_slab slab;
+
+	/* Cached sorted view, NULL when invalidated */
+	struct gpirc_member **sorted;
+	/* Users generation the sorted view was built for */
+	unsigned int sorted_gen;
+	/* Completion view sorted by nick, NULL until needed */
+	struct gpirc_member **by_nick;
+	size_t by_nick_cnt;
+	size_t by_nick_size;
+	/* Recent speakers list head */
+	struct gpirc_member *spoke;
+	/* Current NAMES generation */
+	uint8_t gen;
+
+	/* Channel pointer */
+	void *priv;
+};
+
+/*
+ * Returns flag for a mode prefix character e.g. '@' or 0 if c is not a prefix.
+ */
+uint8_t gpirc_nick_prefix_flag(char c);
+
+/*
+ * Returns prefix character for the highest mode in flags or ' ' if none.
+ */
+char gpirc_nick_prefix(uint8_t flags);
+
+static inline void gpirc_nicks_init(struct gpirc_nicks *self,
+                                    struct gpirc_users *users, void *priv)
+{
+	self->users = users;
+	self->priv = priv;
+	gpirc_slab_init(&self->slab, sizeof(struct gpirc_member), 1024);
+}
+
+/*
+ * Makes sure that cnt memberships fit into the table without rehashing.
+ *
+ * Returns non-zero on allocation failure.
+ */
+int gpirc_nicks_reserve(struct gpirc_nicks *self, size_t cnt);
+
+/*
+ * Removes all memberships and drops the user references.
+ */
+void gpirc_nicks_free(struct gpirc_nicks *self);
+
+/*
+ * Adds a nick, leading mode prefixes e.g. "@+nick" are parsed into flags.
+ *
+ * If nick is already present the flags are updated.
+ *
+ * @nick A nick, does not have to be null terminated.
+ * @len A nick length.
+ * @return A membership or NULL on allocation failure or empty nick.
+ */
+struct gpirc_member *gpirc_nicks_add(struct gpirc_nicks *self, const char *nick, size_t len);
+
+/*
+ * Removes a membership and drops the user reference.
+ */
+void gpirc_nicks_del(struct gpirc_nicks *self, struct gpirc_member *member);
+
+/*
+ * Removes a nick, returns non-zero if not found.
+ */
+int gpirc_nicks_rem(struct gpirc_nicks *self, const char *nick);
+
+/*
+ * Sets or clears a mode flag, returns non-zero if not found.
+ */
+int gpirc_nicks_mode(struct gpirc_nicks *self, const char *nick, uint8_t flag, int set);
+
+struct gpirc_member *gpirc_nicks_get(struct gpirc_nicks *self, const char *nick);
+
+/*
+ * Starts a resync, members that are not added again before
+ * gpirc_nicks_sweep() is called are removed.
+ */
+void gpirc_nicks_mark(struct gpirc_nicks *self);
+
+/*
+ * Removes members that were not added since gpirc_nicks_mark() and builds the
+ * completion view.
+ *
+ * @return Number of removed members.
+ */
+size_t gpirc_nicks_sweep(struct gpirc_nicks *self);
+
+static inline size_t gpirc_nicks_cnt(struct gpirc_nicks *self)
+{
+	return self->cnt;
+}
+
+/*
+ * Renames a user and keeps the completion views of all channels the user is
+ * in sorted.
+ *
+ * Returns non-zero on allocation failure.
+ */
+int gpirc_nicks_rename(struct gpirc_users *users, struct gpirc_user *user,
+                       const char *new_nick);
+
+/*
+ * Moves a member to the front of the recent speakers.
+ */
+void gpirc_nicks_spoke(struct gpirc_nicks *self, struct gpirc_member *member);
+
+/*
+ * Looks up members with nicks starting with a prefix, recent speakers come
+ * first, the rest follows in alphabetical order.
+ *
+ * @res An array to store the members to.
+ * @max Size of the array.
+ * @return Number of members stored.
+ */
+size_t gpirc_nicks_complete(struct gpirc_nicks *self, const char *prefix,
+                            struct gpirc_member **res, size_t max);
+
+/*
+ * Returns array of gpirc_nicks_cnt() members sorted by mode and name.
+ *
+ * The array is valid until next modification.
+ */
+struct gpirc_member **gpirc_nicks_sorted(struct gpirc_nicks *self);
+
+#endif /* GPIRC_NICKS_H__ */
@@ -0,0 +1,372 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+#include <string.h>
+#include "gpirc_proto.h"
+
+static int is_end(char c)
+{
+	return !c || c == '\r' || c == '\n';
+}
+
+/* Bytes that end a token */
+static const uint8_t token_stop[256] = {
+	[0] = 1,
+	['\r'] = 1,
+	['\n'] = 1,
+	[' '] = 1,
+};
+
+/*
+ * Tokens are short, a table driven byte loop is faster than strcspn() which
+ * builds a lookup table on each call.
+ */
+static char *token_end(char *str)
+{
+	while (!token_stop[(unsigned char)*str])
+		str++;
+
+	return str;
+}
+
+/*
+ * The trailing parameter is most of the line, it's scanned with the
+ * vectorized string functions.
+ */
+static char *line_end(char *str)
+{
+	size_t len = strlen(str);
+	char *cr = memchr(str, '\r', len);
+	char *lf = memchr(str, '\n', cr ? (size_t)(cr - str) : len);
+
+	if (lf)
+		return lf;
+
+	return cr ? cr : str + len;
+}
+
+static char *skip_spaces(char *str)
+{
+	while (*str == ' ')
+		str++;
+
+	return str;
+}
+
+static struct gpirc_proto_str span(const char *start, const char *end)
+{
+	return (struct gpirc_proto_str) {start, end - start};
+}
+
+static int is_numeric(const struct gpirc_proto_str *cmd)
+{
+	const char *c = cmd->str;
+
+	return cmd->len == 3 &&
+	       c[0] >= '0' && c[0] <= '9' &&
+	       c[1] >= '0' && c[1] <= '9' &&
+	       c[2] >= '0' && c[2] <= '9';
+}
+
+int gpirc_proto_parse(char *line, struct gpirc_proto_msg *msg)
+{
+	static const char empty[] = "";
+	char *end;
+	size_t i;
+
+	msg->tags = span(empty, empty);
+	msg->nick = msg->tags;
+	msg->mask = msg->tags;
+	msg->numeric = 0;
+	msg->param_cnt = 0;
+
+	line = skip_spaces(line);
+
+	if (*line == '@') {
+		end = token_end(line);
+		msg->tags = span(line + 1, end);
+
+		if (*end != ' ')
+			return 1;
+
+		*end = 0;
+		line = skip_spaces(end + 1);
+	}
+
+	if (*line == ':') {
+		char *colon = line++;
+
+		end = token_end(line);
+
+		for (i = 0; line + i < end && line[i] != '!' && line[i] != '@'; i++);
+
+		/* Handlers want the nick as a string, the ':' is not needed */
+		memmove(colon, line, i);
+		colon[i] = 0;
+
+		msg->nick = span(colon, colon + i);
+		msg->mask = span(line + i, end);
+
+		if (*end != ' ')
+			return 1;
+
+		*end = 0;
+		line = skip_spaces(end + 1);
+	}
+
+	end = token_end(line);
+	if (end == line)
+		return 1;
+
+	msg->cmd = span(line, end);
+
+	if (is_numeric(&msg->cmd))
+		msg->numeric = 100 * (line[0] - '0') + 10 * (line[1] - '0') + line[2] - '0';
+
+	while (*end == ' ') {
+		*end = 0;
+		line = skip_spaces(end + 1);
+
+		if (is_end(*line)) {
+			end = line;
+			break;
+		}
+
+		/* The last parameter takes the rest of the line */
+		if (*line == ':' || msg->param_cnt + 1 >= GPIRC_PROTO_PARAMS) {
+			if (*line == ':')
+				line++;
+
+			end = line_end(line);
+			msg->params[msg->param_cnt++] = span(line, end);
+			break;
+		}
+
+		end = token_end(line);
+		msg->params[msg->param_cnt++] = span(line, end);
+	}
+
+	*end = 0;
+
+	return 0;
+}
+
+int gpirc_proto_tag_next(struct gpirc_proto_str *tags, struct gpirc_proto_tag *tag)
+{
+	while (tags->len) {
+		const char *str = tags->str;
+		const char *semi = memchr(str, ';', tags->len);
+		size_t len = semi ? (size_t)(semi - str) : tags->len;
+		const char *eq;
+
+		tags->str += semi ? len + 1 : len;
+		tags->len -= semi ? len + 1 : len;
+
+		if (!len)
+			continue;
+
+		eq = memchr(str, '=', len);
+
+		if (eq) {
+			tag->key = span(str, eq);
+			tag->val = span(eq + 1, str + len);
+		} else {
+			tag->key = span(str, str + len);
+			tag->val = span(str + len, str + len);
+		}
+
+		return 0;
+	}
+
+	return 1;
+}
+
+int gpirc_proto_tag_get(const struct gpirc_proto_msg *msg, const char *key,
+                        struct gpirc_proto_str *val)
+{
+	struct gpirc_proto_str tags = msg->tags;
+	struct gpirc_proto_tag tag;
+	size_t len = strlen(key);
+
+	while (!gpirc_proto_tag_next(&tags, &tag)) {
+		if (tag.key.len == len && !memcmp(tag.key.str, key, len)) {
+			*val = tag.val;
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+size_t gpirc_proto_tag_unescape(const struct gpirc_proto_str *val, char *buf, size_t size)
+{
+	size_t i, len = 0;
+
+	if (!size)
+		return 0;
+
+	for (i = 0; i < val->len && len + 1 < size; i++) {
+		char c = val->str[i];
+
+		if (c == '\\') {
+			/* A trailing backslash is dropped */
+			if (++i >= val->len)
+				break;
+
+			switch (val->str[i]) {
+			case ':':
+				c = ';';
+			break;
+			case 's':
+				c = ' ';
+			break;
+			case 'r':
+				c = '\r';
+			break;
+			case 'n':
+				c = '\n';
+			break;
+			default:
+				c = val->str[i];
+			}
+		}
+
+		buf[len++] = c;
+	}
+
+	buf[len] = 0;
+
+	return len;
+}
+
+static int parse_num(const char *str, size_t len, int *num)
+{
+	size_t i;
+
+	*num = 0;
+
+	for (i = 0; i < len; i++) {
+		if (str[i] < '0' || str[i] > '9')
+			return 1;
+
+		*num = 10 * *num + str[i] - '0';
+	}
+
+	return 0;
+}
+
+/*
+ * Days since the epoch for a date in the proleptic Gregorian calendar.
+ */
+static long days_from_civil(int y, int m, int d)
+{
+	int era, yoe, doy, doe;
+
+	y -= m <= 2;
+	era = (y >= 0 ? y : y - 399) / 400;
+	yoe = y - era * 400;
+	doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return (long)era * 146097 + doe - 719468;
+}
+
+int gpirc_proto_tag_time(const struct gpirc_proto_str *val, time_t *time)
+{
+	const char *s = val->str;
+	int year, mon, day, hour, min, sec;
+
+	/* YYYY-MM-DDThh:mm:ss, the fraction and the Z are ignored */
+	if (val->len < 19 || s[4] != '-' || s[7] != '-' || s[10] != 'T' ||
+	    s[13] != ':' || s[16] != ':')
+		return 1;
+
+	if (parse_num(s, 4, &year) || parse_num(s + 5, 2, &mon) ||
+	    parse_num(s + 8, 2, &day) || parse_num(s + 11, 2, &hour) ||
+	    parse_num(s + 14, 2, &min) || parse_num(s + 17, 2, &sec))
+		return 1;
+
+	if (mon < 1 || mon > 12 || day < 1 || day > 31 || hour > 23 || min > 59 || sec > 60)
+		return 1;
+
+	*time = (time_t)days_from_civil(year, mon, day) * 86400 + hour * 3600 + min * 60 + sec;
+
+	return 0;
+}
+
+static uint32_t cmd_hash(const char *cmd, size_t len)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)cmd[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+int gpirc_proto_table_add(struct gpirc_proto_table *self, const char *cmd,
+                          gpirc_proto_handler handler)
+{
+	size_t len = strlen(cmd), n;
+	uint32_t i;
+
+	if (len > GPIRC_PROTO_CMD_LEN)
+		return 1;
+
+	i = cmd_hash(cmd, len) & (GPIRC_PROTO_SLOTS - 1);
+
+	for (n = 0; n < GPIRC_PROTO_SLOTS; n++) {
+		struct gpirc_proto_slot *slot = &self->slots[i];
+
+		if (!slot->handler || !strcmp(slot->cmd, cmd)) {
+			strcpy(slot->cmd, cmd);
+			slot->handler = handler;
+			return 0;
+		}
+
+		i = (i + 1) & (GPIRC_PROTO_SLOTS - 1);
+	}
+
+	return 1;
+}
+
+void gpirc_proto_dispatch(const struct gpirc_proto_table *self, void *priv,
+                          struct gpirc_proto_msg *msg)
+{
+	size_t len = msg->cmd.len, n;
+	uint32_t i;
+
+	if (msg->numeric) {
+		if (self->numeric)
+			self->numeric(priv, msg);
+		return;
+	}
+
+	if (len > GPIRC_PROTO_CMD_LEN)
+		goto unknown;
+
+	i = cmd_hash(msg->cmd.str, len) & (GPIRC_PROTO_SLOTS - 1);
+
+	for (n = 0; n < GPIRC_PROTO_SLOTS && self->slots[i].handler; n++) {
+		const struct gpirc_proto_slot *slot = &self->slots[i];
+
+		if (!memcmp(slot->cmd, msg->cmd.str, len) && !slot->cmd[len]) {
+			slot->handler(priv, msg);
+			return;
+		}
+
+		i = (i + 1) & (GPIRC_PROTO_SLOTS - 1);
+	}
+
+unknown:
+	if (self->unknown)
+		self->unknown(priv, msg);
+}
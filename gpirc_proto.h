@@ -0,0 +1,152 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * IRC protocol line parser.
+ *
+ * A line is parsed in place in the buffer it was received into. Tags, prefix,
+ * command and parameters are stored as (pointer, length) spans into the line
+ * and the separators are overwritten with null bytes, so that the spans can be
+ * passed as strings as well. The nick is moved one byte to the left over the
+ * ':' that starts the prefix to make room for its terminator, apart from that
+ * nothing is copied and nothing is allocated.
+ *
+ * Parsed messages are dispatched through a table keyed by the command.
+ */
+
+#ifndef GPIRC_PROTO_H__
+#define GPIRC_PROTO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+/* RFC1459 allows at most 15 parameters */
+#define GPIRC_PROTO_PARAMS 15
+
+struct gpirc_proto_str {
+	const char *str;
+	size_t len;
+};
+
+struct gpirc_proto_msg {
+	/* IRCv3 message tags without the leading '@', see gpirc_proto_tag_next() */
+	struct gpirc_proto_str tags;
+	/* Nick or server name from the prefix, empty if there is no prefix */
+	struct gpirc_proto_str nick;
+	/* The rest of the prefix, i.e. "!user@host", empty for servers */
+	struct gpirc_proto_str mask;
+	struct gpirc_proto_str cmd;
+	/* Set for three digit numeric replies */
+	unsigned int numeric;
+	unsigned int param_cnt;
+	struct gpirc_proto_str params[GPIRC_PROTO_PARAMS];
+};
+
+/*
+ * Parses a line in place, the line ends with a null byte, '\r' or '\n'.
+ *
+ * @return Zero on success, non-zero for lines without a command.
+ */
+int gpirc_proto_parse(char *line, struct gpirc_proto_msg *msg);
+
+struct gpirc_proto_tag {
+	struct gpirc_proto_str key;
+	/* Escaped value, empty if the tag has no value */
+	struct gpirc_proto_str val;
+};
+
+/*
+ * Consumes the next tag from the tags span.
+ *
+ * @return Zero if a tag was stored, non-zero if there are no more tags.
+ */
+int gpirc_proto_tag_next(struct gpirc_proto_str *tags, struct gpirc_proto_tag *tag);
+
+/*
+ * Looks up a tag value by the key.
+ *
+ * @return Zero if found, non-zero otherwise.
+ */
+int gpirc_proto_tag_get(const struct gpirc_proto_msg *msg, const char *key,
+                        struct gpirc_proto_str *val);
+
+/*
+ * Unescapes a tag value into a null terminated buffer.
+ *
+ * @return Length of the value, truncated to size - 1.
+ */
+size_t gpirc_proto_tag_unescape(const struct gpirc_proto_str *val, char *buf, size_t size);
+
+/*
+ * Parses an IRCv3 server-time tag value e.g. "2022-05-01T12:00:00.000Z"
+ * without going through the libc time zone code.
+ *
+ * @return Zero on success, non-zero if the value is malformed.
+ */
+int gpirc_proto_tag_time(const struct gpirc_proto_str *val, time_t *time);
+
+/* Numeric replies */
+enum gpirc_proto_numeric {
+	GPIRC_PROTO_RPL_WELCOME = 1,
+	GPIRC_PROTO_RPL_YOURHOST = 2,
+	GPIRC_PROTO_RPL_CREATED = 3,
+	GPIRC_PROTO_RPL_MYINFO = 4,
+	/* RPL_ISUPPORT in practice */
+	GPIRC_PROTO_RPL_BOUNCE = 5,
+	GPIRC_PROTO_RPL_LUSERCLIENT = 251,
+	GPIRC_PROTO_RPL_LUSEROP = 252,
+	GPIRC_PROTO_RPL_LUSERUNKNOWN = 253,
+	GPIRC_PROTO_RPL_LUSERCHANNELS = 254,
+	GPIRC_PROTO_RPL_LUSERME = 255,
+	GPIRC_PROTO_RPL_NOTOPIC = 331,
+	GPIRC_PROTO_RPL_TOPIC = 332,
+	GPIRC_PROTO_RPL_NAMREPLY = 353,
+	GPIRC_PROTO_RPL_ENDOFNAMES = 366,
+	GPIRC_PROTO_RPL_MOTD = 372,
+	GPIRC_PROTO_RPL_MOTDSTART = 375,
+	GPIRC_PROTO_RPL_ENDOFMOTD = 376,
+	GPIRC_PROTO_ERR_NOMOTD = 422,
+	GPIRC_PROTO_ERR_NICKNAMEINUSE = 433,
+	GPIRC_PROTO_ERR_CHANOPRIVSNEEDED = 482,
+};
+
+typedef void (*gpirc_proto_handler)(void *priv, struct gpirc_proto_msg *msg);
+
+#define GPIRC_PROTO_SLOTS 64
+#define GPIRC_PROTO_CMD_LEN 15
+
+/*
+ * Open addressing table of command handlers, numeric replies go to a single
+ * handler and everything else to the unknown handler.
+ */
+struct gpirc_proto_table {
+	struct gpirc_proto_slot {
+		char cmd[GPIRC_PROTO_CMD_LEN + 1];
+		gpirc_proto_handler handler;
+	} slots[GPIRC_PROTO_SLOTS];
+	gpirc_proto_handler numeric;
+	gpirc_proto_handler unknown;
+};
+
+/*
+ * Adds a command handler.
+ *
+ * @return Zero on success, non-zero if the command is too long or the table is
+ *         full.
+ */
+int gpirc_proto_table_add(struct gpirc_proto_table *self, const char *cmd,
+                          gpirc_proto_handler handler);
+
+/*
+ * Calls the handler for the message command, if any.
+ */
+void gpirc_proto_dispatch(const struct gpirc_proto_table *self, void *priv,
+                          struct gpirc_proto_msg *msg);
+
+#endif /* GPIRC_PROTO_H__ */
@@ -0,0 +1,705 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * IRC receive path benchmark.
+ *
+ * A server thread sends random lines over a localhost socket and the client
+ * reads, parses and dispatches them to handlers that look at the sender nick
+ * and the message text. This is done twice:
+ *
+ * - with gpirc_net, i.e. the lines are split and parsed in place in the
+ *   receive buffer, copied once into the event ring and dispatched through
+ *   the gpirc_proto command table on the UI thread
+ *
+ * - the way gpirc did it with libircclient, i.e. libircclient parses the
+ *   lines into allocated strings on the network thread, the callbacks copy
+ *   each string into a ring slot, the UI thread calls the handler for the
+ *   callback and the handler copies the nick out of the origin with
+ *   irc_target_get_nick(); lines with server-time tags end up in the unknown
+ *   callback and are put back together and parsed again
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <libircclient.h>
+
+#include "gpirc_time.h"
+#include "gpirc_ring.h"
+#include "gpirc_proto.h"
+#include "gpirc_net.h"
+
+#define LINE_SIZE 512
+
+/* Sent after the lines, ends the run */
+#define END_NUMERIC 999
+
+static struct opts {
+	unsigned int lines;
+	unsigned int loops;
+} opts = {
+	.lines = 100000,
+	.loops = 10,
+};
+
+static void rand_word(char *buf, size_t min, size_t max)
+{
+	size_t i, len = min + random() % (max - min + 1);
+
+	for (i = 0; i < len; i++)
+		buf[i] = 'a' + random() % 26;
+
+	buf[len] = 0;
+}
+
+static void rand_text(char *buf, size_t len)
+{
+	size_t off = 0;
+
+	while (off < len) {
+		rand_word(buf + off, 2, 8);
+		off += strlen(buf + off);
+		buf[off++] = ' ';
+	}
+
+	buf[off - 1] = 0;
+}
+
+/*
+ * A mix of lines as seen on a busy network with server-time enabled. PINGs
+ * are left out, both paths answer them on the network thread.
+ */
+static int rand_line(char *line)
+{
+	char nick[16], user[16], host[16], chan[16], text[400];
+	unsigned int kind = random() % 100;
+
+	rand_word(nick, 3, 12);
+	rand_word(user, 3, 10);
+	rand_word(host, 5, 12);
+	rand_word(chan + 1, 3, 10);
+	chan[0] = '#';
+
+	if (kind < 40) {
+		rand_text(text, 20 + random() % 200);
+		return snprintf(line, LINE_SIZE, ":%s!%s@%s.example.com PRIVMSG %s :%.230s\r\n",
+		                nick, user, host, chan, text);
+	}
+
+	if (kind < 60) {
+		rand_text(text, 20 + random() % 200);
+		return snprintf(line, LINE_SIZE, "@time=2022-05-01T12:00:00.000Z "
+		                ":%s!%s@%s.example.com PRIVMSG %s :%.230s\r\n",
+		                nick, user, host, chan, text);
+	}
+
+	if (kind < 70)
+		return snprintf(line, LINE_SIZE, ":%s!%s@%s.example.com JOIN %s\r\n", nick, user, host, chan);
+
+	if (kind < 80)
+		return snprintf(line, LINE_SIZE, ":%s!%s@%s.example.com PART %s :Leaving\r\n", nick, user, host, chan);
+
+	if (kind < 88)
+		return snprintf(line, LINE_SIZE, ":%s!%s@%s.example.com QUIT :Quit: bye\r\n", nick, user, host);
+
+	if (kind < 93)
+		return snprintf(line, LINE_SIZE, ":%s!%s@%s.example.com NICK :%s_\r\n", nick, user, host, nick);
+
+	rand_text(text, 300);
+	return snprintf(line, LINE_SIZE, ":irc.example.com 353 bench = %s :%s\r\n", chan, text);
+}
+
+struct srv {
+	int lfd;
+	int port;
+	const char *data;
+	size_t size;
+	pthread_t thread;
+};
+
+static int send_all(int fd, const char *buf, size_t len)
+{
+	while (len) {
+		ssize_t ret = send(fd, buf, len, MSG_NOSIGNAL);
+
+		if (ret <= 0)
+			return 1;
+
+		buf += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Waits for the registration, sends the lines and waits for the client to
+ * disconnect.
+ */
+static void *srv_main(void *arg)
+{
+	struct srv *self = arg;
+	static const char welcome[] = ":irc.example.com 001 bench :Welcome\r\n";
+	char end[64], buf[4096];
+	size_t len = 0;
+	unsigned int l;
+	ssize_t ret;
+	int fd;
+
+	fd = accept(self->lfd, NULL, NULL);
+	if (fd < 0)
+		return NULL;
+
+	for (;;) {
+		char *user;
+
+		ret = read(fd, buf + len, sizeof(buf) - len - 1);
+		if (ret <= 0)
+			goto out;
+
+		len += ret;
+		buf[len] = 0;
+
+		user = strstr(buf, "USER ");
+		if (user && strchr(user, '\n'))
+			break;
+
+		if (len + 1 >= sizeof(buf))
+			goto out;
+	}
+
+	snprintf(end, sizeof(end), ":irc.example.com %03u bench :End\r\n", END_NUMERIC);
+
+	if (send_all(fd, welcome, sizeof(welcome) - 1))
+		goto out;
+
+	for (l = 0; l < opts.loops; l++) {
+		if (send_all(fd, self->data, self->size))
+			goto out;
+	}
+
+	if (send_all(fd, end, strlen(end)))
+		goto out;
+
+	while (read(fd, buf, sizeof(buf)) > 0);
+out:
+	close(fd);
+	return NULL;
+}
+
+static int srv_start(struct srv *self)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t addr_len = sizeof(addr);
+
+	self->lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (self->lfd < 0)
+		return 1;
+
+	if (bind(self->lfd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    listen(self->lfd, 1) ||
+	    getsockname(self->lfd, (struct sockaddr *)&addr, &addr_len))
+		goto err;
+
+	self->port = ntohs(addr.sin_port);
+
+	if (pthread_create(&self->thread, NULL, srv_main, self))
+		goto err;
+
+	return 0;
+err:
+	close(self->lfd);
+	return 1;
+}
+
+static void srv_stop(struct srv *self)
+{
+	pthread_join(self->thread, NULL);
+	close(self->lfd);
+}
+
+/* Results are summed so that the work is not optimized out, UI thread only */
+static uint64_t sum;
+static int done;
+static int failed;
+
+/* gpirc_net path */
+static struct gpirc_proto_table native_table;
+
+static void native_privmsg(void *priv, struct gpirc_proto_msg *msg)
+{
+	(void) priv;
+
+	if (msg->param_cnt >= 2)
+		sum += msg->nick.len + msg->params[1].len;
+}
+
+static void native_other(void *priv, struct gpirc_proto_msg *msg)
+{
+	(void) priv;
+
+	sum += msg->nick.len + msg->param_cnt;
+}
+
+static void native_numeric(void *priv, struct gpirc_proto_msg *msg)
+{
+	if (msg->numeric == END_NUMERIC)
+		done = 1;
+	else
+		native_other(priv, msg);
+}
+
+static void native_msg(void *ctx, struct gpirc_proto_msg *msg)
+{
+	gpirc_proto_dispatch(&native_table, ctx, msg);
+}
+
+static void native_disconnect(void *ctx, const char *reason)
+{
+	(void) ctx;
+
+	printf("Disconnected: %s\n", reason);
+	done = failed = 1;
+}
+
+static uint64_t bench_native(int port)
+{
+	static const char *cmds[] = {"JOIN", "NICK", "PART", "QUIT"};
+	struct gpirc_net_sess *sess;
+	struct pollfd pfd;
+	uint64_t start;
+	size_t i;
+
+	native_table.numeric = native_numeric;
+	native_table.unknown = native_other;
+
+	for (i = 0; i < sizeof(cmds)/sizeof(*cmds); i++)
+		gpirc_proto_table_add(&native_table, cmds[i], native_other);
+
+	gpirc_proto_table_add(&native_table, "PRIVMSG", native_privmsg);
+
+	start = gpirc_monotonic_ns();
+
+	if (gpirc_net_init(native_msg, native_disconnect))
+		return 0;
+
+	sess = gpirc_net_session_new(NULL);
+	if (!sess || gpirc_net_connect(sess, "127.0.0.1", port, "bench"))
+		failed = 1;
+
+	pfd.fd = gpirc_net_fd();
+	pfd.events = POLLIN;
+
+	while (!done && !failed) {
+		poll(&pfd, 1, -1);
+		gpirc_net_process();
+	}
+
+	start = gpirc_monotonic_ns() - start;
+
+	gpirc_net_exit();
+
+	return start;
+}
+
+/*
+ * The libircclient path, the events are copied into the ring slots the way
+ * gpirc_net did before it parsed the lines itself.
+ */
+#define EV_RING_SIZE 256
+#define EV_PARAMS 16
+#define EV_BUF 2048
+
+enum old_cb {
+	OLD_CHANNEL,
+	OLD_OTHER,
+	OLD_NUMERIC,
+	OLD_UNKNOWN,
+};
+
+struct old_ev {
+	uint8_t cb;
+	uint16_t numeric;
+	uint16_t event;
+	uint16_t origin;
+	uint16_t param_cnt;
+	uint16_t params[EV_PARAMS];
+	char buf[EV_BUF];
+};
+
+static struct gpirc_ring old_ring;
+static int old_efd;
+static int old_produced;
+static atomic_int old_quit;
+
+static uint16_t old_str(struct old_ev *ev, size_t *off, const char *str)
+{
+	size_t len, ret = *off;
+
+	if (*off >= EV_BUF)
+		return *off - 1;
+
+	len = strlen(str);
+	if (len > EV_BUF - *off - 1)
+		len = EV_BUF - *off - 1;
+
+	memcpy(ev->buf + *off, str, len);
+	ev->buf[*off + len] = 0;
+	*off += len + 1;
+
+	return ret;
+}
+
+/*
+ * Unlike gpirc_net we spin on a full ring instead of queuing the events on
+ * the heap, the UI thread drains it in a moment.
+ */
+static void old_push(uint8_t cb, unsigned int numeric, const char *event,
+                     const char *origin, const char **params, unsigned int count)
+{
+	struct old_ev *ev;
+	size_t off = 0;
+	unsigned int i;
+
+	while (!(ev = gpirc_ring_prod_slot(&old_ring)))
+		sched_yield();
+
+	if (count > EV_PARAMS)
+		count = EV_PARAMS;
+
+	ev->cb = cb;
+	ev->numeric = numeric;
+	ev->event = old_str(ev, &off, event ? event : "");
+	ev->origin = old_str(ev, &off, origin ? origin : "");
+	ev->param_cnt = count;
+
+	for (i = 0; i < count; i++)
+		ev->params[i] = old_str(ev, &off, params[i] ? params[i] : "");
+
+	gpirc_ring_prod_commit(&old_ring);
+	old_produced = 1;
+}
+
+#define OLD_FWD(name, cb) \
+static void name(irc_session_t *s, const char *event, const char *origin, \
+                 const char **params, unsigned int count) \
+{ \
+	(void) s; \
+	old_push(cb, 0, event, origin, params, count); \
+}
+
+OLD_FWD(old_fwd_channel, OLD_CHANNEL)
+OLD_FWD(old_fwd_other, OLD_OTHER)
+OLD_FWD(old_fwd_unknown, OLD_UNKNOWN)
+
+static void old_fwd_numeric(irc_session_t *s, unsigned int event, const char *origin,
+                            const char **params, unsigned int count)
+{
+	(void) s;
+	old_push(OLD_NUMERIC, event, NULL, origin, params, count);
+}
+
+static void *old_net_main(void *arg)
+{
+	irc_session_t *session = arg;
+
+	while (!atomic_load(&old_quit) && irc_is_connected(session)) {
+		struct timeval tv = {0, 100000};
+		fd_set in_set, out_set;
+		int maxfd = 0;
+
+		FD_ZERO(&in_set);
+		FD_ZERO(&out_set);
+
+		irc_add_select_descriptors(session, &in_set, &out_set, &maxfd);
+
+		if (select(maxfd + 1, &in_set, &out_set, NULL, &tv) < 0)
+			continue;
+
+		old_produced = 0;
+
+		irc_process_select_descriptors(session, &in_set, &out_set);
+
+		if (old_produced) {
+			uint64_t val = 1;
+
+			if (write(old_efd, &val, sizeof(val)) != sizeof(val))
+				break;
+		}
+	}
+
+	return NULL;
+}
+
+static void old_channel(const char *origin, const char **params, unsigned int count)
+{
+	char nick[128];
+
+	if (count < 2)
+		return;
+
+	irc_target_get_nick(origin, nick, sizeof(nick));
+	sum += strlen(nick) + strlen(params[1]);
+}
+
+static void old_other(const char *origin, unsigned int count)
+{
+	char nick[128];
+
+	irc_target_get_nick(origin, nick, sizeof(nick));
+	sum += strlen(nick) + count;
+}
+
+/*
+ * What ev_tagged() did, the line is put back together and parsed again.
+ */
+static void old_tagged(const char *event, const char **params, unsigned int count)
+{
+	const char *chan_params[GPIRC_PROTO_PARAMS];
+	struct gpirc_proto_msg msg;
+	char line[EV_BUF + 16];
+	unsigned int i;
+
+	if (event[0] != '@' || count != 1 || !strchr(params[0], ' '))
+		return;
+
+	snprintf(line, sizeof(line), "%s :%s", event, params[0]);
+
+	if (gpirc_proto_parse(line, &msg) || strcmp(msg.cmd.str, "PRIVMSG"))
+		return;
+
+	for (i = 0; i < msg.param_cnt; i++)
+		chan_params[i] = msg.params[i].str;
+
+	old_channel(msg.nick.str, chan_params, msg.param_cnt);
+}
+
+static void old_dispatch(struct old_ev *ev)
+{
+	const char *params[EV_PARAMS];
+	const char *origin = ev->buf + ev->origin;
+	unsigned int i;
+
+	for (i = 0; i < ev->param_cnt; i++)
+		params[i] = ev->buf + ev->params[i];
+
+	switch (ev->cb) {
+	case OLD_CHANNEL:
+		old_channel(origin, params, ev->param_cnt);
+	break;
+	case OLD_OTHER:
+		old_other(origin, ev->param_cnt);
+	break;
+	case OLD_NUMERIC:
+		if (ev->numeric == END_NUMERIC)
+			done = 1;
+		else
+			old_other(origin, ev->param_cnt);
+	break;
+	case OLD_UNKNOWN:
+		old_tagged(ev->buf + ev->event, params, ev->param_cnt);
+	break;
+	}
+}
+
+static uint64_t bench_old(int port)
+{
+	irc_callbacks_t cbs = {
+		.event_channel = old_fwd_channel,
+		.event_join = old_fwd_other,
+		.event_nick = old_fwd_other,
+		.event_part = old_fwd_other,
+		.event_quit = old_fwd_other,
+		.event_unknown = old_fwd_unknown,
+		.event_numeric = old_fwd_numeric,
+	};
+	irc_session_t *session;
+	struct pollfd pfd;
+	pthread_t thread;
+	uint64_t start, val;
+	struct old_ev *ev;
+
+	if (gpirc_ring_init(&old_ring, EV_RING_SIZE, sizeof(struct old_ev)))
+		return 0;
+
+	old_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (old_efd < 0)
+		goto err0;
+
+	start = gpirc_monotonic_ns();
+
+	session = irc_create_session(&cbs);
+	if (!session)
+		goto err1;
+
+	if (irc_connect(session, "127.0.0.1", port, 0, "bench", 0, 0)) {
+		printf("Connect failed: %s\n", irc_strerror(irc_errno(session)));
+		goto err2;
+	}
+
+	if (pthread_create(&thread, NULL, old_net_main, session))
+		goto err2;
+
+	pfd.fd = old_efd;
+	pfd.events = POLLIN;
+
+	while (!done) {
+		if (poll(&pfd, 1, 1000) <= 0) {
+			printf("Disconnected\n");
+			failed = 1;
+			break;
+		}
+
+		if (read(old_efd, &val, sizeof(val)) != sizeof(val))
+			continue;
+
+		while ((ev = gpirc_ring_cons_slot(&old_ring))) {
+			old_dispatch(ev);
+			gpirc_ring_cons_release(&old_ring);
+		}
+	}
+
+	start = gpirc_monotonic_ns() - start;
+
+	/* Unblock the network thread if it waits for a ring slot */
+	atomic_store(&old_quit, 1);
+
+	while ((ev = gpirc_ring_cons_slot(&old_ring)))
+		gpirc_ring_cons_release(&old_ring);
+
+	pthread_join(thread, NULL);
+
+	irc_disconnect(session);
+	irc_destroy_session(session);
+	close(old_efd);
+	gpirc_ring_exit(&old_ring);
+
+	return start;
+err2:
+	irc_destroy_session(session);
+err1:
+	close(old_efd);
+err0:
+	gpirc_ring_exit(&old_ring);
+	failed = 1;
+	return 0;
+}
+
+static void print_result(const char *name, uint64_t ns, size_t bytes)
+{
+	double secs = ns / 1e9;
+	uint64_t lines = (uint64_t)opts.lines * opts.loops;
+
+	printf("%-13s %.0f lines/s, %.1fns per line, %.1fMB/s\n", name, lines / secs,
+	       (double)ns / lines, (double)bytes * opts.loops / secs / (1024 * 1024));
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [opts]\n\n", name);
+	printf(" -n lines    number of distinct lines (%u)\n", opts.lines);
+	printf(" -l loops    times the lines are sent (%u)\n", opts.loops);
+}
+
+static uint64_t run(const char *name, uint64_t (*bench)(int port),
+                    char *data, size_t size, uint64_t *res)
+{
+	struct srv srv = {
+		.data = data,
+		.size = size,
+	};
+	uint64_t ns;
+
+	if (srv_start(&srv)) {
+		printf("Failed to start the server\n");
+		return 0;
+	}
+
+	sum = 0;
+	done = 0;
+
+	ns = bench(srv.port);
+
+	srv_stop(&srv);
+
+	if (!failed)
+		print_result(name, ns, size);
+
+	*res = sum;
+
+	return ns;
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t native_sum, old_sum;
+	size_t size = 0;
+	unsigned int i;
+	char *data;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "hn:l:")) != -1) {
+		switch (opt) {
+		case 'n':
+			opts.lines = atoi(optarg);
+		break;
+		case 'l':
+			opts.loops = atoi(optarg);
+		break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!opts.lines || !opts.loops) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	srandom(1);
+
+	data = malloc((size_t)opts.lines * LINE_SIZE);
+	if (!data) {
+		printf("Allocation failure\n");
+		return 1;
+	}
+
+	for (i = 0; i < opts.lines; i++)
+		size += rand_line(data + size);
+
+	run("gpirc_net", bench_native, data, size, &native_sum);
+	run("libircclient", bench_old, data, size, &old_sum);
+
+	free(data);
+
+	if (failed)
+		return 1;
+
+	if (native_sum != old_sum) {
+		printf("Handler results differ!\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,104 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * Bounded lock-free single producer single consumer ring of fixed size slots.
+ *
+ * The producer fills in a slot returned by gpirc_ring_prod_slot() and makes
+ * it visible to the consumer with gpirc_ring_prod_commit(), the consumer
+ * reads it via gpirc_ring_cons_slot() and gives it back with
+ * gpirc_ring_cons_release(). Neither side ever blocks, a full or empty ring
+ * is reported by a NULL slot.
+ */
+
+#ifndef GPIRC_RING_H__
+#define GPIRC_RING_H__
+
+#include <stdlib.h>
+#include <stdatomic.h>
+
+struct gpirc_ring {
+	/* Written by the consumer */
+	_Alignas(64) atomic_size_t head;
+	/* Written by the producer */
+	_Alignas(64) atomic_size_t tail;
+
+	_Alignas(64) size_t size;
+	size_t slot_size;
+	char *slots;
+};
+
+/*
+ * @size Number of slots, must be power of two.
+ * @slot_size Slot size in bytes.
+ */
+static inline int gpirc_ring_init(struct gpirc_ring *self, size_t size, size_t slot_size)
+{
+	self->slots = malloc(size * slot_size);
+	if (!self->slots)
+		return 1;
+
+	atomic_init(&self->head, 0);
+	atomic_init(&self->tail, 0);
+	self->size = size;
+	self->slot_size = slot_size;
+
+	return 0;
+}
+
+static inline void gpirc_ring_exit(struct gpirc_ring *self)
+{
+	free(self->slots);
+	self->slots = NULL;
+}
+
+static inline void *gpirc_ring_prod_slot(struct gpirc_ring *self)
+{
+	size_t tail = atomic_load_explicit(&self->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&self->head, memory_order_acquire);
+
+	if (tail - head >= self->size)
+		return NULL;
+
+	return self->slots + (tail & (self->size - 1)) * self->slot_size;
+}
+
+static inline void gpirc_ring_prod_commit(struct gpirc_ring *self)
+{
+	size_t tail = atomic_load_explicit(&self->tail, memory_order_relaxed);
+
+	atomic_store_explicit(&self->tail, tail + 1, memory_order_release);
+}
+
+static inline void *gpirc_ring_cons_slot(struct gpirc_ring *self)
+{
+	size_t head = atomic_load_explicit(&self->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&self->tail, memory_order_acquire);
+
+	if (head == tail)
+		return NULL;
+
+	return self->slots + (head & (self->size - 1)) * self->slot_size;
+}
+
+static inline void gpirc_ring_cons_release(struct gpirc_ring *self)
+{
+	size_t head = atomic_load_explicit(&self->head, memory_order_relaxed);
+
+	atomic_store_explicit(&self->head, head + 1, memory_order_release);
+}
+
+/*
+ * Number of used slots, exact only when called from either side.
+ */
+static inline size_t gpirc_ring_used(struct gpirc_ring *self)
+{
+	return atomic_load(&self->tail) - atomic_load(&self->head);
+}
+
+#endif /* GPIRC_RING_H__ */
@@ -0,0 +1,841 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gpirc_slab.h"
+#include "gpirc_hist.h"
+#include "gpirc_log.h"
+#include "gpirc_search.h"
+
+/* Longer tokens are truncated, both when indexed and in queries */
+#define TOKEN_MAX 32
+/* Shorter tokens are not indexed */
+#define TOKEN_MIN 2
+/* Maximal number of words in a query */
+#define QUERY_MAX 16
+/* Doc ids have to fit into struct gpirc_search_hit */
+#define DOCS_MAX (1u<<31)
+/* Live text ring size, a power of two multiple of the initial 64KB */
+#define LIVE_TEXT_MAX (8 * 1024 * 1024)
+
+struct token {
+	uint32_t hash;
+	uint32_t len;
+	/* Ascending list of doc ids */
+	uint32_t *ids;
+	uint32_t cnt;
+	uint32_t size;
+	char str[TOKEN_MAX];
+};
+
+struct doc {
+	uint32_t src;
+	uint32_t time;
+	/* Line number in the source history or offset in the live text */
+	uint64_t ref;
+	/* Hash of a live line, to find it in the log once the text is gone */
+	uint32_t hash;
+};
+
+struct src {
+	char *net;
+	char *chan;
+	struct gpirc_hist hist;
+};
+
+struct index {
+	/* Token hash table, power of two */
+	size_t size;
+	size_t cnt;
+	struct token **slots;
+	struct gpirc_slab slab;
+	size_t postings;
+	size_t postings_bytes;
+
+	struct doc *docs;
+	size_t docs_cnt;
+	size_t docs_size;
+
+	struct src *srcs;
+	size_t srcs_cnt;
+
+	/*
+	 * Formatted live messages, a ring of at most LIVE_TEXT_MAX bytes. The
+	 * tail and the doc refs are offsets that keep growing, a line is
+	 * stored at ref % LIVE_TEXT_MAX.
+	 */
+	char *text;
+	uint64_t text_tail;
+	size_t text_size;
+};
+
+static struct index live, hist;
+
+static pthread_t indexer;
+static int indexer_running;
+static atomic_int hist_ready;
+static atomic_int hist_stop;
+static time_t start_time;
+
+static uint32_t line_hash(const char *str, size_t len)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)str[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static inline unsigned char tok_fold(unsigned char c)
+{
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A' + 'a';
+
+	if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80)
+		return c;
+
+	return 0;
+}
+
+static size_t slot_find(struct index *self, const char *str, size_t len, uint32_t hash)
+{
+	size_t mask = self->size - 1;
+	size_t i = hash & mask;
+
+	for (;;) {
+		struct token *tok = self->slots[i];
+
+		if (!tok)
+			return i;
+
+		if (tok->hash == hash && tok->len == len && !memcmp(tok->str, str, len))
+			return i;
+
+		i = (i + 1) & mask;
+	}
+}
+
+static int index_grow(struct index *self)
+{
+	size_t i, old_size = self->size;
+	struct token **old_slots = self->slots;
+	size_t new_size = old_size ? 2 * old_size : 1024;
+	struct token **slots = calloc(new_size, sizeof(*slots));
+
+	if (!slots)
+		return 1;
+
+	self->slots = slots;
+	self->size = new_size;
+
+	for (i = 0; i < old_size; i++) {
+		struct token *tok = old_slots[i];
+
+		if (tok)
+			self->slots[slot_find(self, tok->str, tok->len, tok->hash)] = tok;
+	}
+
+	free(old_slots);
+
+	return 0;
+}
+
+static struct token *token_lookup(struct index *self, const char *str, size_t len, uint32_t hash)
+{
+	if (!self->size)
+		return NULL;
+
+	return self->slots[slot_find(self, str, len, hash)];
+}
+
+static void token_add(struct index *self, const char *str, size_t len,
+                      uint32_t hash, uint32_t doc)
+{
+	struct token **slot, *tok;
+
+	if ((self->cnt + 1) * 4 > self->size * 3 && index_grow(self))
+		return;
+
+	slot = &self->slots[slot_find(self, str, len, hash)];
+	tok = *slot;
+
+	if (!tok) {
+		tok = gpirc_slab_alloc(&self->slab);
+		if (!tok)
+			return;
+
+		memset(tok, 0, sizeof(*tok));
+		tok->hash = hash;
+		tok->len = len;
+		memcpy(tok->str, str, len);
+
+		*slot = tok;
+		self->cnt++;
+	}
+
+	/* Token repeated in the same message */
+	if (tok->cnt && tok->ids[tok->cnt - 1] == doc)
+		return;
+
+	if (tok->cnt >= tok->size) {
+		uint32_t size = tok->size ? 2 * tok->size : 4;
+		uint32_t *ids = realloc(tok->ids, size * sizeof(*ids));
+
+		if (!ids)
+			return;
+
+		self->postings_bytes += (size - tok->size) * sizeof(*ids);
+		tok->ids = ids;
+		tok->size = size;
+	}
+
+	tok->ids[tok->cnt++] = doc;
+	self->postings++;
+}
+
+/*
+ * Splits text into case folded tokens, calls the callback for each.
+ */
+static size_t tokenize(const char *str, size_t len,
+                       void (*tok_cb)(void *priv, const char *tok, size_t len, uint32_t hash),
+                       void *priv)
+{
+	size_t i = 0, cnt = 0;
+
+	while (i < len) {
+		char tok[TOKEN_MAX];
+		uint32_t hash = 2166136261u;
+		size_t tok_len = 0;
+		unsigned char c;
+
+		while (i < len && !tok_fold(str[i]))
+			i++;
+
+		while (i < len && (c = tok_fold(str[i]))) {
+			if (tok_len < TOKEN_MAX) {
+				tok[tok_len++] = c;
+				hash ^= c;
+				hash *= 16777619u;
+			}
+			i++;
+		}
+
+		if (tok_len < TOKEN_MIN)
+			continue;
+
+		tok_cb(priv, tok, tok_len, hash);
+		cnt++;
+	}
+
+	return cnt;
+}
+
+struct doc_ctx {
+	struct index *idx;
+	uint32_t doc;
+};
+
+static void doc_tok(void *priv, const char *tok, size_t len, uint32_t hash)
+{
+	struct doc_ctx *ctx = priv;
+
+	token_add(ctx->idx, tok, len, hash, ctx->doc);
+}
+
+static int doc_add(struct index *self, uint32_t src, time_t time, uint64_t ref)
+{
+	if (self->docs_cnt >= DOCS_MAX)
+		return -1;
+
+	if (self->docs_cnt >= self->docs_size) {
+		size_t size = self->docs_size ? 2 * self->docs_size : 1024;
+		struct doc *docs = realloc(self->docs, size * sizeof(*docs));
+
+		if (!docs)
+			return -1;
+
+		self->docs = docs;
+		self->docs_size = size;
+	}
+
+	self->docs[self->docs_cnt] = (struct doc) {
+		.src = src,
+		.time = time,
+		.ref = ref,
+	};
+
+	return self->docs_cnt++;
+}
+
+static void doc_index(struct index *self, uint32_t doc, const char *str, size_t len)
+{
+	struct doc_ctx ctx = {.idx = self, .doc = doc};
+
+	tokenize(str, len, doc_tok, &ctx);
+}
+
+static int src_add(struct index *self, const char *net, const char *chan)
+{
+	struct src *srcs, *src;
+
+	srcs = realloc(self->srcs, (self->srcs_cnt + 1) * sizeof(*srcs));
+	if (!srcs)
+		return -1;
+
+	self->srcs = srcs;
+	src = &srcs[self->srcs_cnt];
+
+	memset(src, 0, sizeof(*src));
+	src->net = strdup(net);
+	src->chan = strdup(chan);
+
+	if (!src->net || !src->chan) {
+		free(src->net);
+		free(src->chan);
+		return -1;
+	}
+
+	return self->srcs_cnt++;
+}
+
+static void index_free(struct index *self)
+{
+	size_t i;
+
+	for (i = 0; i < self->size; i++) {
+		if (self->slots[i])
+			free(self->slots[i]->ids);
+	}
+
+	for (i = 0; i < self->srcs_cnt; i++) {
+		gpirc_hist_close(&self->srcs[i].hist);
+		free(self->srcs[i].net);
+		free(self->srcs[i].chan);
+	}
+
+	gpirc_slab_destroy(&self->slab);
+	free(self->slots);
+	free(self->docs);
+	free(self->srcs);
+	free(self->text);
+
+	memset(self, 0, sizeof(*self));
+}
+
+/*
+ * Skips the HH:MM:SS timestamp the log lines start with.
+ */
+static const char *skip_timestamp(const char *str, size_t *len)
+{
+	if (*len < 9 || str[2] != ':' || str[5] != ':' || str[8] != ' ')
+		return str;
+
+	*len -= 9;
+
+	return str + 9;
+}
+
+static void index_chan_hist(const char *net, const char *chan, const char *dir)
+{
+	struct gpirc_hist_line line;
+	struct src *src;
+	size_t nr;
+	int id;
+
+	id = src_add(&hist, net, chan);
+	if (id < 0)
+		return;
+
+	src = &hist.srcs[id];
+
+	if (gpirc_hist_open(&src->hist, dir))
+		return;
+
+	for (nr = 0; nr < gpirc_hist_lines(&src->hist); nr++) {
+		if (!(nr % 4096) && atomic_load_explicit(&hist_stop, memory_order_relaxed))
+			return;
+
+		if (gpirc_hist_line(&src->hist, nr, &line))
+			return;
+
+		/* Newer lines are indexed live */
+		if (line.time >= start_time)
+			continue;
+
+		int doc = doc_add(&hist, id, line.time, nr);
+		if (doc < 0)
+			return;
+
+		size_t len = line.len;
+		const char *str = skip_timestamp(line.str, &len);
+
+		doc_index(&hist, doc, str, len);
+	}
+}
+
+static void *indexer_main(void *arg)
+{
+	char *base = arg, path[4096];
+	struct dirent *net, *chan;
+	DIR *nets, *chans;
+
+	nets = opendir(base);
+	if (!nets)
+		goto done;
+
+	while ((net = readdir(nets))) {
+		if (net->d_name[0] == '.')
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", base, net->d_name);
+
+		chans = opendir(path);
+		if (!chans)
+			continue;
+
+		while ((chan = readdir(chans))) {
+			if (chan->d_name[0] == '.')
+				continue;
+
+			if (atomic_load(&hist_stop))
+				break;
+
+			snprintf(path, sizeof(path), "%s/%s/%s", base, net->d_name, chan->d_name);
+
+			index_chan_hist(net->d_name, chan->d_name, path);
+		}
+
+		closedir(chans);
+	}
+
+	closedir(nets);
+done:
+	free(base);
+	atomic_store_explicit(&hist_ready, 1, memory_order_release);
+	return NULL;
+}
+
+int gpirc_search_init(void)
+{
+	const char *base = gpirc_logs_dir();
+	char *dir;
+
+	gpirc_slab_init(&live.slab, sizeof(struct token), 4096);
+	gpirc_slab_init(&hist.slab, sizeof(struct token), 4096);
+
+	start_time = time(NULL);
+
+	if (!base) {
+		atomic_store(&hist_ready, 1);
+		return 0;
+	}
+
+	dir = strdup(base);
+	if (!dir)
+		goto err;
+
+	if (pthread_create(&indexer, NULL, indexer_main, dir)) {
+		free(dir);
+		goto err;
+	}
+
+	indexer_running = 1;
+
+	return 0;
+err:
+	/* Search only the live messages */
+	atomic_store(&hist_ready, 1);
+	return 1;
+}
+
+void gpirc_search_exit(void)
+{
+	if (indexer_running) {
+		atomic_store(&hist_stop, 1);
+		pthread_join(indexer, NULL);
+		indexer_running = 0;
+	}
+
+	index_free(&live);
+	index_free(&hist);
+}
+
+int gpirc_search_src(const char *net, const char *chan)
+{
+	size_t i;
+
+	for (i = 0; i < live.srcs_cnt; i++) {
+		if (!strcmp(live.srcs[i].net, net) && !strcmp(live.srcs[i].chan, chan))
+			return i;
+	}
+
+	return src_add(&live, net, chan);
+}
+
+/*
+ * Makes room for a line in the live text ring.
+ *
+ * @return Offset to store the line at or UINT64_MAX on failure.
+ */
+static uint64_t live_text_reserve(size_t len)
+{
+	uint64_t tail = live.text_tail;
+
+	if (len > LIVE_TEXT_MAX)
+		return UINT64_MAX;
+
+	if (tail + len > live.text_size && live.text_size < LIVE_TEXT_MAX) {
+		size_t size = live.text_size ? live.text_size : 64 * 1024;
+		char *text;
+
+		while (size < tail + len && size < LIVE_TEXT_MAX)
+			size *= 2;
+
+		text = realloc(live.text, size);
+		if (!text)
+			return UINT64_MAX;
+
+		live.text = text;
+		live.text_size = size;
+	}
+
+	/* Lines are not split, wrap around if it does not fit */
+	if (tail % LIVE_TEXT_MAX + len > LIVE_TEXT_MAX)
+		tail += LIVE_TEXT_MAX - tail % LIVE_TEXT_MAX;
+
+	live.text_tail = tail + len;
+
+	return tail;
+}
+
+/*
+ * Returns a live line or NULL if it was overwritten already.
+ */
+static const char *live_text(uint64_t ref)
+{
+	if (live.text_tail - ref > LIVE_TEXT_MAX)
+		return NULL;
+
+	return live.text + ref % LIVE_TEXT_MAX;
+}
+
+void gpirc_search_add(int src, time_t time, enum gpirc_msg_type type,
+                      const char *sender, const char *body, const char *chan)
+{
+	uint64_t ref;
+	size_t len;
+	char *line;
+	int doc;
+
+	if (src < 0)
+		return;
+
+	len = gpirc_msg_fmt(NULL, 0, type, sender, body, chan) + 1;
+
+	ref = live_text_reserve(len);
+	if (ref == UINT64_MAX)
+		return;
+
+	doc = doc_add(&live, src, time, ref);
+	if (doc < 0)
+		return;
+
+	line = live.text + ref % LIVE_TEXT_MAX;
+	gpirc_msg_fmt(line, len, type, sender, body, chan);
+
+	live.docs[doc].hash = line_hash(line, len - 1);
+
+	doc_index(&live, doc, line, len - 1);
+}
+
+struct query {
+	size_t cnt;
+	struct {
+		char str[TOKEN_MAX];
+		size_t len;
+		uint32_t hash;
+	} toks[QUERY_MAX];
+};
+
+static void query_tok(void *priv, const char *tok, size_t len, uint32_t hash)
+{
+	struct query *query = priv;
+
+	if (query->cnt >= QUERY_MAX)
+		return;
+
+	memcpy(query->toks[query->cnt].str, tok, len);
+	query->toks[query->cnt].len = len;
+	query->toks[query->cnt].hash = hash;
+	query->cnt++;
+}
+
+/*
+ * The hits are kept in a min-heap ordered by time until the query is done.
+ */
+static void hit_swap(struct gpirc_search_hit *a, struct gpirc_search_hit *b)
+{
+	struct gpirc_search_hit tmp = *a;
+
+	*a = *b;
+	*b = tmp;
+}
+
+static void hit_add(struct gpirc_search_res *res, int is_hist, uint32_t doc, time_t time)
+{
+	struct gpirc_search_hit *hits = res->hits;
+	size_t i;
+
+	res->matches++;
+
+	if (res->cnt < GPIRC_SEARCH_HITS) {
+		i = res->cnt++;
+		hits[i] = (struct gpirc_search_hit) {.hist = is_hist, .doc = doc, .time = time};
+
+		while (i && hits[(i-1)/2].time > hits[i].time) {
+			hit_swap(&hits[(i-1)/2], &hits[i]);
+			i = (i-1)/2;
+		}
+
+		return;
+	}
+
+	if (time <= hits[0].time)
+		return;
+
+	hits[0] = (struct gpirc_search_hit) {.hist = is_hist, .doc = doc, .time = time};
+
+	for (i = 0;;) {
+		size_t min = i, l = 2 * i + 1, r = 2 * i + 2;
+
+		if (l < res->cnt && hits[l].time < hits[min].time)
+			min = l;
+
+		if (r < res->cnt && hits[r].time < hits[min].time)
+			min = r;
+
+		if (min == i)
+			break;
+
+		hit_swap(&hits[i], &hits[min]);
+		i = min;
+	}
+}
+
+/*
+ * Advances the cursor to the first id >= doc, galloping first since the
+ * lists can differ in length by orders of magnitude.
+ */
+static size_t gallop(const uint32_t *ids, size_t cnt, size_t cur, uint32_t doc)
+{
+	size_t step = 1, hi = cur;
+
+	while (hi < cnt && ids[hi] < doc) {
+		cur = hi + 1;
+		hi += step;
+		step *= 2;
+	}
+
+	if (hi > cnt)
+		hi = cnt;
+
+	while (cur < hi) {
+		size_t mid = (cur + hi) / 2;
+
+		if (ids[mid] < doc)
+			cur = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return cur;
+}
+
+static void index_query(struct index *self, struct query *query,
+                        int is_hist, struct gpirc_search_res *res)
+{
+	struct token *toks[QUERY_MAX];
+	size_t curs[QUERY_MAX] = {};
+	size_t i, j;
+
+	for (i = 0; i < query->cnt; i++) {
+		toks[i] = token_lookup(self, query->toks[i].str, query->toks[i].len,
+		                       query->toks[i].hash);
+		if (!toks[i])
+			return;
+	}
+
+	/* Rarest token drives the intersection */
+	for (i = 1; i < query->cnt; i++) {
+		for (j = i; j > 0 && toks[j]->cnt < toks[j-1]->cnt; j--) {
+			struct token *tmp = toks[j];
+
+			toks[j] = toks[j-1];
+			toks[j-1] = tmp;
+		}
+	}
+
+	for (i = 0; i < toks[0]->cnt; i++) {
+		uint32_t doc = toks[0]->ids[i];
+
+		for (j = 1; j < query->cnt; j++) {
+			curs[j] = gallop(toks[j]->ids, toks[j]->cnt, curs[j], doc);
+
+			if (curs[j] >= toks[j]->cnt)
+				return;
+
+			if (toks[j]->ids[curs[j]] != doc)
+				break;
+		}
+
+		if (j == query->cnt)
+			hit_add(res, is_hist, doc, self->docs[doc].time);
+	}
+}
+
+static int hit_cmp(const void *a, const void *b)
+{
+	const struct gpirc_search_hit *ha = a, *hb = b;
+
+	if (ha->time != hb->time)
+		return ha->time < hb->time ? 1 : -1;
+
+	if (ha->hist != hb->hist)
+		return ha->hist ? 1 : -1;
+
+	return ha->doc < hb->doc ? 1 : -1;
+}
+
+int gpirc_search(const char *query, struct gpirc_search_res *res)
+{
+	struct query q = {};
+
+	memset(res, 0, sizeof(*res));
+
+	tokenize(query, strlen(query), query_tok, &q);
+
+	if (!q.cnt)
+		return 1;
+
+	index_query(&live, &q, 0, res);
+
+	if (atomic_load_explicit(&hist_ready, memory_order_acquire))
+		index_query(&hist, &q, 1, res);
+	else
+		res->partial = 1;
+
+	qsort(res->hits, res->cnt, sizeof(*res->hits), hit_cmp);
+
+	return 0;
+}
+
+/*
+ * Looks up a live line whose text was overwritten in the channel log. There
+ * are only a few lines logged in the same second, these are matched by the
+ * hash.
+ *
+ * @return Non-zero if the line was found.
+ */
+static int live_log_line(struct src *src, struct doc *doc, const char **str, size_t *len)
+{
+	struct gpirc_hist_line line;
+	size_t nr;
+
+	if (!src->hist.dir) {
+		char *dir = gpirc_log_dir(src->net, src->chan);
+		int ret;
+
+		if (!dir)
+			return 0;
+
+		ret = gpirc_hist_open(&src->hist, dir);
+		free(dir);
+
+		if (ret)
+			return 0;
+	} else if (gpirc_hist_refresh(&src->hist)) {
+		return 0;
+	}
+
+	for (nr = gpirc_hist_find(&src->hist, doc->time);
+	     !gpirc_hist_line(&src->hist, nr, &line) && line.time == doc->time; nr++) {
+		size_t l = line.len;
+		const char *s = skip_timestamp(line.str, &l);
+
+		if (line_hash(s, l) == doc->hash) {
+			*str = s;
+			*len = l;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void gpirc_search_hit_fmt(const struct gpirc_search_hit *hit, char *buf, size_t size)
+{
+	struct index *idx = hit->hist ? &hist : &live;
+	struct doc *doc = &idx->docs[hit->doc];
+	struct src *src = &idx->srcs[doc->src];
+	time_t time = doc->time;
+	const char *str = "";
+	size_t len = 0;
+	struct tm tm;
+	int off;
+
+	if (hit->hist) {
+		struct gpirc_hist_line line;
+
+		if (!gpirc_hist_line(&src->hist, doc->ref, &line)) {
+			len = line.len;
+			str = skip_timestamp(line.str, &len);
+		}
+	} else if ((str = live_text(doc->ref))) {
+		len = strlen(str);
+	} else if (!live_log_line(src, doc, &str, &len)) {
+		str = "(no longer in memory and not logged)";
+		len = strlen(str);
+	}
+
+	localtime_r(&time, &tm);
+	off = strftime(buf, size, "%Y-%m-%d %H:%M:%S ", &tm);
+
+	snprintf(buf + off, size - off, "%s/%s %.*s", src->net, src->chan, (int)len, str);
+}
+
+static void index_stats(struct index *self, struct gpirc_search_stats *stats)
+{
+	stats->docs += self->docs_cnt;
+	stats->tokens += self->cnt;
+	stats->postings += self->postings;
+	stats->bytes += self->postings_bytes + gpirc_slab_size(&self->slab) +
+	                self->size * sizeof(*self->slots) +
+	                self->docs_size * sizeof(*self->docs) + self->text_size;
+}
+
+void gpirc_search_stats(struct gpirc_search_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	index_stats(&live, stats);
+
+	stats->hist_ready = atomic_load_explicit(&hist_ready, memory_order_acquire);
+
+	if (stats->hist_ready)
+		index_stats(&hist, stats);
+}
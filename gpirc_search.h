@@ -0,0 +1,99 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * Full text search over channel messages.
+ *
+ * Messages are split into case folded tokens and each token maps to an
+ * ascending list of ids of messages it appears in, a query is an
+ * intersection of these lists.
+ *
+ * There are two indexes. The history logged by previous runs is indexed from
+ * the on disk logs by a background thread started by gpirc_search_init(),
+ * messages received since are added to the live index on the UI thread as
+ * they arrive. The thread never touches the live index and the history index
+ * is used by the UI thread only once it's complete.
+ *
+ * The live index keeps the text of the recent messages only, older hits are
+ * read back from the on disk logs.
+ */
+
+#ifndef GPIRC_SEARCH_H__
+#define GPIRC_SEARCH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "gpirc_msgs.h"
+
+/* Maximal number of hits returned by a query */
+#define GPIRC_SEARCH_HITS 100
+
+struct gpirc_search_hit {
+	/* Index the message is in */
+	uint32_t hist:1;
+	uint32_t doc:31;
+	time_t time;
+};
+
+struct gpirc_search_res {
+	/* Total number of matching messages */
+	size_t matches;
+	/* The most recent hits, newest first */
+	size_t cnt;
+	struct gpirc_search_hit hits[GPIRC_SEARCH_HITS];
+	/* Set if the history was not indexed yet */
+	int partial;
+};
+
+struct gpirc_search_stats {
+	size_t docs;
+	size_t tokens;
+	size_t postings;
+	/* Memory used by both indexes */
+	size_t bytes;
+	int hist_ready;
+};
+
+/*
+ * Starts indexing the on disk logs written before this call.
+ *
+ * @return Zero on success.
+ */
+int gpirc_search_init(void);
+
+void gpirc_search_exit(void);
+
+/*
+ * Returns a source id for a channel, to be passed to gpirc_search_add().
+ *
+ * @return Non-negative id or -1 on allocation failure.
+ */
+int gpirc_search_src(const char *net, const char *chan);
+
+/*
+ * Adds a message to the live index.
+ */
+void gpirc_search_add(int src, time_t time, enum gpirc_msg_type type,
+                      const char *sender, const char *body, const char *chan);
+
+/*
+ * Looks up messages that contain all words in the query.
+ *
+ * @return Zero on success, non-zero if the query has no words to search for.
+ */
+int gpirc_search(const char *query, struct gpirc_search_res *res);
+
+/*
+ * Formats a hit as "YYYY-MM-DD HH:MM:SS net/#chan text".
+ */
+void gpirc_search_hit_fmt(const struct gpirc_search_hit *hit, char *buf, size_t size);
+
+void gpirc_search_stats(struct gpirc_search_stats *stats);
+
+#endif /* GPIRC_SEARCH_H__ */
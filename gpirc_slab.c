@@ -0,0 +1,79 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "gpirc_slab.h"
+
+struct gpirc_slab_chunk {
+	struct gpirc_slab_chunk *next;
+	size_t objs;
+	/* Keep the objects aligned */
+	max_align_t data[];
+};
+
+void *gpirc_slab_alloc(struct gpirc_slab *self)
+{
+	void *ret;
+
+	if (self->free_list) {
+		ret = self->free_list;
+		self->free_list = *(void**)ret;
+		self->objs++;
+		return ret;
+	}
+
+	if (!self->chunks || self->chunk_used >= self->chunks->objs) {
+		struct gpirc_slab_chunk *chunk;
+		size_t objs = self->next_chunk_objs;
+		size_t size = sizeof(*chunk) + self->obj_size * objs;
+
+		chunk = malloc(size);
+		if (!chunk)
+			return NULL;
+
+		chunk->next = self->chunks;
+		chunk->objs = objs;
+		self->chunks = chunk;
+		self->chunk_used = 0;
+		self->size += size;
+		self->allocs++;
+
+		if (2 * objs <= self->chunk_objs)
+			self->next_chunk_objs = 2 * objs;
+	}
+
+	ret = (char*)self->chunks->data + self->obj_size * self->chunk_used++;
+	self->objs++;
+
+	return ret;
+}
+
+void gpirc_slab_free(struct gpirc_slab *self, void *obj)
+{
+	*(void**)obj = self->free_list;
+	self->free_list = obj;
+	self->objs--;
+}
+
+void gpirc_slab_destroy(struct gpirc_slab *self)
+{
+	struct gpirc_slab_chunk *chunk, *next;
+
+	for (chunk = self->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+
+	self->chunks = NULL;
+	self->chunk_used = 0;
+	self->free_list = NULL;
+	self->objs = 0;
+	self->size = 0;
+	self->next_chunk_objs = self->chunk_objs < 16 ? self->chunk_objs : 16;
+}
@@ -0,0 +1,69 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * Fixed size object allocator.
+ *
+ * Objects are carved from large chunks, freed objects are put on a free list
+ * and reused. All chunks are released at once by gpirc_slab_destroy() so a
+ * whole channel can be thrown away without walking the objects.
+ */
+
+#ifndef GPIRC_SLAB_H__
+#define GPIRC_SLAB_H__
+
+#include <stddef.h>
+
+struct gpirc_slab_chunk;
+
+struct gpirc_slab {
+	size_t obj_size;
+	/* Maximal number of objects per chunk, chunks start small and double */
+	size_t chunk_objs;
+	size_t next_chunk_objs;
+
+	struct gpirc_slab_chunk *chunks;
+	size_t chunk_used;
+	/* Total size of chunks in bytes */
+	size_t size;
+	void *free_list;
+
+	/* Number of chunks allocated so far */
+	size_t allocs;
+	/* Number of objects in use */
+	size_t objs;
+};
+
+static inline void gpirc_slab_init(struct gpirc_slab *self, size_t obj_size, size_t chunk_objs)
+{
+	*self = (struct gpirc_slab) {
+		.obj_size = obj_size < sizeof(void*) ? sizeof(void*) : obj_size,
+		.chunk_objs = chunk_objs,
+		.next_chunk_objs = chunk_objs < 16 ? chunk_objs : 16,
+	};
+}
+
+void *gpirc_slab_alloc(struct gpirc_slab *self);
+
+void gpirc_slab_free(struct gpirc_slab *self, void *obj);
+
+/*
+ * Frees all chunks, all objects allocated from the slab are invalid after
+ * this call.
+ */
+void gpirc_slab_destroy(struct gpirc_slab *self);
+
+/*
+ * Returns number of bytes allocated by the slab.
+ */
+static inline size_t gpirc_slab_size(struct gpirc_slab *self)
+{
+	return self->size;
+}
+
+#endif /* GPIRC_SLAB_H__ */
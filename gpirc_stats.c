@@ -0,0 +1,170 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gpirc_stats.h"
+
+/* Commands beyond that are accounted together as "other" */
+#define CMDS 32
+#define NUMERICS 1000
+
+static struct gpirc_stats_ev cmd_evs[CMDS];
+static size_t cmd_cnt;
+/* Allocated on the first reply, most of the numerics are never seen */
+static struct gpirc_stats_ev *numeric_evs[NUMERICS];
+static size_t numeric_cnt;
+
+uint64_t gpirc_stats_hist_pct(const struct gpirc_stats_hist *self, unsigned int pct)
+{
+	uint64_t want = (self->cnt * pct + 99) / 100;
+	uint64_t sum = 0;
+	unsigned int i;
+
+	if (!self->cnt)
+		return 0;
+
+	if (!want)
+		want = 1;
+
+	for (i = 0; i < GPIRC_STATS_BUCKETS - 1; i++) {
+		sum += self->buckets[i];
+		if (sum >= want)
+			break;
+	}
+
+	if ((1ull << i) > self->max)
+		return self->max;
+
+	return 1ull << i;
+}
+
+/*
+ * A server sends a couple dozen distinct commands, a linear scan is enough.
+ */
+static struct gpirc_stats_ev *cmd_ev(const char *cmd)
+{
+	size_t i;
+
+	for (i = 0; i < cmd_cnt; i++) {
+		if (!strncmp(cmd_evs[i].name, cmd, sizeof(cmd_evs[i].name) - 1))
+			return &cmd_evs[i];
+	}
+
+	if (cmd_cnt >= CMDS - 1) {
+		strcpy(cmd_evs[CMDS - 1].name, "other");
+		return &cmd_evs[CMDS - 1];
+	}
+
+	snprintf(cmd_evs[cmd_cnt].name, sizeof(cmd_evs[cmd_cnt].name), "%s", cmd);
+
+	return &cmd_evs[cmd_cnt++];
+}
+
+void gpirc_stats_event(const char *cmd, uint64_t ns)
+{
+	gpirc_stats_hist_add(&cmd_ev(cmd)->hist, ns);
+}
+
+static struct gpirc_stats_ev *numeric_ev(unsigned int numeric)
+{
+	struct gpirc_stats_ev *ev;
+
+	if (numeric >= NUMERICS)
+		return NULL;
+
+	if (numeric_evs[numeric])
+		return numeric_evs[numeric];
+
+	ev = calloc(1, sizeof(*ev));
+	if (!ev)
+		return NULL;
+
+	snprintf(ev->name, sizeof(ev->name), "%03u", numeric);
+
+	numeric_evs[numeric] = ev;
+	numeric_cnt++;
+
+	return ev;
+}
+
+void gpirc_stats_numeric(unsigned int numeric, uint64_t ns)
+{
+	struct gpirc_stats_ev *ev = numeric_ev(numeric);
+
+	if (ev)
+		gpirc_stats_hist_add(&ev->hist, ns);
+}
+
+void gpirc_stats_unhandled(unsigned int numeric)
+{
+	struct gpirc_stats_ev *ev = numeric_ev(numeric);
+
+	if (ev)
+		ev->unhandled++;
+}
+
+static int ev_cmp(const void *a, const void *b)
+{
+	const struct gpirc_stats_ev *ea = *(const struct gpirc_stats_ev **)a;
+	const struct gpirc_stats_ev *eb = *(const struct gpirc_stats_ev **)b;
+
+	if (ea->hist.sum != eb->hist.sum)
+		return ea->hist.sum < eb->hist.sum ? 1 : -1;
+
+	return strcmp(ea->name, eb->name);
+}
+
+size_t gpirc_stats_evs(const struct gpirc_stats_ev **evs, size_t max)
+{
+	const struct gpirc_stats_ev *all[CMDS + NUMERICS];
+	size_t i, cnt = 0;
+
+	for (i = 0; i < CMDS; i++) {
+		if (cmd_evs[i].hist.cnt)
+			all[cnt++] = &cmd_evs[i];
+	}
+
+	for (i = 0; i < NUMERICS; i++) {
+		if (numeric_evs[i] && numeric_evs[i]->hist.cnt)
+			all[cnt++] = numeric_evs[i];
+	}
+
+	qsort(all, cnt, sizeof(*all), ev_cmp);
+
+	if (cnt > max)
+		cnt = max;
+
+	memcpy(evs, all, cnt * sizeof(*all));
+
+	return cnt;
+}
+
+size_t gpirc_stats_mem(void)
+{
+	return sizeof(cmd_evs) + sizeof(numeric_evs) +
+	       numeric_cnt * sizeof(struct gpirc_stats_ev);
+}
+
+void gpirc_stats_reset(void)
+{
+	size_t i;
+
+	memset(cmd_evs, 0, sizeof(cmd_evs));
+	cmd_cnt = 0;
+
+	for (i = 0; i < NUMERICS; i++) {
+		if (!numeric_evs[i])
+			continue;
+
+		numeric_evs[i]->unhandled = 0;
+		memset(&numeric_evs[i]->hist, 0, sizeof(numeric_evs[i]->hist));
+	}
+}
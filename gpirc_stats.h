@@ -0,0 +1,105 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * Runtime statistics.
+ *
+ * Time spent in the message handlers is accounted per command and per
+ * numeric reply into histograms with power of two buckets. An update is a
+ * couple of additions into a fixed array so the accounting is always on.
+ *
+ * All functions are called from the UI thread.
+ */
+
+#ifndef GPIRC_STATS_H__
+#define GPIRC_STATS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bucket i counts values in [2^(i-1), 2^i), the last one everything above */
+#define GPIRC_STATS_BUCKETS 40
+
+struct gpirc_stats_hist {
+	uint64_t cnt;
+	uint64_t sum;
+	uint64_t max;
+	uint32_t buckets[GPIRC_STATS_BUCKETS];
+};
+
+static inline void gpirc_stats_hist_add(struct gpirc_stats_hist *self, uint64_t val)
+{
+	unsigned int bucket = val ? 64 - __builtin_clzll(val) : 0;
+
+	if (bucket >= GPIRC_STATS_BUCKETS)
+		bucket = GPIRC_STATS_BUCKETS - 1;
+
+	self->buckets[bucket]++;
+	self->cnt++;
+	self->sum += val;
+
+	if (val > self->max)
+		self->max = val;
+}
+
+/*
+ * Returns an upper bound of a percentile, i.e. the end of the bucket the
+ * percentile falls into clamped to the maximum.
+ *
+ * @pct A percentile 0 to 100.
+ */
+uint64_t gpirc_stats_hist_pct(const struct gpirc_stats_hist *self, unsigned int pct);
+
+struct gpirc_stats_ev {
+	/* Command or a numeric reply */
+	char name[16];
+	/* Numeric replies the client has no handler for */
+	uint64_t unhandled;
+	/* Time spent in the handler in ns */
+	struct gpirc_stats_hist hist;
+};
+
+/*
+ * Accounts a command handler call.
+ *
+ * @cmd A command name, names longer than 15 characters are truncated.
+ * @ns A time spent in the handler.
+ */
+void gpirc_stats_event(const char *cmd, uint64_t ns);
+
+/*
+ * Accounts a numeric reply, the numeric handler is accounted per reply.
+ */
+void gpirc_stats_numeric(unsigned int numeric, uint64_t ns);
+
+/*
+ * Marks a numeric reply as not handled, called from the numeric handler.
+ */
+void gpirc_stats_unhandled(unsigned int numeric);
+
+/*
+ * Returns events sorted by the total time spent in the handler.
+ *
+ * @evs An array to store the events to.
+ * @max Size of the array.
+ *
+ * @return Number of events stored.
+ */
+size_t gpirc_stats_evs(const struct gpirc_stats_ev **evs, size_t max);
+
+/*
+ * Returns memory used by the statistics.
+ */
+size_t gpirc_stats_mem(void);
+
+/*
+ * Clears all counters.
+ */
+void gpirc_stats_reset(void);
+
+#endif /* GPIRC_STATS_H__ */
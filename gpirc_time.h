@@ -0,0 +1,24 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+#ifndef GPIRC_TIME_H__
+#define GPIRC_TIME_H__
+
+#include <stdint.h>
+#include <time.h>
+
+static inline uint64_t gpirc_monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#endif /* GPIRC_TIME_H__ */
@@ -0,0 +1,314 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "gpirc_users.h"
+
+#define CASEMAP_ROW(b) \
+	b+0, b+1, b+2, b+3, b+4, b+5, b+6, b+7, \
+	b+8, b+9, b+10, b+11, b+12, b+13, b+14, b+15
+
+const unsigned char gpirc_casemap[256] = {
+	CASEMAP_ROW(0x00), CASEMAP_ROW(0x10), CASEMAP_ROW(0x20), CASEMAP_ROW(0x30),
+	/* '@' followed by A-Z [\] and '^' '_' */
+	'@', 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+	'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', '{', '|', '}', '^', '_',
+	CASEMAP_ROW(0x60),
+	/* '~' folds to '^' */
+	'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', '{', '|', '}', '^', 0x7f,
+	CASEMAP_ROW(0x80), CASEMAP_ROW(0x90), CASEMAP_ROW(0xa0), CASEMAP_ROW(0xb0),
+	CASEMAP_ROW(0xc0), CASEMAP_ROW(0xd0), CASEMAP_ROW(0xe0), CASEMAP_ROW(0xf0),
+};
+
+int gpirc_nick_cmp(const char *a, const char *b)
+{
+	while (*a && gpirc_fold(*a) == gpirc_fold(*b)) {
+		a++;
+		b++;
+	}
+
+	return (int)gpirc_fold(*a) - (int)gpirc_fold(*b);
+}
+
+static int nick_eq(const char *a, const char *b, size_t b_len)
+{
+	size_t i;
+
+	for (i = 0; i < b_len; i++) {
+		if (!a[i] || gpirc_fold(a[i]) != gpirc_fold(b[i]))
+			return 0;
+	}
+
+	return !a[i];
+}
+
+/* FNV-1a over case folded characters */
+static uint32_t nick_hash(const char *nick, size_t len)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= gpirc_fold(nick[i]);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static size_t slot_find(struct gpirc_users *self, const char *nick,
+                        size_t len, uint32_t hash)
+{
+	size_t mask = self->size - 1;
+	size_t i = hash & mask;
+
+	for (;;) {
+		struct gpirc_user *user = self->slots[i];
+
+		if (!user)
+			return i;
+
+		if (user->hash == hash && nick_eq(user->nick, nick, len))
+			return i;
+
+		i = (i + 1) & mask;
+	}
+}
+
+static int grow(struct gpirc_users *self)
+{
+	size_t i, new_size = self->size ? 2 * self->size : 256;
+	struct gpirc_user **old_slots = self->slots;
+	size_t old_size = self->size;
+
+	self->slots = calloc(new_size, sizeof(struct gpirc_user *));
+	if (!self->slots) {
+		self->slots = old_slots;
+		return 1;
+	}
+
+	self->size = new_size;
+
+	for (i = 0; i < old_size; i++) {
+		struct gpirc_user *user = old_slots[i];
+
+		if (!user)
+			continue;
+
+		self->slots[slot_find(self, user->nick, strlen(user->nick), user->hash)] = user;
+	}
+
+	free(old_slots);
+
+	return 0;
+}
+
+static struct gpirc_user **lookup(struct gpirc_users *self, const char *nick, size_t len)
+{
+	struct gpirc_user **slot;
+
+	if (!self->cnt)
+		return NULL;
+
+	slot = &self->slots[slot_find(self, nick, len, nick_hash(nick, len))];
+
+	return *slot ? slot : NULL;
+}
+
+struct gpirc_user *gpirc_users_get(struct gpirc_users *self, const char *nick)
+{
+	struct gpirc_user **slot = lookup(self, nick, strlen(nick));
+
+	return slot ? *slot : NULL;
+}
+
+static void slot_ins(struct gpirc_users *self, struct gpirc_user *user)
+{
+	size_t len = strlen(user->nick);
+
+	self->slots[slot_find(self, user->nick, len, user->hash)] = user;
+	self->cnt++;
+}
+
+/*
+ * Backward shift deletion, moves entries from the probe sequence into the
+ * hole so that no tombstones are needed.
+ */
+static void slot_del(struct gpirc_users *self, struct gpirc_user **slot)
+{
+	size_t mask = self->size - 1;
+	size_t i = slot - self->slots;
+	size_t j = i;
+
+	for (;;) {
+		size_t k;
+
+		j = (j + 1) & mask;
+
+		if (!self->slots[j])
+			break;
+
+		k = self->slots[j]->hash & mask;
+
+		if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+
+		self->slots[i] = self->slots[j];
+		i = j;
+	}
+
+	self->slots[i] = NULL;
+	self->cnt--;
+}
+
+static void nick_free(struct gpirc_user *user)
+{
+	if (user->nick != user->nick_buf)
+		free(user->nick);
+}
+
+static int nick_set(struct gpirc_user *user, const char *nick, size_t len)
+{
+	char *tmp = user->nick_buf;
+
+	if (len >= GPIRC_NICK_INLINE) {
+		tmp = malloc(len + 1);
+		if (!tmp)
+			return 1;
+	}
+
+	if (user->nick)
+		nick_free(user);
+
+	memcpy(tmp, nick, len);
+	tmp[len] = 0;
+	user->nick = tmp;
+
+	return 0;
+}
+
+struct gpirc_user *gpirc_users_ref(struct gpirc_users *self, const char *nick, size_t len)
+{
+	struct gpirc_user **slot = lookup(self, nick, len);
+	struct gpirc_user *user;
+
+	if (slot) {
+		(*slot)->refcnt++;
+		return *slot;
+	}
+
+	/* Keep load factor under 1/2 */
+	if (2 * (self->cnt + 1) > self->size && grow(self))
+		return NULL;
+
+	user = gpirc_slab_alloc(&self->slab);
+	if (!user)
+		return NULL;
+
+	memset(user, 0, sizeof(*user));
+
+	if (nick_set(user, nick, len)) {
+		gpirc_slab_free(&self->slab, user);
+		return NULL;
+	}
+
+	user->hash = nick_hash(nick, len);
+	user->refcnt = 1;
+
+	slot_ins(self, user);
+
+	return user;
+}
+
+static void user_free(struct gpirc_users *self, struct gpirc_user *user)
+{
+	free(user->userhost);
+	nick_free(user);
+	gpirc_slab_free(&self->slab, user);
+}
+
+void gpirc_users_unref(struct gpirc_users *self, struct gpirc_user *user)
+{
+	if (--user->refcnt)
+		return;
+
+	if (!user->unhashed)
+		slot_del(self, lookup(self, user->nick, strlen(user->nick)));
+	user_free(self, user);
+}
+
+int gpirc_users_rename(struct gpirc_users *self, struct gpirc_user *user, const char *new_nick)
+{
+	size_t len = strlen(new_nick);
+	struct gpirc_user **other;
+
+	self->gen++;
+
+	/* Case change only, the key stays the same */
+	if (!gpirc_nick_cmp(user->nick, new_nick))
+		return nick_set(user, new_nick, len);
+
+	/*
+	 * Stale record with the new nick, can happen if we missed a QUIT. It's
+	 * unhashed and lives until the last membership is dropped.
+	 */
+	other = lookup(self, new_nick, len);
+	if (other) {
+		(*other)->unhashed = 1;
+		slot_del(self, other);
+	}
+
+	slot_del(self, lookup(self, user->nick, strlen(user->nick)));
+
+	if (nick_set(user, new_nick, len)) {
+		slot_ins(self, user);
+		return 1;
+	}
+
+	user->hash = nick_hash(new_nick, len);
+	slot_ins(self, user);
+
+	return 0;
+}
+
+void gpirc_user_origin_set(struct gpirc_user *user, const char *mask)
+{
+	const char *userhost;
+
+	if (user->userhost)
+		return;
+
+	userhost = strchr(mask, '!');
+	if (!userhost)
+		return;
+
+	user->userhost = strdup(userhost + 1);
+}
+
+void gpirc_users_free(struct gpirc_users *self)
+{
+	size_t i;
+
+	for (i = 0; i < self->size; i++) {
+		struct gpirc_user *user = self->slots[i];
+
+		if (!user)
+			continue;
+
+		free(user->userhost);
+		nick_free(user);
+	}
+
+	free(self->slots);
+	gpirc_slab_destroy(&self->slab);
+
+	self->slots = NULL;
+	self->size = 0;
+	self->cnt = 0;
+}
@@ -0,0 +1,120 @@
+//SPDX-License-Identifier: GPL-2.1-or-later
+
+/*
+
+    Copyright (C) 2026 agent <agent@local>
+
+ */
+
+/*
+ * Network wide table of users.
+ *
+ * Each user we share a channel with is stored exactly once, channel
+ * memberships point to the user record and hold a reference. The user is
+ * freed once the last membership is removed.
+ */
+
+#ifndef GPIRC_USERS_H__
+#define GPIRC_USERS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "gpirc_slab.h"
+
+/*
+ * Nicks shorter than this are stored inline in the user record, which covers
+ * NICKLEN on all common networks.
+ */
+#define GPIRC_NICK_INLINE 32
+
+struct gpirc_member;
+
+struct gpirc_user {
+	/* Hash of the case folded nick */
+	uint32_t hash;
+	/* Number of channel memberships */
+	unsigned int refcnt;
+	uint8_t away;
+	/* Set for stale records that were pushed out by a rename */
+	uint8_t unhashed;
+	/* Set while the user is held after a netsplit */
+	uint8_t split;
+	/* user@host or NULL if not known yet */
+	char *userhost;
+	/* List of all channel memberships of this user */
+	struct gpirc_member *members;
+	/* Points either to nick_buf or to a heap allocated string */
+	char *nick;
+	char nick_buf[GPIRC_NICK_INLINE];
+};
+
+struct gpirc_users {
+	/* Power of two, zero if not allocated yet */
+	size_t size;
+	size_t cnt;
+	struct gpirc_user **slots;
+	struct gpirc_slab slab;
+	/* Incremented on each rename, invalidates sorted nick views */
+	unsigned int gen;
+};
+
+/*
+ * RFC1459 case mapping.
+ */
+extern const unsigned char gpirc_casemap[256];
+
+static inline unsigned char gpirc_fold(char c)
+{
+	return gpirc_casemap[(unsigned char)c];
+}
+
+/*
+ * Compares two nicks with RFC1459 case mapping.
+ */
+int gpirc_nick_cmp(const char *a, const char *b);
+
+static inline void gpirc_users_init(struct gpirc_users *self)
+{
+	gpirc_slab_init(&self->slab, sizeof(struct gpirc_user), 1024);
+}
+
+/*
+ * Looks up user by a nick.
+ */
+struct gpirc_user *gpirc_users_get(struct gpirc_users *self, const char *nick);
+
+/*
+ * Looks up or creates a user and increments the reference counter.
+ *
+ * @nick A nick, does not have to be null terminated.
+ * @len A nick length.
+ * @return A user or NULL on allocation failure.
+ */
+struct gpirc_user *gpirc_users_ref(struct gpirc_users *self, const char *nick, size_t len);
+
+/*
+ * Increments reference counter.
+ */
+static inline void gpirc_user_ref(struct gpirc_user *user)
+{
+	user->refcnt++;
+}
+
+/*
+ * Decrements reference counter, the user is freed when it drops to zero.
+ */
+void gpirc_users_unref(struct gpirc_users *self, struct gpirc_user *user);
+
+/*
+ * Changes user nick. Returns non-zero on allocation failure.
+ */
+int gpirc_users_rename(struct gpirc_users *self, struct gpirc_user *user, const char *new_nick);
+
+/*
+ * Sets user@host from a "!user@host" prefix mask if not set already.
+ */
+void gpirc_user_origin_set(struct gpirc_user *user, const char *mask);
+
+void gpirc_users_free(struct gpirc_users *self);
+
+#endif /* GPIRC_USERS_H__ */